@@ -0,0 +1,429 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/utsname.h>
+#include <mpi.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "affinity.h"
+#include "params.h"
+
+
+/* ------------------------------------------------------------------------- */
+/* ----------------------------- Sysfs Helpers ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static int read_sysfs_int(int cpu, const char *entry, int fallback)
+/* Read /sys/devices/system/cpu/cpuN/<entry> as an integer. */
+{
+  char path[256];
+  int value;
+  FILE *f;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s", cpu, entry);
+  f = fopen(path, "r");
+  if (f == NULL) { return fallback; }
+  if (fscanf(f, "%d", &value) != 1) { value = fallback; }
+  fclose(f);
+  return value;
+}
+
+static int parse_cpulist(const char *list, int *out, int max)
+/* Expand a kernel style cpu list ("0-3,8,10-11") into out[]. Returns the
+   number of cpus written. */
+{
+  int n = 0, lo, hi, c;
+  const char *p = list;
+  char *end;
+
+  while (*p != '\0' && n < max) {
+    lo = strtol(p, &end, 10);
+    if (end == p) { break; }
+    hi = lo;
+    p = end;
+    if (*p == '-') {
+      hi = strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for (c = lo; c <= hi && n < max; c++) { out[n++] = c; }
+    while (*p == ',' || *p == ' ' || *p == '\n') { p++; }
+  }
+  return n;
+}
+
+static int cpu_node(int cpu)
+/* Find the NUMA node of a cpu from its nodeM link in sysfs. */
+{
+  char path[256];
+  struct dirent *d;
+  DIR *dir;
+  int node = 0;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  dir = opendir(path);
+  if (dir == NULL) { return 0; }
+  while ((d = readdir(dir)) != NULL) {
+    if (strncmp(d->d_name, "node", 4) == 0 && d->d_name[4] >= '0' && d->d_name[4] <= '9') {
+      node = atoi(d->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+static int cpu_smt_index(int cpu)
+/* Position of this cpu among the hardware threads of its core. */
+{
+  char path[256], line[256];
+  int siblings[CPU_SETSIZE];
+  int n, i;
+  FILE *f;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+  f = fopen(path, "r");
+  if (f == NULL) { return 0; }
+  if (fgets(line, sizeof(line), f) == NULL) { line[0] = '\0'; }
+  fclose(f);
+
+  n = parse_cpulist(line, siblings, CPU_SETSIZE);
+  for (i = 0; i < n; i++) {
+    if (siblings[i] == cpu) { return i; }
+  }
+  return 0;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------- Topology -------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+topology new_topology(void)
+/* Read the cpus this process may run on, with their core/socket/NUMA ids.
+   Missing sysfs entries (containers, non-Linux) degrade to a flat layout. */
+{
+  int cpu;
+  cpu_set_t allowed;
+  topology T = malloc(sizeof(topologytype));
+
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+
+  T->count = 0;
+  T->C = malloc(sizeof(cputype) * CPU_COUNT(&allowed));
+
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &allowed)) { continue; }
+    T->C[T->count].cpu = cpu;
+    T->C[T->count].core = read_sysfs_int(cpu, "topology/core_id", cpu);
+    T->C[T->count].package = read_sysfs_int(cpu, "topology/physical_package_id", 0);
+    T->C[T->count].node = cpu_node(cpu);
+    T->C[T->count].smt = cpu_smt_index(cpu);
+    T->count++;
+  }
+
+  return T;
+}
+
+void delete_topology(topology T)
+/* Free up the memory allocated for the topology T. */
+{
+  free(T->C);
+  free(T);
+}
+
+void cpu_model(char *out, int size)
+/* The processor's marketing name from /proc/cpuinfo ("model name" on x86,
+   implementer and part on ARM), or the machine type from uname. */
+{
+  char line[256], *value;
+  int implementer = -1, part = -1;
+  struct utsname u;
+  FILE *f = fopen("/proc/cpuinfo", "r");
+
+  snprintf(out, size, "unknown");
+  if (f != NULL) {
+    while (fgets(line, sizeof(line), f) != NULL) {
+      value = strchr(line, ':');
+      if (value == NULL) { continue; }
+      for (value++; *value == ' ' || *value == '\t'; value++) { }
+      value[strcspn(value, "\n")] = '\0';
+
+      if (strncmp(line, "model name", 10) == 0) {
+        snprintf(out, size, "%s", value);
+        fclose(f);
+        return;
+      }
+      if (strncmp(line, "CPU implementer", 15) == 0) { implementer = strtol(value, NULL, 0); }
+      if (strncmp(line, "CPU part", 8) == 0) { part = strtol(value, NULL, 0); }
+    }
+    fclose(f);
+  }
+
+  if (implementer >= 0 && part >= 0) {
+    snprintf(out, size, "arm 0x%02x part 0x%03x", implementer, part);
+    return;
+  }
+
+  if (uname(&u) == 0) { snprintf(out, size, "%s", u.machine); }
+}
+
+long cache_size(int level)
+/* From /sys/devices/system/cpu/cpu0/cache/indexN, whose sizes are in KiB
+   ("2048K"); instruction caches are skipped. */
+{
+  char entry[64], type[32], path[256];
+  int index;
+  FILE *f;
+
+  for (index = 0; index < 8; index++) {
+    snprintf(entry, sizeof(entry), "cache/index%d/level", index);
+    if (read_sysfs_int(0, entry, -1) != level) { continue; }
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+    f = fopen(path, "r");
+    if (f == NULL) { continue; }
+    if (fscanf(f, "%31s", type) != 1) { type[0] = '\0'; }
+    fclose(f);
+    if (strcmp(type, "Instruction") == 0) { continue; }
+
+    snprintf(entry, sizeof(entry), "cache/index%d/size", index);
+    return 1024L * read_sysfs_int(0, entry, 0);
+  }
+  return 0;
+}
+
+static int compare_compact(const void *a, const void *b)
+/* Physical cores first, then socket, NUMA node and core order. */
+{
+  const cputype *x = a, *y = b;
+  if (x->smt != y->smt) { return x->smt - y->smt; }
+  if (x->package != y->package) { return x->package - y->package; }
+  if (x->node != y->node) { return x->node - y->node; }
+  if (x->core != y->core) { return x->core - y->core; }
+  return x->cpu - y->cpu;
+}
+
+static int order_cpus(topology T, const char *policy, int *order)
+/* Produce the sequence of cpus that threads are handed out from. */
+{
+  int i, n = 0, node, max_node = 0, taken, *next;
+
+  if (strcmp(policy, "compact") != 0 && strcmp(policy, "scatter") != 0) {
+    /* Explicit list: keep only the cpus we are allowed to run on. */
+    int listed[CPU_SETSIZE], count, j;
+    count = parse_cpulist(policy, listed, CPU_SETSIZE);
+    for (i = 0; i < count; i++) {
+      for (j = 0; j < T->count; j++) {
+        if (T->C[j].cpu == listed[i]) { order[n++] = listed[i]; break; }
+      }
+    }
+    return n;
+  }
+
+  qsort(T->C, T->count, sizeof(cputype), compare_compact);
+
+  if (strcmp(policy, "compact") == 0) {
+    for (i = 0; i < T->count; i++) { order[n++] = T->C[i].cpu; }
+    return n;
+  }
+
+  /* Scatter: deal the compact order out one NUMA node at a time. */
+  for (i = 0; i < T->count; i++) {
+    if (T->C[i].node > max_node) { max_node = T->C[i].node; }
+  }
+  next = calloc(max_node + 1, sizeof(int));
+  while (n < T->count) {
+    for (node = 0; node <= max_node; node++) {
+      taken = 0;
+      for (i = next[node]; i < T->count; i++) {
+        if (T->C[i].node == node) {
+          order[n++] = T->C[i].cpu;
+          next[node] = i + 1;
+          taken = 1;
+          break;
+        }
+      }
+      if (!taken) { next[node] = T->count; }
+    }
+  }
+  free(next);
+  return n;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* -------------------------------- Binding -------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+/* The first cpu of the order past every rank's threads, see spare_cpu. */
+static int spare = -1;
+
+static void bind_to_cpu(int cpu)
+/* Pin the calling thread to a single cpu. */
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  sched_setaffinity(0, sizeof(set), &set);
+}
+
+void setup_affinity(MPI_Comm comm, struct paramstype *params)
+/* Bind this rank and each of its OpenMP threads to cpus according to
+   params->AFFINITY. Collective on comm. */
+{
+  int rank, local_rank, local_size, n, threads = params->THREADS;
+  int *order;
+  topology T;
+  MPI_Comm node_comm;
+
+  spare = -1;
+  if (strcmp(params->AFFINITY, "none") == 0) { return; }
+  MPI_Comm_rank(comm, &rank);
+
+  /* Ranks sharing a node divide that node's cpus between them. */
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank,
+                      MPI_INFO_NULL, &node_comm);
+  MPI_Comm_rank(node_comm, &local_rank);
+  MPI_Comm_size(node_comm, &local_size);
+  MPI_Comm_free(&node_comm);
+
+  T = new_topology();
+  order = malloc(sizeof(int) * (T->count > 0 ? T->count : 1));
+  n = order_cpus(T, params->AFFINITY, order);
+
+  if (n == 0) {
+    if (rank == params->PROBED_RANK) {
+      printf("Affinity '%s' matched no usable cpus. Leaving placement to the OS.\n", params->AFFINITY);
+    }
+    free(order);
+    delete_topology(T);
+    return;
+  }
+
+  if (local_size * threads > n && rank == params->PROBED_RANK) {
+    printf("Affinity: %d ranks x %d threads on %d cpus, cores will be shared.\n",
+           local_size, threads, n);
+  }
+
+  /* The threads of the node's ranks take the first local_size * threads
+     cpus of the order; each rank gets one of the rest for a helper. */
+  if (local_size * threads + local_rank < n) { spare = order[local_size * threads + local_rank]; }
+
+  /* The master binds first so that the OpenMP pool inherits a sane mask. */
+  bind_to_cpu(order[(local_rank * threads) % n]);
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(threads)
+  {
+    int t = omp_get_thread_num();
+    bind_to_cpu(order[(local_rank * threads + t) % n]);
+  }
+#endif
+
+  free(order);
+  delete_topology(T);
+}
+
+int spare_cpu(void)
+{
+  return spare;
+}
+
+void print_affinity(MPI_Comm comm, struct paramstype *params)
+/* Gather the cpu and NUMA node that every thread of every rank of comm is
+   running on and print the map on PROBED_RANK. Collective. */
+{
+  int rank, comrades, r, t, threads = params->THREADS;
+  int *mine, *all = NULL, *counts = NULL, *displs = NULL;
+  char host[MPI_MAX_PROCESSOR_NAME], *hosts = NULL;
+  int len;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &comrades);
+
+  /* Pairs of (cpu, node) per thread. */
+  mine = malloc(sizeof(int) * 2 * threads);
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(threads)
+  {
+    int t = omp_get_thread_num();
+    mine[2 * t] = sched_getcpu();
+    mine[2 * t + 1] = cpu_node(mine[2 * t]);
+  }
+#else
+  mine[0] = sched_getcpu();
+  mine[1] = cpu_node(mine[0]);
+#endif
+
+  memset(host, 0, sizeof(host));
+  MPI_Get_processor_name(host, &len);
+
+  if (rank == params->PROBED_RANK) {
+    counts = malloc(sizeof(int) * comrades);
+    displs = malloc(sizeof(int) * comrades);
+    hosts = malloc(MPI_MAX_PROCESSOR_NAME * comrades);
+  }
+
+  len = 2 * threads;
+  MPI_Gather(&len, 1, MPI_INT, counts, 1, MPI_INT, params->PROBED_RANK, comm);
+
+  if (rank == params->PROBED_RANK) {
+    displs[0] = 0;
+    for (r = 1; r < comrades; r++) { displs[r] = displs[r - 1] + counts[r - 1]; }
+    all = malloc(sizeof(int) * (displs[comrades - 1] + counts[comrades - 1]));
+  }
+
+  MPI_Gatherv(mine, len, MPI_INT, all, counts, displs, MPI_INT,
+              params->PROBED_RANK, comm);
+  MPI_Gather(host, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, hosts, MPI_MAX_PROCESSOR_NAME,
+             MPI_CHAR, params->PROBED_RANK, comm);
+
+  if (rank == params->PROBED_RANK) {
+    printf("Placement (%s): rank host thread:cpu(node) ...\n", params->AFFINITY);
+    for (r = 0; r < comrades; r++) {
+      printf("  %d %s", r, hosts + r * MPI_MAX_PROCESSOR_NAME);
+      for (t = 0; t < counts[r] / 2; t++) {
+        printf(" %d:%d(%d)", t, all[displs[r] + 2 * t], all[displs[r] + 2 * t + 1]);
+      }
+      printf("\n");
+    }
+    free(counts);
+    free(displs);
+    free(hosts);
+    free(all);
+  }
+
+  free(mine);
+}
@@ -0,0 +1,87 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AFFINITY_H_
+#define AFFINITY_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+
+
+/* ---------------------------- Topology ----------------------------------- */
+
+/* One logical cpu as seen through /sys/devices/system/cpu. */
+typedef struct {
+  int cpu;        // Logical cpu id (what sched_setaffinity takes)
+  int core;       // Physical core id within the package
+  int package;    // Socket
+  int node;       // NUMA node
+  int smt;        // 0 for the first hardware thread of a core, 1.. for siblings
+} cputype;
+
+typedef struct {
+  int count;
+  cputype *C;
+} topologytype, *topology;
+
+/* Read the cpus this process may run on, with their core/socket/NUMA ids.
+   Missing sysfs entries (containers, non-Linux) degrade to a flat layout. */
+topology new_topology(void);
+void delete_topology(topology T);
+
+/* Name of the processor model, for keying per-machine results. */
+void cpu_model(char *out, int size);
+
+/* Bytes of cpu 0's data (or unified) cache of the given level, 0 if the
+   system does not say. */
+long cache_size(int level);
+
+
+/* ---------------------------- Binding ------------------------------------ */
+
+/* Bind this rank and each of its params->THREADS OpenMP threads to cpus
+   according to params->AFFINITY:
+
+     none     |  leave placement to the OS / launcher
+     compact  |  fill one socket's physical cores before the next
+     scatter  |  round robin over NUMA nodes
+     <list>   |  explicit cpus, e.g. "0-7,16-23", consumed in
+                 (node-local rank * THREADS + thread) order
+
+   The ranks of comm that share a node divide its cpus. Collective on
+   comm. */
+void setup_affinity(MPI_Comm comm, struct paramstype *params);
+
+/* A cpu of this rank's node that the last setup_affinity gave no OpenMP
+   thread, distinct for every rank of the node, or -1 if AFFINITY is none
+   or the threads took every cpu. For a helper thread (commthread.h). */
+int spare_cpu(void);
+
+/* Gather the cpu and NUMA node that every thread of every rank of comm is
+   running on and print the map on PROBED_RANK. Collective. */
+void print_affinity(MPI_Comm comm, struct paramstype *params);
+
+#endif
@@ -0,0 +1,556 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "balance.h"
+#include "params.h"
+#include "dstructs.h"
+#include "halo.h"
+#include "order.h"
+#include "timers.h"
+#include "utils.h"
+
+/* Faces of an element: direction d is axis d / 2, plus side for even d. */
+#define DIRECTIONS 6
+
+/* Do not migrate for less than this max / mean. */
+#define REBALANCE_TOLERANCE 1.05
+
+
+/* ------------------------------------------------------------------------- */
+/* -------------------------------- Geometry ------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static void position(balance L, int id, int pos[3], struct paramstype *params)
+/* Global element coordinates of an id. */
+{
+  int home = id / params->ELEMENTS_PER_PROCESS;
+
+  element_position(id % params->ELEMENTS_PER_PROCESS, pos);
+  pos[0] += L->coords[3 * home + 0] * params->ELEMENTS_X;
+  pos[1] += L->coords[3 * home + 1] * params->ELEMENTS_Y;
+  pos[2] += L->coords[3 * home + 2] * params->ELEMENTS_Z;
+}
+
+static int neighbor(balance L, int id, int d, struct paramstype *params)
+/* Id of the element across face d, -1 at the edge of the domain. */
+{
+  int pos[3], inside[3], box, home;
+
+  position(L, id, pos, params);
+  pos[d / 2] += (d % 2 == 0) ? 1 : -1;
+  if (pos[d / 2] < 0 || pos[d / 2] >= L->global[d / 2]) { return -1; }
+
+  box = (pos[2] / params->ELEMENTS_Z * params->CARTESIAN_Y + pos[1] / params->ELEMENTS_Y) *
+        params->CARTESIAN_X + pos[0] / params->ELEMENTS_X;
+  home = L->rank_at[box];
+  inside[0] = pos[0] % params->ELEMENTS_X;
+  inside[1] = pos[1] % params->ELEMENTS_Y;
+  inside[2] = pos[2] % params->ELEMENTS_Z;
+  return home * params->ELEMENTS_PER_PROCESS + element_index(inside);
+}
+
+static int owner(balance L, int id)
+/* Rank whose range holds id. */
+{
+  int lo = 0, hi = L->ranks - 1, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    if (L->start[mid] <= id) { lo = mid; } else { hi = mid - 1; }
+  }
+  return lo;
+}
+
+static int element_weight(balance L, int id, struct paramstype *params)
+/* Compute (A) passes of an element under LOAD_PATTERN. */
+{
+  int pos[3], a, inside = 1;
+
+  position(L, id, pos, params);
+  if (strcmp(params->LOAD_PATTERN, "ramp") == 0) {
+    if (L->global[0] < 2) { return 1; }
+    return 1 + (int) ((params->LOAD_FACTOR - 1) * pos[0] / (L->global[0] - 1.0) + 0.5);
+  }
+  if (strcmp(params->LOAD_PATTERN, "hotspot") == 0) {
+    for (a = 0; a < 3; a++) {
+      if (4 * pos[a] < L->global[a] || 4 * pos[a] >= 3 * L->global[a]) { inside = 0; }
+    }
+    return inside ? (int) params->LOAD_FACTOR : 1;
+  }
+  return 1;
+}
+
+static void own_range(balance L, struct paramstype *params)
+/* Ids, data keys and weights of the elements in this rank's range. */
+{
+  int i, EPP = params->ELEMENTS_PER_PROCESS;
+
+  L->count = L->start[L->rank + 1] - L->start[L->rank];
+  L->ids = realloc(L->ids, sizeof(int) * L->count);
+  L->key = realloc(L->key, sizeof(int) * L->count);
+  L->weight = realloc(L->weight, sizeof(int) * L->count);
+  for (i = 0; i < L->count; i++) {
+    L->ids[i] = L->start[L->rank] + i;
+    L->key[i] = L->ids[i] / EPP * EPP + lexicographic_index(L->ids[i] % EPP);
+    L->weight[i] = element_weight(L, L->ids[i], params);
+  }
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------- Face Maps ------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static void pack_face(element E, int d, dtype *out, struct paramstype *params)
+/* Face d of every block, in the order of new_extracted_faces. */
+{
+  int b, u, v, n = params->ELEMENT_SIZE, plane = (d % 2 == 0) ? n - 1 : 0;
+
+  for (b = 0; b < params->PHYSICAL_PARAMS; b++) {
+    dtype ***T = E->B[b]->T;
+    for (u = 0; u < n; u++) {
+      for (v = 0; v < n; v++) {
+        if (d / 2 == 0) { *out++ = T[plane][u][v]; }
+        else if (d / 2 == 1) { *out++ = T[u][plane][v]; }
+        else { *out++ = T[u][v][plane]; }
+      }
+    }
+  }
+}
+
+static void fold_face(element E, int d, const dtype *in, struct paramstype *params)
+/* The faked flux of unpack_faces: face d becomes the mean of both sides. */
+{
+  int b, u, v, n = params->ELEMENT_SIZE, plane = (d % 2 == 0) ? n - 1 : 0;
+  dtype *x;
+
+  for (b = 0; b < params->PHYSICAL_PARAMS; b++) {
+    dtype ***T = E->B[b]->T;
+    for (u = 0; u < n; u++) {
+      for (v = 0; v < n; v++) {
+        if (d / 2 == 0) { x = &T[plane][u][v]; }
+        else if (d / 2 == 1) { x = &T[u][plane][v]; }
+        else { x = &T[u][v][plane]; }
+        *x = 0.5 * (*x + *in++);
+      }
+    }
+  }
+}
+
+static int by_key(const void *a, const void *b)
+{
+  const int *x = a, *y = b;
+  return (x[0] > y[0]) - (x[0] < y[0]);
+}
+
+static void free_faces(balance L)
+{
+  free(L->source); free(L->local_from); free(L->peer); free(L->faces_with);
+  if (L->outgoing != NULL) {
+    memory_track(MEMORY_FACES, L->buffered[0], -1);
+    memory_track(MEMORY_FACES, L->buffered[1], -1);
+  }
+  free(L->send_from); free(L->outgoing); free(L->slots); free(L->requests);
+  L->source = L->local_from = L->peer = L->faces_with = L->send_from = NULL;
+  L->outgoing = L->slots = NULL;
+  L->requests = NULL;
+}
+
+static void build_faces(balance L, struct paramstype *params)
+/* A face we send to a peer is ordered by (our id, direction); the peer
+   orders what it expects from us by the same key, so no ids travel. */
+{
+  int i, d, p, q, nid, slot, *per_rank, *offset, (*incoming)[2], n = 0;
+  int total = L->count * DIRECTIONS;
+  size_t face = (size_t) params->PHYSICAL_PARAMS * params->FACE_SIZE;
+
+  free_faces(L);
+  L->source = malloc(sizeof(int) * (total > 0 ? total : 1));
+  L->local_from = malloc(sizeof(int) * (total > 0 ? total : 1));
+  incoming = malloc(sizeof(int[2]) * (total > 0 ? total : 1));
+  per_rank = calloc(L->ranks, sizeof(int));
+
+  /* Local pairs get their slots now; remote ones are counted per rank. */
+  L->local_faces = 0;
+  for (i = 0; i < L->count; i++) {
+    for (d = 0; d < DIRECTIONS; d++) {
+      L->source[i * DIRECTIONS + d] = -1;
+      nid = neighbor(L, L->ids[i], d, params);
+      if (nid < 0) { continue; }
+      q = owner(L, nid);
+      if (q == L->rank) {
+        L->local_from[L->local_faces] = (nid - L->start[L->rank]) * DIRECTIONS + (d ^ 1);
+        L->source[i * DIRECTIONS + d] = L->local_faces++;
+      } else {
+        per_rank[q]++;
+      }
+    }
+  }
+
+  /* Peers in rank order, each with a block of slots after the local ones. */
+  L->peers = 0;
+  for (q = 0; q < L->ranks; q++) { if (per_rank[q] > 0) { L->peers++; } }
+  L->peer = malloc(sizeof(int) * (L->peers + 1));
+  L->faces_with = malloc(sizeof(int) * (L->peers + 1));
+  offset = malloc(sizeof(int) * L->ranks);
+  for (q = 0, p = 0, L->sends = 0; q < L->ranks; q++) {
+    offset[q] = L->sends;
+    if (per_rank[q] == 0) { continue; }
+    L->peer[p] = q;
+    L->faces_with[p++] = per_rank[q];
+    L->sends += per_rank[q];
+  }
+
+  /* Outgoing faces grouped by peer, in (id, direction) order; incoming
+     ones sorted by the sender's (id, direction). */
+  L->send_from = malloc(sizeof(int) * (L->sends > 0 ? L->sends : 1));
+  memset(per_rank, 0, sizeof(int) * L->ranks);
+  for (i = 0; i < L->count; i++) {
+    for (d = 0; d < DIRECTIONS; d++) {
+      nid = neighbor(L, L->ids[i], d, params);
+      if (nid < 0 || (q = owner(L, nid)) == L->rank) { continue; }
+      L->send_from[offset[q] + per_rank[q]++] = i * DIRECTIONS + d;
+      incoming[n][0] = nid * DIRECTIONS + (d ^ 1);
+      incoming[n++][1] = i * DIRECTIONS + d;
+    }
+  }
+  qsort(incoming, n, sizeof(int[2]), by_key);
+  for (slot = 0; slot < n; slot++) {
+    L->source[incoming[slot][1]] = L->local_faces + slot;
+  }
+
+  L->buffered[0] = sizeof(dtype) * face * (L->sends > 0 ? L->sends : 1);
+  L->buffered[1] = sizeof(dtype) * face * (L->local_faces + L->sends > 0 ? L->local_faces + L->sends : 1);
+  L->outgoing = malloc(L->buffered[0]);
+  L->slots = malloc(L->buffered[1]);
+  memory_track(MEMORY_FACES, L->buffered[0], 1);
+  memory_track(MEMORY_FACES, L->buffered[1], 1);
+  L->requests = malloc(sizeof(MPI_Request) * 2 * (L->peers + 1));
+
+  free(incoming);
+  free(per_rank);
+  free(offset);
+}
+
+void exchange_mapped(element *R, balance L, struct paramstype *params)
+/* Receive into the slots, snapshot every face we give away, then fold.
+   Nothing is folded before every face has been read, so the result does
+   not depend on the order of the pairs. */
+{
+  int i, p, n = 0, at;
+  size_t face = (size_t) params->PHYSICAL_PARAMS * params->FACE_SIZE;
+  dtype *received = L->slots + face * L->local_faces;
+  regionmark m;
+
+  region_begin(&m);
+  for (p = 0, at = 0; p < L->peers; at += L->faces_with[p++]) {
+    MPI_Irecv(received + face * at, L->faces_with[p] * face, MPI_DTYPE, L->peer[p], 0,
+              L->comm, &L->requests[n++]);
+  }
+  region_end(REGION_RECV, &m);
+
+  region_begin(&m);
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < L->sends; i++) {
+    pack_face(R[L->send_from[i] / DIRECTIONS], L->send_from[i] % DIRECTIONS,
+              L->outgoing + face * i, params);
+  }
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < L->local_faces; i++) {
+    pack_face(R[L->local_from[i] / DIRECTIONS], L->local_from[i] % DIRECTIONS,
+              L->slots + face * i, params);
+  }
+  region_end(REGION_PACK, &m);
+
+  region_begin(&m);
+  for (p = 0, at = 0; p < L->peers; at += L->faces_with[p++]) {
+    MPI_Isend(L->outgoing + face * at, L->faces_with[p] * face, MPI_DTYPE, L->peer[p], 0,
+              L->comm, &L->requests[n++]);
+  }
+  region_end(REGION_SEND, &m);
+
+  region_begin(&m);
+  MPI_Waitall(n, L->requests, MPI_STATUSES_IGNORE);
+  region_end(REGION_RECV, &m);
+
+  region_begin(&m);
+  if (params->FOLD_FACES) {
+    #pragma omp parallel for schedule(static)
+    for (i = 0; i < L->count; i++) {
+      int d;
+      for (d = 0; d < DIRECTIONS; d++) {
+        if (L->source[i * DIRECTIONS + d] >= 0) {
+          fold_face(R[i], d, L->slots + face * L->source[i * DIRECTIONS + d], params);
+        }
+      }
+    }
+  }
+  region_end(REGION_UNPACK, &m);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------- Ownership ------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+balance new_balance(MPI_Comm cart_comm, struct paramstype *params)
+/* Ranges from LOAD_PATTERN, then the face maps if needed. Collective. */
+{
+  int q, total;
+  double share, shares = 0;
+  balance L = calloc(1, sizeof(balancetype));
+
+  L->comm = cart_comm;
+  MPI_Comm_rank(cart_comm, &L->rank);
+  MPI_Comm_size(cart_comm, &L->ranks);
+  L->global[0] = params->CARTESIAN_X * params->ELEMENTS_X;
+  L->global[1] = params->CARTESIAN_Y * params->ELEMENTS_Y;
+  L->global[2] = params->CARTESIAN_Z * params->ELEMENTS_Z;
+
+  L->coords = malloc(sizeof(int) * 3 * L->ranks);
+  L->rank_at = malloc(sizeof(int) * L->ranks);
+  for (q = 0; q < L->ranks; q++) {
+    MPI_Cart_coords(cart_comm, q, CARTESIAN_DIMENSIONS, &L->coords[3 * q]);
+    L->rank_at[(L->coords[3 * q + 2] * params->CARTESIAN_Y + L->coords[3 * q + 1]) *
+               params->CARTESIAN_X + L->coords[3 * q]] = q;
+  }
+
+  /* Ranges: equal, or growing linearly with the rank for "counts". Every
+     rank keeps at least one element. */
+  total = L->ranks * params->ELEMENTS_PER_PROCESS;
+  L->start = malloc(sizeof(int) * (L->ranks + 1));
+  L->start[0] = 0;
+  if (strcmp(params->LOAD_PATTERN, "counts") == 0 && L->ranks > 1) {
+    for (q = 0; q < L->ranks; q++) { shares += 1 + (params->LOAD_FACTOR - 1.0) * q / (L->ranks - 1); }
+    for (q = 1, share = 0; q < L->ranks; q++) {
+      share += 1 + (params->LOAD_FACTOR - 1.0) * (q - 1) / (L->ranks - 1);
+      L->start[q] = (int) (total * share / shares + 0.5);
+      if (L->start[q] <= L->start[q - 1]) { L->start[q] = L->start[q - 1] + 1; }
+      if (L->start[q] > total - (L->ranks - q)) { L->start[q] = total - (L->ranks - q); }
+    }
+  } else {
+    for (q = 1; q < L->ranks; q++) { L->start[q] = q * params->ELEMENTS_PER_PROCESS; }
+  }
+  L->start[L->ranks] = total;
+
+  own_range(L, params);
+  if (params->MAPPED) { build_faces(L, params); }
+  return L;
+}
+
+void delete_balance(balance L)
+{
+  free_faces(L);
+  free(L->ids);
+  free(L->key);
+  free(L->weight);
+  free(L->start);
+  free(L->coords);
+  free(L->rank_at);
+  free(L);
+}
+
+static void migrate(balance L, int *next, element **Q, element **R, struct paramstype *params)
+/* Move every element whose owner changes from the old ranges (L->start)
+   to the new ones, both contiguous, so each rank only talks to the ranks
+   whose ranges overlap its own. */
+{
+  int q, i, n = 0, lo, hi, id;
+  int a = L->start[L->rank], b = L->start[L->rank + 1];
+  int c = next[L->rank], d = next[L->rank + 1];
+  size_t block = (size_t) params->ELEMENT_SIZE * params->ELEMENT_SIZE * params->ELEMENT_SIZE;
+  size_t record = 2 * params->PHYSICAL_PARAMS * block;
+  element *nQ = malloc(sizeof(element) * (d - c)), *nR = malloc(sizeof(element) * (d - c));
+  dtype **buffers = malloc(sizeof(dtype *) * 2 * L->ranks);
+  MPI_Request *requests = malloc(sizeof(MPI_Request) * 2 * L->ranks);
+  int *from = malloc(sizeof(int) * L->ranks);
+
+  /* What we keep stays where it is in memory. */
+  for (id = (a > c ? a : c); id < (b < d ? b : d); id++) {
+    nQ[id - c] = (*Q)[id - a];
+    nR[id - c] = (*R)[id - a];
+  }
+
+  for (q = 0; q < L->ranks; q++) {
+    buffers[2 * q] = buffers[2 * q + 1] = NULL;
+    if (q == L->rank) { continue; }
+
+    /* Ours that q now owns: packed as Q then R, element by element. */
+    lo = a > next[q] ? a : next[q];
+    hi = b < next[q + 1] ? b : next[q + 1];
+    if (hi > lo) {
+      dtype *p = buffers[2 * q] = malloc(sizeof(dtype) * record * (hi - lo));
+      for (id = lo; id < hi; id++) {
+        element E[2] = { (*Q)[id - a], (*R)[id - a] };
+        int k, j;
+        for (k = 0; k < 2; k++) {
+          for (j = 0; j < params->PHYSICAL_PARAMS; j++) {
+            int row, col;
+            for (row = 0; row < params->ELEMENT_SIZE; row++) {
+              for (col = 0; col < params->ELEMENT_SIZE; col++) {
+                memcpy(p, E[k]->B[j]->T[row][col], sizeof(dtype) * params->ELEMENT_SIZE);
+                p += params->ELEMENT_SIZE;
+              }
+            }
+          }
+          delete_element(E[k], params);
+        }
+      }
+      MPI_Isend(buffers[2 * q], record * (hi - lo), MPI_DTYPE, q, 1, L->comm, &requests[n++]);
+    }
+
+    /* q's that we now own. */
+    lo = c > L->start[q] ? c : L->start[q];
+    hi = d < L->start[q + 1] ? d : L->start[q + 1];
+    from[q] = hi > lo ? lo : -1;
+    if (hi > lo) {
+      buffers[2 * q + 1] = malloc(sizeof(dtype) * record * (hi - lo));
+      MPI_Irecv(buffers[2 * q + 1], record * (hi - lo), MPI_DTYPE, q, 1, L->comm, &requests[n++]);
+    }
+  }
+
+  MPI_Waitall(n, requests, MPI_STATUSES_IGNORE);
+
+  for (q = 0; q < L->ranks; q++) {
+    if (buffers[2 * q + 1] != NULL) {
+      dtype *p = buffers[2 * q + 1];
+      hi = d < L->start[q + 1] ? d : L->start[q + 1];
+      for (id = from[q]; id < hi; id++) {
+        element E[2];
+        int k, j;
+        memory_category(MEMORY_Q);
+        E[0] = nQ[id - c] = new_element(params);
+        memory_category(MEMORY_R);
+        E[1] = nR[id - c] = new_element(params);
+        memory_category(MEMORY_OTHER);
+        for (k = 0; k < 2; k++) {
+          for (j = 0; j < params->PHYSICAL_PARAMS; j++) {
+            int row, col;
+            for (row = 0; row < params->ELEMENT_SIZE; row++) {
+              for (col = 0; col < params->ELEMENT_SIZE; col++) {
+                memcpy(E[k]->B[j]->T[row][col], p, sizeof(dtype) * params->ELEMENT_SIZE);
+                p += params->ELEMENT_SIZE;
+              }
+            }
+          }
+        }
+      }
+    }
+    free(buffers[2 * q]);
+    free(buffers[2 * q + 1]);
+  }
+
+  free(*Q);
+  free(*R);
+  *Q = nQ;
+  *R = nR;
+  for (i = 0; i <= L->ranks; i++) { L->start[i] = next[i]; }
+  own_range(L, params);
+  build_faces(L, params);
+
+  free(buffers);
+  free(requests);
+  free(from);
+}
+
+void rebalance(balance L, element **Q, element **R, int step, struct paramstype *params)
+/* Split the measured cost into equal parts along the curve with a prefix
+   sum: each rank finds the boundaries that fall inside its own range. */
+{
+  int i, k, q, moved = 0, weights = 0, lo, hi, *next = malloc(sizeof(int) * (L->ranks + 1));
+  double mine = L->compute, total, slowest, offset = 0, cost, at, target;
+
+  MPI_Allreduce(&mine, &total, 1, MPI_DOUBLE, MPI_SUM, L->comm);
+  MPI_Allreduce(&mine, &slowest, 1, MPI_DOUBLE, MPI_MAX, L->comm);
+  MPI_Exscan(&mine, &offset, 1, MPI_DOUBLE, MPI_SUM, L->comm);
+  if (L->rank == 0) { offset = 0; }
+  L->compute = 0;
+
+  if (total <= 0 || strcmp(params->REBALANCE_POLICY, "measure") == 0 ||
+      slowest * L->ranks < REBALANCE_TOLERANCE * total) {
+    if (L->rank == 0) {
+      printf("Rebalance after step %d: compute (A) imbalance %.3f, nothing moved.\n", step,
+             total > 0 ? slowest * L->ranks / total : 1.0);
+    }
+    free(next);
+    return;
+  }
+
+  /* Our elements share our time by weight; boundary k goes to the element
+     where the running cost crosses k / ranks of the total. */
+  for (i = 0; i < L->count; i++) { weights += L->weight[i]; }
+  for (k = 0; k <= L->ranks; k++) { next[k] = -1; }
+  for (i = 0, at = offset; i < L->count; i++, at += cost) {
+    cost = mine * L->weight[i] / weights;
+    for (k = 1; k < L->ranks; k++) {
+      target = total * k / L->ranks;
+      if (target >= at && target < at + cost) {
+        next[k] = L->ids[i] + (target - at > cost / 2 ? 1 : 0);
+      }
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, next, L->ranks + 1, MPI_INT, MPI_MAX, L->comm);
+  next[0] = 0;
+  next[L->ranks] = L->start[L->ranks];
+
+  for (k = 1; k < L->ranks; k++) {
+    if (next[k] < 0) { next[k] = L->start[k]; }
+    if (strcmp(params->REBALANCE_POLICY, "diffusion") == 0) {
+      next[k] = L->start[k] + (next[k] - L->start[k]) / 2;
+      if (next[k] < L->start[k - 1] + 1) { next[k] = L->start[k - 1] + 1; }
+      if (next[k] > L->start[k + 1] - 1) { next[k] = L->start[k + 1] - 1; }
+    }
+  }
+
+  /* Every rank keeps at least one element. */
+  for (k = 1; k < L->ranks; k++) { if (next[k] <= next[k - 1]) { next[k] = next[k - 1] + 1; } }
+  for (k = L->ranks - 1; k > 0; k--) { if (next[k] >= next[k + 1]) { next[k] = next[k + 1] - 1; } }
+
+  for (q = 0; q < L->ranks; q++) {
+    lo = L->start[q] > next[q] ? L->start[q] : next[q];
+    hi = L->start[q + 1] < next[q + 1] ? L->start[q + 1] : next[q + 1];
+    moved += (L->start[q + 1] - L->start[q]) - (hi > lo ? hi - lo : 0);
+  }
+
+  migrate(L, next, Q, R, params);
+  L->rebalances++;
+  L->moved += moved;
+
+  if (L->rank == 0) {
+    int fewest = L->start[1] - L->start[0], most = fewest;
+    for (q = 1; q < L->ranks; q++) {
+      int n = L->start[q + 1] - L->start[q];
+      if (n < fewest) { fewest = n; }
+      if (n > most) { most = n; }
+    }
+    printf("Rebalance after step %d: compute (A) imbalance %.3f, moved %d elements (%s), "
+           "now %d to %d per rank.\n", step, slowest * L->ranks / total, moved,
+           params->REBALANCE_POLICY, fewest, most);
+  }
+  free(next);
+}
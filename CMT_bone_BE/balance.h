@@ -0,0 +1,103 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BALANCE_H_
+#define BALANCE_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+#include "dstructs.h"
+
+
+/* ---------------------------- Element Ownership -------------------------- */
+
+/* Every element has a global id: rank * ELEMENTS_PER_PROCESS + e for the
+   element e of rank's own box, so ids follow the ranks' boxes in order and,
+   inside a box, the ELEMENT_ORDER curve (order.h). A rank owns one contiguous range of ids along
+   that curve; with LOAD_PATTERN "none" and no rebalancing that range is its
+   own box and nothing changes from the fixed layout.
+
+   Otherwise (params->MAPPED) the ranges can differ in length and move, and
+   the face exchange follows explicit face maps instead: every face shared
+   by two elements, on this rank or another, is averaged from both sides'
+   values before the exchange, so results do not depend on who owns what. */
+typedef struct {
+  MPI_Comm comm;
+  int rank, ranks;
+  int count;            // elements on this rank
+  int *ids;             // their global ids, ascending
+  int *key;             // their ids under the lexicographic ordering, which key the random data
+  int *weight;          // Compute (A) passes of each: its cost relative to a plain element
+  int *start;           // first id of every rank, ranks + 1 entries
+  int *coords;          // cartesian coordinates of every rank, 3 each
+  int *rank_at;         // rank of every box, x fastest
+  int global[3];        // elements along x, y and z over all ranks
+
+  /* Face maps, rebuilt whenever ownership changes. */
+  int *source;          // per element and direction: slot of the facing face, -1 for none
+  int local_faces;      // slots filled from our own elements ...
+  int *local_from;      // ... and which (element * 6 + direction) fills each
+  int peers;            // ranks we share faces with
+  int *peer, *faces_with;   // who, and how many faces each way
+  int *send_from;       // (element * 6 + direction) of every outgoing face, by peer
+  int sends;
+  dtype *outgoing, *slots;  // packed faces: outgoing, then local and received slots
+  long buffered[2];     // their sizes in bytes
+  MPI_Request *requests;
+
+  double compute;       // Compute (A) seconds since the last rebalance
+  int rebalances, moved;
+} balancetype, *balance;
+
+/* Initial ownership from LOAD_PATTERN and LOAD_FACTOR:
+     none     |  every rank its own box, every weight 1
+     counts   |  rank r owns a share growing linearly to LOAD_FACTOR times
+                 rank 0's, every weight 1
+     ramp     |  own boxes, weights growing from 1 to LOAD_FACTOR along x
+     hotspot  |  own boxes, weight LOAD_FACTOR in the central eighth of the
+                 domain (a particle-laden region), 1 elsewhere
+   Face maps are only built when params->MAPPED. Collective on cart_comm. */
+balance new_balance(MPI_Comm cart_comm, struct paramstype *params);
+void delete_balance(balance L);
+
+/* Average every shared face of R's elements with the facing element's,
+   local or remote. Collective on L's communicator. */
+void exchange_mapped(element *R, balance L, struct paramstype *params);
+
+/* Compare the Compute (A) time of every rank since the last call and, by
+   REBALANCE_POLICY, move whole elements (Q and R; the geometry, RX, is
+   shared) along the id curve:
+     diffusion  |  each boundary moves halfway towards its balanced position,
+                   and never past a neighbor's range, so elements only move
+                   between neighbors on the curve
+     sfc        |  boundaries go straight to the balanced position
+     measure    |  only report the imbalance
+   The balanced position splits the measured cost, spread over each rank's
+   elements by weight, into equal parts. *Q and *R are reallocated and the
+   face maps rebuilt. step is only used in the report. Collective. */
+void rebalance(balance L, element **Q, element **R, int step, struct paramstype *params);
+
+#endif
@@ -0,0 +1,567 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Standalone kernel microbenchmark (no MPI). Drives each flux.c kernel of
+  each variant, and the face extraction, over a sweep of ELEMENT_SIZE and
+  batch sizes, and prints one CSV row per configuration:
+
+    variant,kernel,N,batch,cache,median_us,p10_us,p90_us,gflop/s,gbyte/s,max_rel_err
+
+  Times are per block. max_rel_err is against the reference variant on the
+  same inputs (0 for the reference itself). A whole-element variant runs
+  conv, dr, ds, dt and sum through its *_params members, one element of
+  PHYSICAL_PARAMS blocks per call, and is compared with the reference on
+  every block of element 0. The tiled derivatives (flux.h) appear as
+  variant "tiled", run over the whole batch as one tile.
+
+  Usage: ./cmtbench [-n MIN:MAX[:STEP]] [-b B1,B2,..] [-p PARAMS] [-r REPS]
+                    [-w WARMUP] [-c warm|cold|both] [-f FLUSH_MB]
+                    [-k KERNEL] [-v VARIANT]
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "params.h"
+#include "dstructs.h"
+#include "flux.h"
+#include "utils.h"
+#include "rng.h"
+
+
+#define MAX_BATCHES 16
+#define FACES KERNEL_COUNT   /* pseudo kernel id for new_extracted_faces */
+
+/* How a kernel is driven: block by block through a variant's per-block
+   members, a whole element at a time through its *_params members (conv
+   to sum only), or over the whole batch as one tile (dr, ds and dt only). */
+enum { DRIVE_BLOCK, DRIVE_ELEMENT, DRIVE_TILE };
+
+
+/* ---------------------------- Bench Options ------------------------------ */
+
+typedef struct {
+  int n_min, n_max, n_step;
+  int batches[MAX_BATCHES], batch_count;
+  int physical_params;
+  int reps, warmup;
+  int warm, cold;
+  int flush_mb;
+  const char *kernel;     // NULL for all
+  const char *variant;    // NULL for all
+} benchoptions;
+
+/* Operands for one (N, batch) configuration. */
+typedef struct {
+  int batch;
+  matrix kernel;
+  ternix RX[9];
+  dtype coef[3];          // conv constants
+  ternix *Q, *R;          // batch blocks each
+  ternix *V;              // batch blocks, the outputs of a tile
+  element *E;             // batch elements, for face extraction and *_params
+  element *F;             // batch elements, the outputs of sum_params
+  dtype *W;               // interleaved work area of one element (flux.h)
+  dtype *coefs;           // coef for every block of an element
+  scratch S;
+} benchdata;
+
+static char *flush_buffer = NULL;
+
+
+/* ------------------------------------------------------------------------- */
+/* -------------------------------- Helpers -------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static void flush_caches(int mb)
+/* Evict the operands from every cache level by streaming over a buffer
+   larger than the last level cache. */
+{
+  long i, n = (long) mb * 1024 * 1024;
+  volatile char sink = 0;
+
+  if (flush_buffer == NULL) { flush_buffer = calloc(n, 1); }
+  for (i = 0; i < n; i += 64) { flush_buffer[i]++; }
+  for (i = 0; i < n; i += 64) { sink ^= flush_buffer[i]; }
+  (void) sink;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(double *sorted, int n, double p)
+/* Nearest-rank percentile of a sorted sample. */
+{
+  int i = (int) ceil(p / 100.0 * n) - 1;
+  if (i < 0) { i = 0; }
+  if (i >= n) { i = n - 1; }
+  return sorted[i];
+}
+
+static double max_rel_err(ternix ref, ternix X)
+/* Largest absolute difference, relative to the largest reference value. */
+{
+  int i, j, k;
+  double diff = 0, scale = 0;
+
+  for (i = 0; i < ref->rows; i++) {
+    for (j = 0; j < ref->cols; j++) {
+      for (k = 0; k < ref->layers; k++) {
+        diff = fmax(diff, fabs(ref->T[i][j][k] - X->T[i][j][k]));
+        scale = fmax(scale, fabs(ref->T[i][j][k]));
+      }
+    }
+  }
+  return scale > 0 ? diff / scale : diff;
+}
+
+static void copy_ternix(ternix from, ternix to)
+{
+  int i, j, k;
+  for (i = 0; i < from->rows; i++) {
+    for (j = 0; j < from->cols; j++) {
+      for (k = 0; k < from->layers; k++) { to->T[i][j][k] = from->T[i][j][k]; }
+    }
+  }
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Bench Setup ------------------------------ */
+/* ------------------------------------------------------------------------- */
+
+static void setup_bench_params(int N, int batch, int physical_params, struct paramstype *params)
+/* A single-rank parameter set whose faces hold the whole batch. */
+{
+  memset(params, 0, sizeof(*params));
+  params->TIMESTEPS = 1;
+  params->RK = 1;
+  params->THREADS = 1;
+  params->ELEMENT_SIZE = N;
+  params->PHYSICAL_PARAMS = physical_params;
+  params->ELEMENTS_X = batch;
+  params->ELEMENTS_Y = 1;
+  params->ELEMENTS_Z = 1;
+  params->ELEMENTS_PER_PROCESS = batch;
+  params->ELEMENTS_ON_X_FACE = batch;
+  params->ELEMENTS_ON_Y_FACE = batch;
+  params->ELEMENTS_ON_Z_FACE = batch;
+  params->FACE_SIZE = N * N;
+}
+
+static void new_bench_data(benchdata *D, int batch, struct paramstype *params)
+{
+  int i, N = params->ELEMENT_SIZE;
+  long l;
+
+  D->batch = batch;
+  D->kernel = new_random_matrix(N, N, -10, 10);
+  for (i = 0; i < 9; i++) { D->RX[i] = new_random_ternix(N, N, N, -1, 1); }
+  for (i = 0; i < 3; i++) { D->coef[i] = rng_uniform(rng_stream(RNG_CONV), i); }
+
+  D->Q = malloc(sizeof(ternix) * batch);
+  D->R = malloc(sizeof(ternix) * batch);
+  D->V = malloc(sizeof(ternix) * batch);
+  D->E = malloc(sizeof(element) * batch);
+  D->F = malloc(sizeof(element) * batch);
+  for (i = 0; i < batch; i++) {
+    D->Q[i] = new_random_ternix(N, N, N, 0, 10);
+    D->R[i] = new_random_ternix(N, N, N, 0, 10);
+    D->V[i] = new_ternix(N, N, N);
+    D->E[i] = new_random_element(0, 10, params);
+    D->F[i] = new_zero_element(params);
+  }
+  D->S = new_scratch(params);
+
+  /* Every array of W gets inputs, so each *_params kernel can run alone. */
+  D->W = malloc(sizeof(dtype) * interleaved_values(params));
+  for (l = 0; l < interleaved_values(params); l++) { D->W[l] = 10.0 * rand() / RAND_MAX; }
+  D->coefs = malloc(sizeof(dtype) * 3 * params->PHYSICAL_PARAMS);
+  for (i = 0; i < 3 * params->PHYSICAL_PARAMS; i++) { D->coefs[i] = D->coef[i % 3]; }
+}
+
+static void delete_bench_data(benchdata *D, struct paramstype *params)
+{
+  int i;
+
+  delete_matrix(D->kernel);
+  for (i = 0; i < 9; i++) { delete_ternix(D->RX[i]); }
+  for (i = 0; i < D->batch; i++) {
+    delete_ternix(D->Q[i]);
+    delete_ternix(D->R[i]);
+    delete_ternix(D->V[i]);
+    delete_element(D->E[i], params);
+    delete_element(D->F[i], params);
+  }
+  free(D->Q);
+  free(D->R);
+  free(D->V);
+  free(D->E);
+  free(D->F);
+  free(D->W);
+  free(D->coefs);
+  delete_scratch(D->S);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Bench Driver ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static ternix run_kernel(const kernelset *K, int kernel, benchdata *D, int b,
+                         struct paramstype *params)
+/* Run one kernel on block b of the batch. Returns the ternix it wrote. */
+{
+  scratch S = D->S;
+
+  switch (kernel) {
+  case KERNEL_CONV:
+    K->conv(D->Q[b], D->RX, D->coef, S->Ur, S->Us, S->Ut, params);
+    return S->Ur;
+  case KERNEL_DR: K->dr(D->kernel, D->Q[b], S->Vr, params); return S->Vr;
+  case KERNEL_DS: K->ds(D->kernel, D->Q[b], S->Vs, params); return S->Vs;
+  case KERNEL_DT: K->dt(D->kernel, D->Q[b], S->Vt, params); return S->Vt;
+  case KERNEL_SUM: K->sum(D->Q[b], S->Ur, S->Vr, D->R[b], params); return D->R[b];
+  case KERNEL_RK: K->rk(D->R[b], D->Q[b], params); return D->R[b];
+  case FACES: delete_vector(new_extracted_faces(D->E, NULL, b % 3, 1, params)); return NULL;
+  }
+  return NULL;
+}
+
+static void run_element(const kernelset *K, int kernel, benchdata *D, int e,
+                        struct paramstype *params)
+/* Run one whole-element kernel on element e of the batch, through W. */
+{
+  switch (kernel) {
+  case KERNEL_CONV: K->conv_params(D->E[e], D->RX, D->coefs, D->W, params); break;
+  case KERNEL_DR: K->dr_params(D->kernel, D->W, params); break;
+  case KERNEL_DS: K->ds_params(D->kernel, D->W, params); break;
+  case KERNEL_DT: K->dt_params(D->kernel, D->W, params); break;
+  case KERNEL_SUM: K->sum_params(D->W, D->F[e], params); break;
+  }
+}
+
+static void run_tile(int kernel, benchdata *D, struct paramstype *params)
+/* Run one tiled derivative over the whole batch, Q into V. */
+{
+  switch (kernel) {
+  case KERNEL_DR: operation_dr_tile(D->kernel, D->Q, D->V, D->batch, params); break;
+  case KERNEL_DS: operation_ds_tile(D->kernel, D->Q, D->V, D->batch, params); break;
+  case KERNEL_DT: operation_dt_tile(D->kernel, D->Q, D->V, D->batch, params); break;
+  }
+}
+
+static double run_batch(const kernelset *K, int drive, int kernel, benchdata *D,
+                        struct paramstype *params)
+/* Seconds per block for one pass over the batch. Face extraction handles
+   the whole batch per call, so it is called once per axis; a tile is one
+   call; a whole-element kernel does PHYSICAL_PARAMS blocks per call. */
+{
+  int b, calls = (kernel == FACES) ? 3 : D->batch;
+  struct timespec t0, t1;
+
+  t0 = now();
+  if (drive == DRIVE_TILE) { run_tile(kernel, D, params); }
+  else if (drive == DRIVE_ELEMENT) { for (b = 0; b < calls; b++) { run_element(K, kernel, D, b, params); } }
+  else { for (b = 0; b < calls; b++) { run_kernel(K, kernel, D, b, params); } }
+  t1 = now();
+
+  if (drive == DRIVE_ELEMENT) { return tdiff(t0, t1) / ((double) D->batch * params->PHYSICAL_PARAMS); }
+  return tdiff(t0, t1) / ((kernel == FACES) ? 3 * D->batch : D->batch);
+}
+
+static void unpack_param(const dtype *W, int array, int p, ternix X, struct paramstype *params)
+/* Block p of one of W's arrays, as a ternix. */
+{
+  int i, j, k, N = params->ELEMENT_SIZE, P = params->PHYSICAL_PARAMS;
+  const dtype *w = W + array * interleaved_values(params) / W_ARRAYS;
+
+  for (i = 0; i < N; i++) {
+    for (j = 0; j < N; j++) {
+      for (k = 0; k < N; k++) { X->T[i][j][k] = w[((i * N + j) * N + k) * P + p]; }
+    }
+  }
+}
+
+static double compare_element(const kernelset *K, int kernel, benchdata *D,
+                              struct paramstype *params)
+/* Max relative error of a whole-element kernel of K against the reference
+   per-block kernel on every block of element 0. The whole element goes
+   through conv to sum once; each block's reference then starts from the
+   inputs the kernel under test was given (unpacked from W). */
+{
+  const kernelset *ref = &kernel_variants[0];
+  int p, N = params->ELEMENT_SIZE;
+  double err = 0;
+  ternix X = new_ternix(N, N, N), Y = new_ternix(N, N, N), Z = new_ternix(N, N, N);
+  ternix out = new_ternix(N, N, N);
+  scratch S = D->S;
+
+  K->conv_params(D->E[0], D->RX, D->coefs, D->W, params);
+  K->dr_params(D->kernel, D->W, params);
+  K->ds_params(D->kernel, D->W, params);
+  K->dt_params(D->kernel, D->W, params);
+  K->sum_params(D->W, D->F[0], params);
+
+  for (p = 0; p < params->PHYSICAL_PARAMS; p++) {
+    switch (kernel) {
+    case KERNEL_CONV:
+      ref->conv(D->E[0]->B[p], D->RX, D->coef, S->Ur, S->Us, S->Ut, params);
+      unpack_param(D->W, W_UR, p, out, params);
+      err = fmax(err, max_rel_err(S->Ur, out));
+      unpack_param(D->W, W_US, p, out, params);
+      err = fmax(err, max_rel_err(S->Us, out));
+      unpack_param(D->W, W_UT, p, out, params);
+      err = fmax(err, max_rel_err(S->Ut, out));
+      break;
+    case KERNEL_DR:
+    case KERNEL_DS:
+    case KERNEL_DT:
+      unpack_param(D->W, W_UR + kernel - KERNEL_DR, p, X, params);
+      if (kernel == KERNEL_DR) { ref->dr(D->kernel, X, Y, params); }
+      if (kernel == KERNEL_DS) { ref->ds(D->kernel, X, Y, params); }
+      if (kernel == KERNEL_DT) { ref->dt(D->kernel, X, Y, params); }
+      unpack_param(D->W, W_VR + kernel - KERNEL_DR, p, out, params);
+      err = fmax(err, max_rel_err(Y, out));
+      break;
+    case KERNEL_SUM:
+      unpack_param(D->W, W_VR, p, X, params);
+      unpack_param(D->W, W_VS, p, Y, params);
+      unpack_param(D->W, W_VT, p, Z, params);
+      ref->sum(X, Y, Z, out, params);
+      err = fmax(err, max_rel_err(out, D->F[0]->B[p]));
+      break;
+    }
+  }
+
+  delete_ternix(X);
+  delete_ternix(Y);
+  delete_ternix(Z);
+  delete_ternix(out);
+  return err;
+}
+
+static double compare_variant(const kernelset *K, int drive, int kernel, benchdata *D,
+                              struct paramstype *params)
+/* Max relative error of variant K against the reference on block 0, or of
+   the tile on every block of it. The in-place kernels (rk) start from the
+   same inputs in both runs. */
+{
+  int b, N = params->ELEMENT_SIZE;
+  double err = 0;
+  ternix out, ref = new_ternix(N, N, N), saved = new_ternix(N, N, N);
+
+  if (kernel == FACES || (drive == DRIVE_BLOCK && K == &kernel_variants[0])) {
+    delete_ternix(ref);
+    delete_ternix(saved);
+    return 0;
+  }
+  if (drive == DRIVE_ELEMENT) {
+    delete_ternix(ref);
+    delete_ternix(saved);
+    return compare_element(K, kernel, D, params);
+  }
+
+  /* The derivatives leave their inputs alone. */
+  if (drive == DRIVE_TILE) {
+    run_tile(kernel, D, params);
+    for (b = 0; b < D->batch; b++) {
+      out = run_kernel(&kernel_variants[0], kernel, D, b, params);
+      err = fmax(err, max_rel_err(out, D->V[b]));
+    }
+    delete_ternix(ref);
+    delete_ternix(saved);
+    return err;
+  }
+
+  copy_ternix(D->R[0], saved);
+
+  out = run_kernel(&kernel_variants[0], kernel, D, 0, params);
+  copy_ternix(out, ref);
+
+  copy_ternix(saved, D->R[0]);
+  out = run_kernel(K, kernel, D, 0, params);
+  err = max_rel_err(ref, out);
+
+  delete_ternix(ref);
+  delete_ternix(saved);
+  return err;
+}
+
+static void bench_one(const kernelset *K, int drive, int kernel, benchdata *D, int cold,
+                      benchoptions *opt, struct paramstype *params)
+/* Warm up, time opt->reps passes and print the CSV row. */
+{
+  int r;
+  double samples[opt->reps], median, flops, bytes, err;
+
+  for (r = 0; r < opt->warmup; r++) { run_batch(K, drive, kernel, D, params); }
+
+  for (r = 0; r < opt->reps; r++) {
+    if (cold) { flush_caches(opt->flush_mb); }
+    samples[r] = run_batch(K, drive, kernel, D, params);
+  }
+  qsort(samples, opt->reps, sizeof(double), compare_doubles);
+
+  if (kernel == FACES) {
+    /* One face per element per call, read from the element and written out. */
+    flops = 0;
+    bytes = 2.0 * params->PHYSICAL_PARAMS * params->FACE_SIZE * sizeof(dtype);
+  } else {
+    flops = kernel_flops(kernel, params);
+    bytes = kernel_bytes(kernel, params);
+  }
+
+  median = percentile(samples, opt->reps, 50);
+  err = compare_variant(K, drive, kernel, D, params);
+
+  printf("%s,%s,%d,%d,%s,%.4f,%.4f,%.4f,%.3f,%.3f,%.3e\n",
+         drive == DRIVE_TILE ? "tiled" : K->name, kernel == FACES ? "faces" : kernel_names[kernel],
+         params->ELEMENT_SIZE, D->batch, cold ? "cold" : "warm",
+         1E6 * median, 1E6 * percentile(samples, opt->reps, 10),
+         1E6 * percentile(samples, opt->reps, 90),
+         median > 0 ? flops / median / 1E9 : 0,
+         median > 0 ? bytes / median / 1E9 : 0, err);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* --------------------------------- Main ---------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static void parse_options(int argc, char *argv[], benchoptions *opt)
+{
+  int c;
+  char *token;
+
+  opt->n_min = 5; opt->n_max = 25; opt->n_step = 5;
+  opt->batches[0] = 1; opt->batches[1] = 16; opt->batches[2] = 128;
+  opt->batch_count = 3;
+  opt->physical_params = 5;
+  opt->reps = 21;
+  opt->warmup = 3;
+  opt->warm = 1; opt->cold = 1;
+  opt->flush_mb = 64;
+  opt->kernel = NULL;
+  opt->variant = NULL;
+
+  while ((c = getopt(argc, argv, "n:b:p:r:w:c:f:k:v:h")) != -1) {
+    switch (c) {
+    case 'n':
+      opt->n_step = 1;
+      if (sscanf(optarg, "%d:%d:%d", &opt->n_min, &opt->n_max, &opt->n_step) < 2) {
+        opt->n_max = opt->n_min;
+      }
+      break;
+    case 'b':
+      opt->batch_count = 0;
+      for (token = strtok(optarg, ","); token != NULL && opt->batch_count < MAX_BATCHES;
+           token = strtok(NULL, ",")) {
+        opt->batches[opt->batch_count++] = atoi(token);
+      }
+      break;
+    case 'p': opt->physical_params = atoi(optarg); break;
+    case 'r': opt->reps = atoi(optarg); break;
+    case 'w': opt->warmup = atoi(optarg); break;
+    case 'c':
+      opt->warm = (strcmp(optarg, "warm") == 0 || strcmp(optarg, "both") == 0);
+      opt->cold = (strcmp(optarg, "cold") == 0 || strcmp(optarg, "both") == 0);
+      break;
+    case 'f': opt->flush_mb = atoi(optarg); break;
+    case 'k': opt->kernel = optarg; break;
+    case 'v': opt->variant = optarg; break;
+    default:
+      printf("Usage: %s [-n MIN:MAX[:STEP]] [-b B1,B2,..] [-p PARAMS] [-r REPS] [-w WARMUP]\n"
+             "       [-c warm|cold|both] [-f FLUSH_MB] [-k KERNEL] [-v VARIANT]\n", argv[0]);
+      exit(c == 'h' ? 0 : 1);
+    }
+  }
+
+  if (opt->reps < 1) { opt->reps = 1; }
+  if (opt->n_step < 1) { opt->n_step = 1; }
+  if (opt->physical_params < 1) { opt->physical_params = 1; }
+}
+
+int main(int argc, char *argv[])
+{
+  int N, bi, v, k, cold, drive;
+  struct paramstype params;
+  benchoptions opt;
+  benchdata D;
+
+  parse_options(argc, argv, &opt);
+  srand(11);
+
+  printf("variant,kernel,N,batch,cache,median_us,p10_us,p90_us,gflop/s,gbyte/s,max_rel_err\n");
+
+  for (N = opt.n_min; N <= opt.n_max; N += opt.n_step) {
+    for (bi = 0; bi < opt.batch_count; bi++) {
+      if (opt.batches[bi] < 1) { continue; }
+
+      setup_bench_params(N, opt.batches[bi], opt.physical_params, &params);
+      new_bench_data(&D, opt.batches[bi], &params);
+
+      for (v = 0; v < kernel_variant_count; v++) {
+        if (opt.variant != NULL && strcmp(opt.variant, kernel_variants[v].name) != 0) { continue; }
+
+        /* Face extraction has no variants; run it with the reference only. */
+        for (k = 0; k <= FACES; k++) {
+          if (k == FACES && v != 0) { continue; }
+
+          /* A whole-element variant's own kernels are conv to sum. */
+          drive = (kernel_variants[v].conv_params != NULL && k <= KERNEL_SUM) ? DRIVE_ELEMENT : DRIVE_BLOCK;
+          if (opt.kernel != NULL &&
+              strcmp(opt.kernel, k == FACES ? "faces" : kernel_names[k]) != 0) { continue; }
+
+          for (cold = 0; cold <= 1; cold++) {
+            if ((cold && !opt.cold) || (!cold && !opt.warm)) { continue; }
+            bench_one(&kernel_variants[v], drive, k, &D, cold, &opt, &params);
+          }
+        }
+      }
+
+      /* The tiled derivatives of Compute (A), the batch as one tile. */
+      for (k = KERNEL_DR; k <= KERNEL_DT; k++) {
+        if (opt.variant != NULL && strcmp(opt.variant, "tiled") != 0) { continue; }
+        if (opt.kernel != NULL && strcmp(opt.kernel, kernel_names[k]) != 0) { continue; }
+
+        for (cold = 0; cold <= 1; cold++) {
+          if ((cold && !opt.cold) || (!cold && !opt.warm)) { continue; }
+          bench_one(NULL, DRIVE_TILE, k, &D, cold, &opt, &params);
+        }
+      }
+
+      delete_bench_data(&D, &params);
+    }
+  }
+
+  free(flush_buffer);
+  return 0;
+}
@@ -0,0 +1,437 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mpi.h>
+
+#include "checkpoint.h"
+#include "params.h"
+#include "dstructs.h"
+#include "halo.h"
+#include "order.h"
+#include "utils.h"
+
+/* Data starts here, so that the records are aligned for the file system. */
+#define CHECKPOINT_HEADER_BYTES 4096
+#define CHECKPOINT_MAGIC "CMTCKPT"
+#define CHECKPOINT_VERSION 1
+
+typedef struct {
+  char magic[8];
+  int version;
+  int complete;         // set only after every rank's data is in the file
+  int step;             // timesteps done when Q was taken
+  int element_size, physical_params, dtype_bytes;
+  int global[3];        // elements in x, y and z over all ranks
+} headertype;
+
+typedef struct {
+  MPI_Comm comm;
+  MPI_Datatype record, view;
+  int rank, elements, record_size;
+  dtype *buffer[2];     // double buffer: one packing while the other drains
+  MPI_File file;
+  MPI_Request request;
+  int pending, slot, step;
+  int written;
+  double blocked, drain, mb;
+  struct timespec started;
+  int drained;
+} checkpointstate;
+
+static checkpointstate C;
+
+
+/* ------------------------------------------------------------------------- */
+/* --------------------------------- Layout -------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static void slot_name(struct paramstype *params, int slot, char *name, int size)
+{
+  snprintf(name, size, "%s.%c", params->CHECKPOINT_FILE, '0' + slot);
+}
+
+static void fill_header(headertype *H, int complete, int step, struct paramstype *params)
+{
+  memset(H, 0, sizeof(headertype));
+  memcpy(H->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  H->version = CHECKPOINT_VERSION;
+  H->complete = complete;
+  H->step = step;
+  H->element_size = params->ELEMENT_SIZE;
+  H->physical_params = params->PHYSICAL_PARAMS;
+  H->dtype_bytes = sizeof(dtype);
+  H->global[0] = params->CARTESIAN_X * params->ELEMENTS_X;
+  H->global[1] = params->CARTESIAN_Y * params->ELEMENTS_Y;
+  H->global[2] = params->CARTESIAN_Z * params->ELEMENTS_Z;
+}
+
+static int header_matches(headertype *H, headertype *expect)
+/* A complete file of this version holding this problem. */
+{
+  return memcmp(H->magic, expect->magic, sizeof(H->magic)) == 0 &&
+         H->version == CHECKPOINT_VERSION && H->complete &&
+         H->element_size == expect->element_size && H->physical_params == expect->physical_params &&
+         H->dtype_bytes == expect->dtype_bytes && memcmp(H->global, expect->global, sizeof(H->global)) == 0;
+}
+
+static void build_types(MPI_Comm cart_comm, struct paramstype *params)
+/* One element record, and this rank's box of records in the global grid. */
+{
+  int coords[CARTESIAN_DIMENSIONS];
+  int sizes[3], subsizes[3], starts[3];
+
+  MPI_Comm_rank(cart_comm, &C.rank);
+  MPI_Cart_coords(cart_comm, C.rank, CARTESIAN_DIMENSIONS, coords);
+
+  C.record_size = params->PHYSICAL_PARAMS * params->ELEMENT_SIZE * params->ELEMENT_SIZE *
+                  params->ELEMENT_SIZE;
+  MPI_Type_contiguous(C.record_size, MPI_DTYPE, &C.record);
+  MPI_Type_commit(&C.record);
+
+  /* C order: z slowest, x fastest. */
+  sizes[0] = params->CARTESIAN_Z * params->ELEMENTS_Z;
+  sizes[1] = params->CARTESIAN_Y * params->ELEMENTS_Y;
+  sizes[2] = params->CARTESIAN_X * params->ELEMENTS_X;
+  subsizes[0] = params->ELEMENTS_Z;
+  subsizes[1] = params->ELEMENTS_Y;
+  subsizes[2] = params->ELEMENTS_X;
+  starts[0] = coords[2] * params->ELEMENTS_Z;
+  starts[1] = coords[1] * params->ELEMENTS_Y;
+  starts[2] = coords[0] * params->ELEMENTS_X;
+
+  MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, C.record, &C.view);
+  MPI_Type_commit(&C.view);
+}
+
+static void pack_q(element *Q, dtype *buffer, struct paramstype *params)
+/* Records go x fastest within the box, whatever the element ordering. */
+{
+  int e;
+
+  #pragma omp parallel for schedule(static)
+  for (e = 0; e < params->ELEMENTS_PER_PROCESS; e++) {
+    int b, row, col, layer;
+    dtype *p = buffer + (size_t) lexicographic_index(e) * C.record_size;
+    for (b = 0; b < params->PHYSICAL_PARAMS; b++) {
+      for (row = 0; row < params->ELEMENT_SIZE; row++) {
+        for (col = 0; col < params->ELEMENT_SIZE; col++) {
+          for (layer = 0; layer < params->ELEMENT_SIZE; layer++) {
+            *p++ = Q[e]->B[b]->T[row][col][layer];
+          }
+        }
+      }
+    }
+  }
+}
+
+static void unpack_q(element *Q, dtype *buffer, struct paramstype *params)
+{
+  int e;
+
+  #pragma omp parallel for schedule(static)
+  for (e = 0; e < params->ELEMENTS_PER_PROCESS; e++) {
+    int b, row, col, layer;
+    dtype *p = buffer + (size_t) lexicographic_index(e) * C.record_size;
+    for (b = 0; b < params->PHYSICAL_PARAMS; b++) {
+      for (row = 0; row < params->ELEMENT_SIZE; row++) {
+        for (col = 0; col < params->ELEMENT_SIZE; col++) {
+          for (layer = 0; layer < params->ELEMENT_SIZE; layer++) {
+            Q[e]->B[b]->T[row][col][layer] = *p++;
+          }
+        }
+      }
+    }
+  }
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* -------------------------------- Writing -------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+void setup_checkpoints(MPI_Comm cart_comm, struct paramstype *params)
+/* Types, buffers and counters. Collective. */
+{
+  memset(&C, 0, sizeof(C));
+  C.comm = cart_comm;
+  C.elements = params->ELEMENTS_PER_PROCESS;
+  build_types(cart_comm, params);
+
+  C.buffer[0] = malloc(sizeof(dtype) * C.record_size * C.elements);
+  C.buffer[1] = malloc(sizeof(dtype) * C.record_size * C.elements);
+
+  C.mb = (double) sizeof(dtype) * C.record_size * params->ELEMENTS_PER_PROCESS *
+         params->CARTESIAN_X * params->CARTESIAN_Y * params->CARTESIAN_Z / 1E6;
+}
+
+static void complete_pending(struct paramstype *params)
+/* Wait for the checkpoint in flight, close its file (collective, so every
+   rank's data is in) and only then mark its header complete. */
+{
+  char name[sizeof(params->CHECKPOINT_FILE) + 8];
+  headertype H;
+  MPI_File f;
+
+  if (!C.pending) { return; }
+
+  MPI_Wait(&C.request, MPI_STATUS_IGNORE);
+  if (!C.drained) { C.drain += tdiff(C.started, now()); }
+  MPI_File_close(&C.file);
+
+  if (C.rank == 0) {
+    slot_name(params, C.slot, name, sizeof(name));
+    fill_header(&H, 1, C.step, params);
+    MPI_File_open(MPI_COMM_SELF, name, MPI_MODE_WRONLY, MPI_INFO_NULL, &f);
+    MPI_File_write_at(f, 0, &H, sizeof(H), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_close(&f);
+  }
+
+  C.pending = 0;
+  C.written++;
+}
+
+void write_checkpoint(element *Q, int step, struct paramstype *params)
+/* Pack into the free buffer, retire the previous checkpoint, start this
+   one on the other file. Collective. */
+{
+  char name[sizeof(params->CHECKPOINT_FILE) + 8];
+  int slot = C.written + C.pending;
+  struct timespec t0 = now();
+  headertype H;
+
+  slot = slot % 2;
+  pack_q(Q, C.buffer[slot], params);
+  complete_pending(params);
+
+  slot_name(params, slot, name, sizeof(name));
+  MPI_File_open(C.comm, name, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &C.file);
+
+  /* Incomplete until complete_pending says otherwise. */
+  if (C.rank == 0) {
+    fill_header(&H, 0, step, params);
+    MPI_File_write_at(C.file, 0, &H, sizeof(H), MPI_BYTE, MPI_STATUS_IGNORE);
+  }
+
+  MPI_File_set_view(C.file, CHECKPOINT_HEADER_BYTES, C.record, C.view, "native", MPI_INFO_NULL);
+  MPI_File_iwrite_all(C.file, C.buffer[slot], C.elements, C.record, &C.request);
+
+  C.pending = 1;
+  C.slot = slot;
+  C.step = step;
+  C.drained = 0;
+  C.started = now();
+  C.blocked += tdiff(t0, C.started);
+}
+
+void progress_checkpoint(void)
+/* Poke MPI so the write advances, and note when it is done. */
+{
+  int done;
+
+  if (!C.pending || C.drained) { return; }
+  MPI_Test(&C.request, &done, MPI_STATUS_IGNORE);
+  if (done) {
+    C.drained = 1;
+    C.drain += tdiff(C.started, now());
+    C.request = MPI_REQUEST_NULL;
+  }
+}
+
+void finish_checkpoints(struct paramstype *params)
+/* Retire the last checkpoint and report. Collective. */
+{
+  struct timespec t0 = now();
+  double blocked, drain;
+
+  complete_pending(params);
+  C.blocked += tdiff(t0, now());
+
+  MPI_Reduce(&C.blocked, &blocked, 1, MPI_DOUBLE, MPI_MAX, 0, C.comm);
+  MPI_Reduce(&C.drain, &drain, 1, MPI_DOUBLE, MPI_MAX, 0, C.comm);
+
+  if (C.rank == 0 && C.written > 0) {
+    printf("Checkpoints: %d of %.2f MB, compute blocked %.6f s in total (slowest rank), "
+           "writes in flight %.6f s each on average.\n",
+           C.written, C.mb, blocked, drain / C.written);
+  }
+
+  free(C.buffer[0]);
+  free(C.buffer[1]);
+  MPI_Type_free(&C.view);
+  MPI_Type_free(&C.record);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* -------------------------------- Restart -------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+int read_checkpoint(element *Q, MPI_Comm cart_comm, struct paramstype *params)
+/* Rank 0 picks the newest complete, matching file; everyone reads its box.
+   Collective. */
+{
+  char name[sizeof(params->CHECKPOINT_FILE) + 8];
+  int slot, choice[2] = { -1, -1 };   // slot, step
+  headertype H, expect;
+  dtype *buffer;
+  FILE *f;
+  MPI_File file;
+
+  build_types(cart_comm, params);
+
+  if (C.rank == 0) {
+    fill_header(&expect, 1, 0, params);
+    for (slot = 0; slot < 2; slot++) {
+      slot_name(params, slot, name, sizeof(name));
+      f = fopen(name, "rb");
+      if (f == NULL) { continue; }
+      if (fread(&H, sizeof(H), 1, f) == 1 && header_matches(&H, &expect) && H.step > choice[1]) {
+        choice[0] = slot;
+        choice[1] = H.step;
+      }
+      fclose(f);
+    }
+    if (choice[0] < 0) {
+      printf("Restart: no complete checkpoint %s.0/.1 for this problem.\n",
+             params->CHECKPOINT_FILE);
+    }
+  }
+
+  MPI_Bcast(choice, 2, MPI_INT, 0, cart_comm);
+  if (choice[0] >= 0) {
+    slot_name(params, choice[0], name, sizeof(name));
+    buffer = malloc(sizeof(dtype) * C.record_size * params->ELEMENTS_PER_PROCESS);
+
+    MPI_File_open(cart_comm, name, MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+    MPI_File_set_view(file, CHECKPOINT_HEADER_BYTES, C.record, C.view, "native", MPI_INFO_NULL);
+    MPI_File_read_all(file, buffer, params->ELEMENTS_PER_PROCESS, C.record, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+
+    unpack_q(Q, buffer, params);
+    free(buffer);
+
+    if (C.rank == 0) { printf("Restart: loaded %s after timestep %d.\n", name, choice[1]); }
+  }
+
+  MPI_Type_free(&C.view);
+  MPI_Type_free(&C.record);
+  return choice[1];
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Initial State ---------------------------- */
+/* ------------------------------------------------------------------------- */
+
+int map_initial_state(element *Q, MPI_Comm cart_comm, struct paramstype *params)
+/* Map the byte range from this rank's first to its last record and copy
+   element by element on the owning thread. Pages are faulted in by that
+   copy, so a rank only reads what its own box touches. Collective. */
+{
+  int rank, e, ok = 1, all, coords[CARTESIAN_DIMENSIONS];
+  long gx = (long) params->CARTESIAN_X * params->ELEMENTS_X;
+  long gy = (long) params->CARTESIAN_Y * params->ELEMENTS_Y;
+  long sx, sy, sz, first, last;
+  size_t record_bytes, begin, end, offset, length, page = sysconf(_SC_PAGESIZE);
+  char *map = MAP_FAILED;
+  struct timespec t0 = now();
+  struct stat st;
+  headertype H, expect;
+  double seconds;
+  int fd;
+
+  MPI_Comm_rank(cart_comm, &rank);
+  MPI_Cart_coords(cart_comm, rank, CARTESIAN_DIMENSIONS, coords);
+
+  record_bytes = sizeof(dtype) * params->PHYSICAL_PARAMS * params->ELEMENT_SIZE *
+                 params->ELEMENT_SIZE * params->ELEMENT_SIZE;
+  sx = coords[0] * params->ELEMENTS_X;
+  sy = coords[1] * params->ELEMENTS_Y;
+  sz = coords[2] * params->ELEMENTS_Z;
+  first = (sz * gy + sy) * gx + sx;
+  last = ((sz + params->ELEMENTS_Z - 1) * gy + sy + params->ELEMENTS_Y - 1) * gx +
+         sx + params->ELEMENTS_X - 1;
+  begin = CHECKPOINT_HEADER_BYTES + first * record_bytes;
+  end = CHECKPOINT_HEADER_BYTES + (last + 1) * record_bytes;
+  offset = begin / page * page;   // mmap offsets must be page aligned
+  length = end - offset;
+
+  /* Every rank checks the header and the size for itself: all of them must
+     succeed before anyone allocates. */
+  fill_header(&expect, 1, 0, params);
+  fd = open(params->INITIAL_STATE, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < end ||
+      pread(fd, &H, sizeof(H), 0) != (ssize_t) sizeof(H) || !header_matches(&H, &expect)) {
+    ok = 0;
+  } else {
+    map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, offset);
+    if (map == MAP_FAILED) { ok = 0; }
+  }
+
+  MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_MIN, cart_comm);
+  if (!all) {
+    if (map != MAP_FAILED) { munmap(map, length); }
+    if (fd >= 0) { close(fd); }
+    if (rank == 0) {
+      printf("Initial state: %s is missing, short or not for this problem, generating instead.\n",
+             params->INITIAL_STATE);
+    }
+    return -1;
+  }
+
+  /* Same static schedule as the compute loops, for first touch. */
+  #pragma omp parallel for schedule(static)
+  for (e = 0; e < params->ELEMENTS_PER_PROCESS; e++) {
+    int b, row, col, pos[3];
+    const dtype *p;
+    element_position(e, pos);
+    p = (const dtype *) (map + (begin - offset) +
+                         (((sz + pos[2]) * gy + sy + pos[1]) * gx + sx + pos[0] - first) * record_bytes);
+    Q[e] = new_element(params);
+    for (b = 0; b < params->PHYSICAL_PARAMS; b++) {
+      for (row = 0; row < params->ELEMENT_SIZE; row++) {
+        for (col = 0; col < params->ELEMENT_SIZE; col++) {
+          memcpy(Q[e]->B[b]->T[row][col], p, sizeof(dtype) * params->ELEMENT_SIZE);
+          p += params->ELEMENT_SIZE;
+        }
+      }
+    }
+  }
+
+  munmap(map, length);
+  close(fd);
+
+  seconds = tdiff(t0, now());
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &seconds, &seconds, 1, MPI_DOUBLE, MPI_MAX, 0, cart_comm);
+  if (rank == 0) {
+    printf("Initial state: mapped %s in %.6f s (slowest rank).\n", params->INITIAL_STATE, seconds);
+  }
+  return 0;
+}
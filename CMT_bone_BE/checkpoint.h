@@ -0,0 +1,82 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+#include "dstructs.h"
+
+
+/* ----------------------------- Checkpoints ------------------------------- */
+
+/* Q of every rank goes into one shared file per checkpoint, through
+   collective MPI-IO. The file is a header followed by the global element
+   grid (CARTESIAN_* x ELEMENTS_*, x fastest), one record of
+   PHYSICAL_PARAMS * ELEMENT_SIZE^3 values per element; each rank's file
+   view is the box its cartesian coordinates select. Local element e sits
+   at element_position(e) in that box (order.h), so a file written under
+   one ELEMENT_ORDER restarts under any other.
+
+   Checkpoints alternate between CHECKPOINT_FILE.0 and .1. Q is packed into
+   one of two buffers and written with a nonblocking collective, so compute
+   continues while the previous checkpoint drains; a checkpoint is finished
+   (and its header marked complete) when the next one starts or at the end.
+   A crash therefore never leaves both files incomplete. */
+
+/* Open the checkpoint state. Collective on cart_comm. */
+void setup_checkpoints(MPI_Comm cart_comm, struct paramstype *params);
+
+/* Pack Q after timestep step (counted from the start of the simulation,
+   across restarts), finish the previous checkpoint and start writing this
+   one. Collective. */
+void write_checkpoint(element *Q, int step, struct paramstype *params);
+
+/* Let a checkpoint in flight progress; cheap, call once per timestep. */
+void progress_checkpoint(void);
+
+/* Finish any checkpoint in flight, print the cost on rank 0 and
+   release the buffers. Collective. */
+void finish_checkpoints(struct paramstype *params);
+
+/* Load Q from the newest complete checkpoint that matches this problem.
+   Returns the timestep it was taken after, or -1 (and leaves Q alone) if
+   there is none; rank 0 says so, the caller decides what failing means.
+   Collective. */
+int read_checkpoint(element *Q, MPI_Comm cart_comm, struct paramstype *params);
+
+
+/* ----------------------------- Initial State ----------------------------- */
+
+/* Allocate Q and fill it from params->INITIAL_STATE, a state file in the
+   checkpoint format (any complete checkpoint of this problem will do; its
+   timestep is ignored). Each rank mmaps only the span of its own box and
+   the pages are read as the owning threads copy them. Returns 0, or -1
+   with Q untouched if any rank cannot use the file. Collective. */
+int map_initial_state(element *Q, MPI_Comm cart_comm, struct paramstype *params);
+
+#endif
@@ -0,0 +1,923 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <mpi.h>
+#include <assert.h>
+#include <string.h>
+
+#include "cmtbone.h"
+#include "params.h"
+#include "dstructs.h"
+#include "utils.h"
+#include "flux.h"
+#include "affinity.h"
+#include "timers.h"
+#include "output.h"
+#include "roofline.h"
+#include "halo.h"
+#include "rng.h"
+#include "verify.h"
+#include "tune.h"
+#include "checkpoint.h"
+#include "diagnostics.h"
+#include "balance.h"
+#include "order.h"
+#include "commthread.h"
+#include "dataflow.h"
+#include "ghosts.h"
+
+
+/* --------------------------- Timing Parameter selection  -------------------------- */
+     /* Selected at runtime through params->PROFILE (CMT_PROFILE):
+        0  ---->   Print each timestep (csv format) and its avg.
+        1  ---->   Compute(A), comm and compute(B) per step with avg.
+        2  ---->   As 1, plus per-kernel region timers (and CMT_COUNTERS=1
+                   for perf_event counters) printed at the end.  */
+
+/* Every rank records; the sample views feed the cross-rank reports. */
+static const char *phase_names[3] = { "compA", "compB", "comm" };
+static const char *step_names[1] = { "step" };
+
+/* The modules a handle drives keep file-static state, so a process holds
+   at most one handle at a time. */
+static int handle_alive = 0;
+
+
+/* ------------------------------- Handle ---------------------------------- */
+
+struct cmtbonetype {
+  struct paramstype *params;
+  MPI_Comm cart_comm;
+  int rank;
+
+  const kernelset *K;           // kernel variant for Compute (A) and (B)
+  const halobackend *H;         // exchange backend for the communication phase
+
+  balance L;                    // the elements this rank owns, their ids and weights
+  element *Q, *R;
+  matrix kernel;
+  ternix RX[9];
+  rngkey conv_stream;
+  scratchpool work;
+  int tiled;
+
+  int step0;                    // timesteps before this run (restart)
+  int steps;                    // timesteps run so far, after step0
+  int diagnosing, diagnose_r;
+  int verifying;
+  double *checksums;
+
+  int comm_thread, dataflow, depth;
+  int *sweep, split;            // Compute (A) order, see cmtbone_create
+  double ghost_seconds;
+
+  double *step, *compA, *comm, *compB;
+  double *phase_samples[3], *step_samples[1];
+  double seconds;
+};
+
+
+/* ------------------------------ Setup ------------------------------------ */
+
+cmtbone cmtbone_create(MPI_Comm comm, struct paramstype *params, const cmtbonehooks *hooks)
+/* The setup of a run, in the order the mini-app always did it. */
+{
+  int rank;
+
+  MPI_Comm_rank(comm, &rank);
+  if (handle_alive) {
+    if (rank == 0) { printf("cmtbone_create: another handle is still alive in this process; destroy it first.\n"); }
+    return NULL;
+  }
+
+  cmtbone B = calloc(1, sizeof(cmtbonetype));
+  assert(B != NULL);
+  handle_alive = 1;
+
+  B->params = params;
+  B->rank = rank;
+
+  /* THREADS and AFFINITY apply to the library as to the executable: every
+     per-thread structure below is sized by THREADS and indexed by thread
+     number. Pin before anything is allocated, so that first touch places
+     each element next to the thread that computes it. */
+#ifdef _OPENMP
+  omp_set_num_threads(params->THREADS);
+#endif
+  setup_affinity(comm, params);
+  if (strcmp(params->AFFINITY, "none") != 0) { print_affinity(comm, params); }
+
+  int cart_sizes[CARTESIAN_DIMENSIONS] = {params->CARTESIAN_X, params->CARTESIAN_Y, params->CARTESIAN_Z};
+  int cart_wrap[CARTESIAN_DIMENSIONS] = CARTESIAN_WRAP;
+
+  MPI_Cart_create( comm, CARTESIAN_DIMENSIONS, cart_sizes, cart_wrap,
+                   CARTESIAN_REORDER, &B->cart_comm );
+  MPI_Comm cart_comm = B->cart_comm;
+
+  /* Measured (or remembered) fastest kernel variant, tile size, element
+     ordering and exchange backend. */
+  if (strcmp(params->AUTOTUNE, "off") != 0) { autotune(cart_comm, params); }
+
+  /* Kernel variant for Compute (A) and (B); the caller's, if it gave one. */
+  const kernelset *K = (hooks != NULL) ? hooks->kernels : NULL;
+  if (K == NULL) { K = find_kernels(params->KERNEL); }
+  if (K == NULL) {
+    if (B->rank == params->PROBED_RANK) { printf("Unknown kernel variant '%s'. Using reference. \n", params->KERNEL); }
+    K = &kernel_variants[0];
+  }
+  snprintf(params->KERNEL, sizeof(params->KERNEL), "%s", K->name);
+  B->K = K;
+
+  /* Exchange backend for the communication phase. */
+  const halobackend *H = (hooks != NULL) ? hooks->halo : NULL;
+  if (H == NULL) { H = find_halo(params->HALO); }
+  if (H == NULL) {
+    if (B->rank == params->PROBED_RANK) { printf("Unknown exchange backend '%s'. Using blocking. \n", params->HALO); }
+    H = &halo_backends[0];
+  }
+  snprintf(params->HALO, sizeof(params->HALO), "%s", H->name);
+  B->H = H;
+
+
+  /* ------------------------------ Timing Setup --------------------------- */
+
+  int TSxRK = params->TIMESTEPS * (params->RK);
+
+  B->step = calloc(params->TIMESTEPS, sizeof(double));
+  B->compA = calloc(TSxRK, sizeof(double));
+  B->compB = calloc(TSxRK, sizeof(double));
+  B->comm = calloc(TSxRK, sizeof(double));
+
+  B->phase_samples[0] = B->compA;
+  B->phase_samples[1] = B->compB;
+  B->phase_samples[2] = B->comm;
+  B->step_samples[0] = B->step;
+
+  /* Per-kernel regions; inactive unless PROFILE >= 2. */
+  setup_timers(params);
+
+  /* Measured bandwidth and peak for the roofline report. */
+  if (params->ROOFLINE) { calibrate_machine(cart_comm, params); }
+
+
+  /* ------------------------------ Memory Setup --------------------------- */
+
+  /* All initial data comes from the counter-based generator (rng.h), keyed
+     by the global element id (balance.h), so a run is reproducible for any
+     thread count, kernel variant, element ordering and distribution. */
+  B->conv_stream = rng_stream(RNG_CONV);
+
+  /* Storage order of the elements of a box (order.h). */
+  setup_element_order(params);
+
+  /* The elements this rank owns, their ids and their weights. */
+  balance L = B->L = new_balance(cart_comm, params);
+
+  int i, e;
+
+  element *elements_Q = B->Q = malloc(sizeof(element) * L->count);
+  element *elements_R = B->R = malloc(sizeof(element) * L->count);
+
+  /* Q from the checkpoint when restarting, else from a state file if one
+     is given and usable, else generated. A restarted Q starts as zeros, not
+     as the generated values the time loop leaves unchanged, so only a
+     checkpoint that was really read gives the checksums of the run that
+     wrote it. */
+  memory_category(MEMORY_Q);
+  int mapped = (!params->RESTART && params->INITIAL_STATE[0] != '\0' &&
+                map_initial_state(elements_Q, cart_comm, params) == 0);
+
+  /* First touch: the static schedule here must match the element loops of
+     Compute (A) and (B) so every element is initialized by its owner. */
+  if (!mapped) {
+    #pragma omp parallel for schedule(static)
+    for (e = 0; e < L->count; e++) {
+      elements_Q[e] = params->RESTART ? new_zero_element(params) :
+                      new_counter_element(0, 10, rng_key(rng_stream(RNG_Q), L->key[e]), params);
+    }
+  }
+  memory_category(MEMORY_R);
+  #pragma omp parallel for schedule(static)
+  for (e = 0; e < L->count; e++) { elements_R[e] = new_zero_element(params); }
+
+  /* The same kernel is used for everything */
+  memory_category(MEMORY_OTHER);
+  B->kernel = new_counter_matrix(params->ELEMENT_SIZE, params->ELEMENT_SIZE, -10, 10,
+                                 rng_stream(RNG_KERNEL));
+
+  /* The same transformation ternix (RX) is used for all elements.
+     This is an approximation, there should be one for each element. */
+  memory_category(MEMORY_RX);
+  for (i = 0; i < 9; i++) {
+    B->RX[i] = new_counter_ternix(params->ELEMENT_SIZE, params->ELEMENT_SIZE, params->ELEMENT_SIZE, -1, 1,
+                                  rng_key(rng_stream(RNG_RX), i));
+  }
+  memory_category(MEMORY_OTHER);
+
+  /* Continue from a checkpoint. Timesteps are counted from the start of the
+     simulation, so a restarted run draws the same constants, and records
+     the same checksums, as one that never stopped; TIMESTEPS is where both
+     end. Without a checkpoint to continue from there is no run. */
+  if (params->RESTART) {
+    B->step0 = read_checkpoint(elements_Q, cart_comm, params);
+    if (B->step0 < 0) {
+      cmtbone_destroy(B);
+      return NULL;
+    }
+  }
+  if (params->CHECKPOINT_EVERY > 0) { setup_checkpoints(cart_comm, params); }
+
+  /* In-situ statistics, folded into Compute (B) on the stages that gather. */
+  B->diagnosing = (strcmp(params->DIAGNOSTICS, "off") != 0);
+  B->diagnose_r = (strcmp(params->DIAGNOSTICS, "r") == 0);
+  if (B->diagnosing) { setup_diagnostics(cart_comm, params); }
+
+  /* Per-stage checksums of Q and R when verifying, at the simulation's
+     stage numbers (those before step0 stay unused). */
+  B->verifying = (strcmp(params->VERIFY, "off") != 0);
+  if (B->verifying) { B->checksums = malloc(sizeof(double) * TSxRK * params->PHYSICAL_PARAMS * CHECKSUM_COUNT); }
+
+  /* Blocks per Compute (A) tile; auto (0) fits L2 (tune.h). */
+  if (params->TILE == 0) {
+    params->TILE = auto_tile(L->count * params->PHYSICAL_PARAMS, params);
+    if (B->rank == params->PROBED_RANK) {
+      printf("Tile: %d blocks per Compute (A) tile for a %ld KiB L2.\n", params->TILE, cache_size(2) / 1024);
+    }
+  }
+  B->tiled = (params->TILE > 1);
+
+  /* Intermediate 3D structures (conv outputs and derivative outputs), one
+     set (or tile) per thread, touched by that thread and reused for every
+     block it computes. */
+  B->work = new_scratch_pool(B->tiled ? params->TILE : 0,
+                             K->conv_params != NULL ? interleaved_values(params) : 0, params);
+
+  /* Compute (A) order. With a communication thread, the elements whose
+     faces the exchange moves come first (sweep[0, split)), and the exchange
+     runs while the others are computed; otherwise it is storage order. */
+  B->comm_thread = params->COMM_THREAD && start_comm_thread(H, cart_comm, params);
+  B->sweep = malloc(sizeof(int) * L->count);
+  B->split = L->count;
+  if (B->comm_thread) { B->split = face_first_order(B->sweep); }
+  else { for (e = 0; e < L->count; e++) { B->sweep[e] = e; } }
+
+  /* Compute (B) element by element as the faces come in (dataflow.h). */
+  B->dataflow = params->DATAFLOW;
+  if (B->dataflow) { setup_dataflow(cart_comm, L->count, params); }
+
+  /* Communication avoiding: whole elements of the ranks within depth are
+     exchanged once every depth stages and recomputed in between (ghosts.h). */
+  B->depth = params->GHOST_DEPTH;
+  if (B->depth > 0) { setup_ghosts(cart_comm, params); }
+
+  return B;
+}
+
+
+/* ------------------------------ Main Loop -------------------------------- */
+
+int cmtbone_step(cmtbone B, int n)
+/* The time loop of the mini-app, from timestep step0 + steps on. t counts
+   the timesteps of this run, step0 + t those of the simulation. */
+{
+  struct paramstype *params = B->params;
+  MPI_Comm cart_comm = B->cart_comm;
+  const kernelset *K = B->K;
+  const halobackend *H = B->H;
+  balance L = B->L;
+  element *elements_Q = B->Q, *elements_R = B->R;
+  matrix kernel = B->kernel;
+  ternix *RX = B->RX;
+  rngkey conv_stream = B->conv_stream;
+  scratchpool work = B->work;
+  int tiled = B->tiled, comm_thread = B->comm_thread, dataflow = B->dataflow;
+  int diagnosing = B->diagnosing, diagnose_r = B->diagnose_r, verifying = B->verifying;
+
+  /* Index variables: {generic, timestep, params->RK-index, element, block, weight pass} */
+  int i, t, r, e, b, pass, part;
+
+  /* window is the stage within the current ghost window (ghosts.h). */
+  int depth = B->depth, window = 0;
+  double ghost_wait = 0;
+
+  struct timespec tA, tcompA_s, tcomm_s, tcompB_s;
+
+  /* The caller may have changed the thread count since cmtbone_create. */
+#ifdef _OPENMP
+  omp_set_num_threads(params->THREADS);
+#endif
+
+  int last = B->steps + (n > 0 ? n : 0);
+  if (last > (int) params->TIMESTEPS - B->step0) { last = (int) params->TIMESTEPS - B->step0; }
+
+  struct timespec tloop = now();
+
+  /* For each timestep: */
+  for ( t = B->steps; t < last; t++ ) {
+
+    if (!params->PROFILE) { tA = now(); }
+
+    /* For each of the three 'stages': */
+    for (r = 0; r < params->RK; r++) {
+
+
+      /* --------------------------- Compute (A) --------------------------- */
+      if (params->PROFILE) { tcompA_s = now(); }
+      struct timespec tbalance = now();
+
+      /* A window opens with the ghost exchange, behind our own Compute (A). */
+      if (depth > 0) { window = (t * params->RK + r) % depth; }
+      ghost_wait = 0;
+      if (depth > 0 && window == 0) { start_ghost_exchange(elements_Q); }
+
+      /* The exchanged elements, then the rest (everything is in the first
+         part without a communication thread). */
+      for (part = 0; part < 2; part++) {
+        int lo = part ? B->split : 0, hi = part ? L->count : B->split;
+
+        /* The exchanged faces are final: hand them over. The master makes
+           no MPI calls until the exchange is back. */
+        if (part == 1 && comm_thread) {
+          if (dataflow) { arm_dataflow(); }
+          post_exchange(elements_R, layout_table());
+        }
+        int progress = diagnosing && !(part == 1 && comm_thread);
+
+        /* Whole elements at once, their parameters interleaved (flux.h). */
+        if (K->conv_params != NULL) {
+
+          #pragma omp parallel for schedule(static) private(e, b, pass)
+          for ( i = lo; i < hi; i++ ) {
+
+            scratch S = pool_scratch(work);
+            dtype coef[3 * params->PHYSICAL_PARAMS];
+            regionmark m;
+            e = B->sweep[i];
+
+            /* Every block's constants for this stage. */
+            for ( b = 0; b < params->PHYSICAL_PARAMS; b++ ) {
+              rngkey ck = rng_key(rng_key(rng_key(conv_stream, L->key[e]), b), (B->step0 + t) * params->RK + r);
+              coef[3 * b + 0] = rng_uniform(ck, 0);
+              coef[3 * b + 1] = rng_uniform(ck, 1);
+              coef[3 * b + 2] = rng_uniform(ck, 2);
+            }
+
+            /* A heavier element (balance.h) repeats the same work. */
+            for ( pass = 0; pass < L->weight[e]; pass++ ) {
+
+              region_begin(&m);
+              K->conv_params(elements_Q[e], RX, coef, S->W, params);
+              region_end_calls(REGION_CONV, &m, params->PHYSICAL_PARAMS);
+
+              region_begin(&m);
+              K->dr_params(kernel, S->W, params);
+              region_end_calls(REGION_DR, &m, params->PHYSICAL_PARAMS);
+
+              region_begin(&m);
+              K->ds_params(kernel, S->W, params);
+              region_end_calls(REGION_DS, &m, params->PHYSICAL_PARAMS);
+
+              region_begin(&m);
+              K->dt_params(kernel, S->W, params);
+              region_end_calls(REGION_DT, &m, params->PHYSICAL_PARAMS);
+
+              region_begin(&m);
+              K->sum_params(S->W, elements_R[e], params);
+              region_end_calls(REGION_SUM, &m, params->PHYSICAL_PARAMS);
+            }
+
+            /* Keep the last stage's diagnostics reduction moving. */
+            if (progress && thread_num() == 0) { progress_diagnostics(); }
+          }
+
+        /* Tiles of TILE blocks (element-major), each run kernel by kernel
+           so that the derivative matrix stays in L1 across the tile. */
+        } else if (tiled) {
+          int tile, count = ((hi - lo) * params->PHYSICAL_PARAMS + params->TILE - 1) / params->TILE;
+
+          #pragma omp parallel for schedule(static) private(e, b, pass)
+          for ( tile = 0; tile < count; tile++ ) {
+
+            tilescratch S = pool_tile(work);
+            int first_block = lo * params->PHYSICAL_PARAMS + tile * params->TILE, end_block = first_block + params->TILE;
+            int filled, k, passes = 1;
+            int slot[ params->TILE ];
+            regionmark m;
+
+            if (end_block > hi * params->PHYSICAL_PARAMS) { end_block = hi * params->PHYSICAL_PARAMS; }
+            for ( k = first_block; k < end_block; k++ ) {
+              if (L->weight[B->sweep[k / params->PHYSICAL_PARAMS]] > passes) {
+                passes = L->weight[B->sweep[k / params->PHYSICAL_PARAMS]];
+              }
+            }
+
+            /* A heavier element (balance.h) repeats the same work, so each
+               pass takes the blocks of the tile that still have one to do. */
+            for ( pass = 0; pass < passes; pass++ ) {
+
+              /* Generate Ur, Us, and Ut of every block. */
+              for ( filled = 0, k = first_block; k < end_block; k++ ) {
+                e = B->sweep[k / params->PHYSICAL_PARAMS];
+                b = k % params->PHYSICAL_PARAMS;
+                if (pass >= L->weight[e]) { continue; }
+
+                rngkey ck = rng_key(rng_key(rng_key(conv_stream, L->key[e]), b), (B->step0 + t) * params->RK + r);
+                dtype coef[3] = { rng_uniform(ck, 0), rng_uniform(ck, 1), rng_uniform(ck, 2) };
+
+                region_begin(&m);
+                K->conv(elements_Q[e]->B[b], RX, coef, S->Ur[filled], S->Us[filled], S->Ut[filled], params);
+                region_end(REGION_CONV, &m);
+                slot[filled++] = k;
+              }
+
+              /* The three derivative computations, each over the whole tile. */
+              region_begin(&m);
+              operation_dr_tile(kernel, S->Ur, S->Vr, filled, params);
+              region_end_calls(REGION_DR, &m, filled);
+
+              region_begin(&m);
+              operation_ds_tile(kernel, S->Us, S->Vs, filled, params);
+              region_end_calls(REGION_DS, &m, filled);
+
+              region_begin(&m);
+              operation_dt_tile(kernel, S->Ut, S->Vt, filled, params);
+              region_end_calls(REGION_DT, &m, filled);
+
+              /* Add Vr, Vs, and Vt to make R. */
+              for ( k = 0; k < filled; k++ ) {
+                e = B->sweep[slot[k] / params->PHYSICAL_PARAMS];
+                b = slot[k] % params->PHYSICAL_PARAMS;
+                region_begin(&m);
+                K->sum( S->Vr[k], S->Vs[k], S->Vt[k], elements_R[e]->B[b], params );
+                region_end(REGION_SUM, &m);
+              }
+            }
+
+            /* Keep the last stage's diagnostics reduction moving. */
+            if (progress && thread_num() == 0) { progress_diagnostics(); }
+          }
+        } else {
+
+          /* For each element owned by this rank: */
+          #pragma omp parallel for schedule(static) private(e, b, pass)
+          for ( i = lo; i < hi; i++ ) {
+
+            scratch S = pool_scratch(work);
+            regionmark m;
+            e = B->sweep[i];
+
+            /* For each block in the element: */
+            for ( b = 0; b < params->PHYSICAL_PARAMS; b++ ) {
+
+              /* This block's constants for this stage. */
+              rngkey ck = rng_key(rng_key(rng_key(conv_stream, L->key[e]), b), (B->step0 + t) * params->RK + r);
+              dtype coef[3] = { rng_uniform(ck, 0), rng_uniform(ck, 1), rng_uniform(ck, 2) };
+
+              /* A heavier element (balance.h) repeats the same work. */
+              for ( pass = 0; pass < L->weight[e]; pass++ ) {
+
+                /* Generate Ur, Us, and Ut. */
+                region_begin(&m);
+                K->conv(elements_Q[e]->B[b], RX, coef, S->Ur, S->Us, S->Ut, params);
+                region_end(REGION_CONV, &m);
+
+                /* Perform the three derivative computations (R, S, T). */
+                region_begin(&m);
+                K->dr(kernel, S->Ur, S->Vr, params);
+                region_end(REGION_DR, &m);
+
+                region_begin(&m);
+                K->ds(kernel, S->Us, S->Vs, params);
+                region_end(REGION_DS, &m);
+
+                region_begin(&m);
+                K->dt(kernel, S->Ut, S->Vt, params);
+                region_end(REGION_DT, &m);
+
+                /* Add Vr, Vs, and Vt to make R. */
+                region_begin(&m);
+                K->sum( S->Vr, S->Vs, S->Vt, elements_R[e]->B[b], params );
+                region_end(REGION_SUM, &m);
+              }
+
+            }
+
+            /* Keep the last stage's diagnostics reduction moving. */
+            if (progress && thread_num() == 0) { progress_diagnostics(); }
+          }
+        }
+      }
+
+      /* The ghosts the rest of the window still needs, redundantly. */
+      if (depth > 0) {
+        const ghostelement *ghost = ghost_elements();
+        int count = ghost_count(depth - window);
+        struct timespec tghost = now();
+
+        if (window == 0) {
+          finish_ghost_exchange();
+          ghost_wait = tdiff(tghost, now());
+          tghost = now();
+        }
+
+        #pragma omp parallel for schedule(static) private(b)
+        for ( i = 0; i < count; i++ ) {
+
+          scratch S = pool_scratch(work);
+          regionmark m;
+
+          for ( b = 0; b < params->PHYSICAL_PARAMS; b++ ) {
+            rngkey ck = rng_key(rng_key(rng_key(conv_stream, ghost[i].key), b), (B->step0 + t) * params->RK + r);
+            dtype coef[3] = { rng_uniform(ck, 0), rng_uniform(ck, 1), rng_uniform(ck, 2) };
+
+            region_begin(&m);
+            K->conv(ghost[i].Q->B[b], RX, coef, S->Ur, S->Us, S->Ut, params);
+            region_end(REGION_CONV, &m);
+
+            region_begin(&m);
+            K->dr(kernel, S->Ur, S->Vr, params);
+            region_end(REGION_DR, &m);
+
+            region_begin(&m);
+            K->ds(kernel, S->Us, S->Vs, params);
+            region_end(REGION_DS, &m);
+
+            region_begin(&m);
+            K->dt(kernel, S->Ut, S->Vt, params);
+            region_end(REGION_DT, &m);
+
+            region_begin(&m);
+            K->sum( S->Vr, S->Vs, S->Vt, ghost[i].R->B[b], params );
+            region_end(REGION_SUM, &m);
+          }
+        }
+        B->ghost_seconds += tdiff(tghost, now());
+      }
+
+      /* What the rebalancer measures. */
+      L->compute += tdiff(tbalance, now());
+
+      if (params->PROFILE) {
+        B->compA[t * params->RK + r] = tdiff(tcompA_s, now()) - ghost_wait;
+      }
+
+      /* Whatever of the reduction Compute (A) did not hide. */
+      if (diagnosing && !comm_thread) { wait_diagnostics(); }
+
+
+      /* --------------------------- Communicate --------------------------- */
+      if (params->PROFILE) { tcomm_s = now(); }
+
+      /* With a communication thread only what Compute (A) did not hide;
+         with dataflow the exchange runs inside Compute (B). */
+      if (!dataflow) {
+        if (comm_thread) { wait_exchange(); }
+        else if (depth > 0) { fold_ghost_faces(elements_R, window); }
+        else if (params->MAPPED) { exchange_mapped(elements_R, L, params); }
+        else { H->exchange(elements_R, layout_table(), cart_comm, params); }
+      }
+
+      if (diagnosing && comm_thread && !dataflow) { wait_diagnostics(); }
+
+
+      if (params->PROFILE) {
+        B->comm[t * params->RK + r] = tdiff(tcomm_s, now()) + ghost_wait;
+      }
+
+
+      /* --------------------------- Compute (B) --------------------------- */
+      if (params->PROFILE) { tcompB_s = now(); }
+
+      int gather = diagnosing && diagnostics_due(B->step0 + t, r, params);
+      if (gather) { begin_diagnostics(); }
+
+      /* Each element as soon as all of its faces are in. Thread 0 runs the
+         exchange first, unless the communication thread already does. */
+      if (dataflow) {
+        if (!comm_thread) { arm_dataflow(); }
+
+        #pragma omp parallel private(e, b)
+        {
+          regionmark m;
+
+          if (!comm_thread && thread_num() == 0) {
+            H->exchange(elements_R, layout_table(), cart_comm, params);
+          }
+
+          while ((e = next_ready_element()) >= 0) {
+            for ( b = 0; b < params->PHYSICAL_PARAMS; b++ ) {
+              region_begin(&m);
+              if (gather) {
+                K->rk_reduce(elements_R[e]->B[b], elements_Q[e]->B[b], diagnose_r,
+                             diagnostics_accumulator(thread_num(), b), params);
+              } else {
+                K->rk(elements_R[e]->B[b], elements_Q[e]->B[b], params);
+              }
+              region_end(REGION_RK, &m);
+            }
+          }
+        }
+
+        if (comm_thread) { wait_exchange(); }
+        if (diagnosing && comm_thread) { wait_diagnostics(); }
+
+      } else {
+
+        /* For each element owned by this rank: */
+        #pragma omp parallel for schedule(static) private(b)
+        for ( e = 0; e < L->count; e++ ) {
+
+          regionmark m;
+
+          /* For each block in the element: */
+          for ( b = 0; b < params->PHYSICAL_PARAMS; b++ ) {
+
+            /* Perform a fake Runge Kutta stage (without R from the last stage)
+               to obtain a new value of Q. */
+            region_begin(&m);
+            if (gather) {
+              K->rk_reduce(elements_R[e]->B[b], elements_Q[e]->B[b], diagnose_r,
+                           diagnostics_accumulator(thread_num(), b), params);
+            } else {
+              K->rk(elements_R[e]->B[b], elements_Q[e]->B[b], params);
+            }
+            region_end(REGION_RK, &m);
+
+          }
+        }
+      }
+
+      /* And the ghosts the next stage of the window still needs. */
+      if (depth > 0) {
+        const ghostelement *ghost = ghost_elements();
+        int count = ghost_count(depth - window - 1);
+        struct timespec tghost = now();
+
+        #pragma omp parallel for schedule(static) private(b)
+        for ( i = 0; i < count; i++ ) {
+          regionmark m;
+          for ( b = 0; b < params->PHYSICAL_PARAMS; b++ ) {
+            region_begin(&m);
+            K->rk(ghost[i].R->B[b], ghost[i].Q->B[b], params);
+            region_end(REGION_RK, &m);
+          }
+        }
+        B->ghost_seconds += tdiff(tghost, now());
+      }
+
+      if (params->PROFILE) {
+        struct timespec tcompB_e = now();
+
+        /* With dataflow, the time until the last face was in counts as
+           comm, only what followed as Compute (B). */
+        if (dataflow && tdiff(tcompB_s, dataflow_faces_in()) > 0) {
+          B->comm[t * params->RK + r] += tdiff(tcompB_s, dataflow_faces_in());
+          tcompB_s = dataflow_faces_in();
+        }
+        B->compB[t * params->RK + r] = tdiff(tcompB_s, tcompB_e);
+      }
+
+      if (gather) { start_diagnostics(B->step0 + t + 1, r); }
+
+      /* Outside the timed phases. */
+      if (verifying) {
+        stage_checksums(elements_Q, elements_R, L->count, params->MAPPED ? NULL : layout_table(),
+                        cart_comm, params, &B->checksums[((B->step0 + t) * params->RK + r) * params->PHYSICAL_PARAMS * CHECKSUM_COUNT]);
+      }
+      
+      
+    } /* For each stage ... */
+
+    if (!params->PROFILE) {
+      B->step[t] = tdiff(tA, now());
+      if (B->rank == params->PROBED_RANK) { printf("%.8f,", B->step[t]); }
+    }
+
+    /* Checkpoints are written in the background; their cost is reported
+       separately at the end. */
+    if (params->CHECKPOINT_EVERY > 0) {
+      progress_checkpoint();
+      if ((B->step0 + t + 1) % params->CHECKPOINT_EVERY == 0) {
+        write_checkpoint(elements_Q, B->step0 + t + 1, params);
+      }
+    }
+
+    /* Move elements from slow ranks to fast ones. */
+    if (params->REBALANCE_EVERY > 0 && (t + 1) % params->REBALANCE_EVERY == 0 && B->step0 + t + 1 < (int) params->TIMESTEPS) {
+      rebalance(L, &B->Q, &B->R, B->step0 + t + 1, params);
+      elements_Q = B->Q;
+      elements_R = B->R;
+
+      /* The element count changed; there is no communication thread here. */
+      B->sweep = realloc(B->sweep, sizeof(int) * L->count);
+      for (e = 0; e < L->count; e++) { B->sweep[e] = e; }
+      B->split = L->count;
+    }
+
+    /* Intermediate cross-rank report of everything recorded so far. */
+    if (params->REPORT_EVERY > 0 && (t + 1) % params->REPORT_EVERY == 0 && B->step0 + t + 1 < (int) params->TIMESTEPS) {
+      char label[32];
+      snprintf(label, sizeof(label), "step %d", t + 1);
+      if (params->PROFILE) { report_phases(label, phase_names, B->phase_samples, 3, (t + 1) * params->RK, cart_comm); }
+      else { report_phases(label, step_names, B->step_samples, 1, t + 1, cart_comm); }
+    }
+
+  } /* for each timestep ... */
+
+  n = t - B->steps;
+  B->steps = t;
+  B->seconds += tdiff(tloop, now());
+
+  return n;
+}
+
+
+/* ------------------------------ Access ----------------------------------- */
+
+void cmtbone_exchange(cmtbone B)
+/* One exchange of the faces of R, outside the stage loop: there is no
+   ghost window or dataflow to feed, so the faces go straight into R. */
+{
+  if (B->comm_thread) {
+    post_exchange(B->R, layout_table());
+    wait_exchange();
+  }
+  else if (B->params->MAPPED) { exchange_mapped(B->R, B->L, B->params); }
+  else { B->H->exchange(B->R, layout_table(), B->cart_comm, B->params); }
+}
+
+
+cmtbonetimings cmtbone_timings(cmtbone B)
+/* Totals are summed on request; the samples are the handle's own. */
+{
+  cmtbonetimings T = { 0 };
+  int s;
+
+  T.steps = B->steps;
+  T.stages = B->steps * B->params->RK;
+  for (s = 0; s < T.stages; s++) {
+    T.compA += B->compA[s];
+    T.comm += B->comm[s];
+    T.compB += B->compB[s];
+  }
+  T.seconds = B->seconds;
+  T.step = B->step;
+  T.compA_samples = B->compA;
+  T.comm_samples = B->comm;
+  T.compB_samples = B->compB;
+
+  return T;
+}
+
+
+element *cmtbone_q(cmtbone B, int *count)
+{
+  if (count != NULL) { *count = B->L->count; }
+  return B->Q;
+}
+
+
+element *cmtbone_r(cmtbone B, int *count)
+{
+  if (count != NULL) { *count = B->L->count; }
+  return B->R;
+}
+
+
+MPI_Comm cmtbone_comm(cmtbone B)
+{
+  return B->cart_comm;
+}
+
+
+/* ------------------------------ Results ---------------------------------- */
+
+int cmtbone_finish(cmtbone B)
+/* The end of the mini-app. Timings and checksums cover the steps run. */
+{
+  struct paramstype *params = B->params;
+  MPI_Comm cart_comm = B->cart_comm;
+  int rank = B->rank, steps = B->steps, stages = steps * params->RK;
+  int i;
+
+  if (params->CHECKPOINT_EVERY > 0) { finish_checkpoints(params); }
+  if (B->diagnosing) { finish_diagnostics(); }
+
+
+  /* ------- Print execution time profiling outputs ------------------------ */
+  cmtbonetimings T = cmtbone_timings(B);
+
+  if (!params->PROFILE && rank == params->PROBED_RANK && steps > 0) {
+    double t_sum = 0;
+    for (i = 0; i < steps; i++) { t_sum += B->step[i]; }
+    printf("\nAverage time: %.8f\n", t_sum / steps);
+  }
+
+  if (params->PROFILE && rank == params->PROBED_RANK && stages > 0) {
+
+    /* Compute A, Compute B, then communication, one line each. */
+    const double *phase[3] = { B->compA, B->compB, B->comm };
+    int p;
+    for (p = 0; p < 3; p++) {
+      for (i = 0; i < stages; i++) {
+        printf(i == stages - 1 ? "%.8f\n" : "%.8f,", phase[p][i]);
+      }
+    }
+
+    printf("Average: %.8f, %.8f, %.8f\n", T.compA / stages, T.compB / stages, T.comm / stages);
+  }
+
+  /* -------- Per-kernel regions (PROFILE >= 2) -------- */
+  if (rank == params->PROBED_RANK) {
+    print_timers(params);
+    print_roofline(cart_comm, params);
+  }
+  if (B->depth > 0) { report_ghosts(B->ghost_seconds, cart_comm, params); }
+
+  /* -------- Cross-rank statistics: every rank recorded, rank 0 reports -------- */
+  if (params->PROFILE) { report_phases("total", phase_names, B->phase_samples, 3, stages, cart_comm); }
+  else { report_phases("total", step_names, B->step_samples, 1, steps, cart_comm); }
+  report_regions("total", cart_comm);
+  report_memory("total", cart_comm);
+
+  /* -------- Machine-readable results (json/csv) -------- */
+  if (strcmp(params->OUTPUT, "text") != 0) {
+    if (params->PROFILE) { write_results(params, cart_comm, phase_names, B->phase_samples, 3, stages); }
+    else { write_results(params, cart_comm, step_names, B->step_samples, 1, steps); }
+  }
+
+
+  /* -------- Record or check the per-stage checksums -------- */
+  int failed = 0;
+  if (B->verifying) {
+    failed = verify_checksums(B->checksums, B->step0 * params->RK, (B->step0 + steps) * params->RK,
+                              cart_comm, params);
+  }
+
+  return failed;
+}
+
+
+void cmtbone_destroy(cmtbone B)
+/* Everything cmtbone_create set up, in reverse; also a handle whose create
+   failed part way (see the restart there), which has no scratch pool yet. */
+{
+  struct paramstype *params = B->params;
+  int i, e;
+
+  for (e = 0; e < B->L->count; e++) {
+    delete_element(B->Q[e], params);
+    delete_element(B->R[e], params);
+  }
+  free(B->Q);
+  free(B->R);
+  if (B->comm_thread) { stop_comm_thread(); }
+  if (B->dataflow) { delete_dataflow(); }
+  if (B->depth > 0) { delete_ghosts(); }
+  free(B->sweep);
+  delete_balance(B->L);
+  delete_element_order();
+
+  delete_matrix(B->kernel);
+
+  for (i = 0; i < 9; i++) {
+    delete_ternix(B->RX[i]);
+  }
+
+  if (B->work != NULL) { delete_scratch_pool(B->work); }
+
+  delete_timers();
+
+  free(B->checksums);
+  free(B->step);
+  free(B->compA);
+  free(B->compB);
+  free(B->comm);
+
+  MPI_Comm_free(&B->cart_comm);
+  free(B);
+  handle_alive = 0;
+}
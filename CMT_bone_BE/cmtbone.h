@@ -0,0 +1,122 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CMTBONE_H_
+#define CMTBONE_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+#include "dstructs.h"
+#include "flux.h"
+#include "halo.h"
+
+
+/* -------------------------- Machine/Primary Parameters --------------------------- */
+  #define CARTESIAN_REORDER 0
+  #define CARTESIAN_WRAP {0, 0, 0}
+
+
+/* ------------------------------ Library Interface ------------------------ */
+
+/* libcmtbone: the mini-app as a library, so that another code can drive the
+   bone kernels element by element. The executable (main.c) is a thin
+   wrapper around it:
+
+     cmtbone B = cmtbone_create(comm, params, NULL);
+     cmtbone_step(B, params->TIMESTEPS);
+     failed = cmtbone_finish(B);
+     cmtbone_destroy(B);
+
+   The configuration is a paramstype, filled by setup_parameters (params.h)
+   or by hand, and set_decomposition for another rank grid. Everything the
+   run allocates hangs off the handle; the modules it drives (timers,
+   element ordering, communication thread, dataflow, ghosts, diagnostics,
+   checkpoints) keep module state, so a process holds one handle at a time:
+   cmtbone_create fails while another is alive, and runs follow each other
+   (create, step, finish, destroy, then the next create). MPI must be
+   initialized with at least MPI_THREAD_SERIALIZED. */
+
+typedef struct cmtbonetype cmtbonetype, *cmtbone;
+
+/* Replacements for the kernel variant (flux.h) and the exchange backend
+   (halo.h) named in params; NULL members fall back to those. The element
+   layout is still chosen by name (ELEMENT_ORDER, order.h), since every
+   module indexes elements through it. */
+typedef struct {
+  const kernelset *kernels;
+  const halobackend *halo;
+} cmtbonehooks;
+
+/* What a handle has timed so far. The samples stay owned by the handle:
+   one per timestep in step (PROFILE 0), one per stage (timestep * RK + RK
+   stage) in compA, comm and compB (PROFILE >= 1). */
+typedef struct {
+  int steps, stages;
+  double compA, comm, compB;    // totals over the stages so far
+  double seconds;               // time spent in cmtbone_step on this rank
+  const double *step, *compA_samples, *comm_samples, *compB_samples;
+} cmtbonetimings;
+
+/* Set up a run on the ranks of comm, which must number CARTESIAN_X *
+   CARTESIAN_Y * CARTESIAN_Z: the OpenMP thread count (THREADS) and
+   placement (AFFINITY), the cartesian communicator, the elements of this
+   rank, the operators and everything the options in params ask for.
+   params is kept (not copied) and must outlive the handle. hooks may be
+   NULL. Returns NULL on every rank, after rank 0 printed why, if another
+   handle is alive in this process, or if RESTART is set and there is no
+   checkpoint to continue from. Collective on comm. */
+cmtbone cmtbone_create(MPI_Comm comm, struct paramstype *params, const cmtbonehooks *hooks);
+
+/* Advance by up to n timesteps of RK stages, at most to timestep TIMESTEPS
+   of the simulation (counting those before a restart). Returns how many
+   were run. Collective. */
+int cmtbone_step(cmtbone B, int n);
+
+/* Exchange the faces of R with the neighbors once, outside a stage, through
+   the same path a stage uses (communication thread, mapped or the backend).
+   Collective. */
+void cmtbone_exchange(cmtbone B);
+
+/* The handle's timings so far. */
+cmtbonetimings cmtbone_timings(cmtbone B);
+
+/* This rank's elements (Q and R) and their count, for element-level access
+   between steps. The arrays change when the run rebalances. */
+element *cmtbone_q(cmtbone B, int *count);
+element *cmtbone_r(cmtbone B, int *count);
+
+/* The cartesian communicator of the run. */
+MPI_Comm cmtbone_comm(cmtbone B);
+
+/* End the run: finish checkpoints and diagnostics, print the timings and
+   reports, write the results and record or check the checksums. Returns
+   nonzero if the verification failed. Collective. */
+int cmtbone_finish(cmtbone B);
+
+/* Release everything the handle holds. Collective. */
+void cmtbone_destroy(cmtbone B);
+
+#endif
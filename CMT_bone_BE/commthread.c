@@ -0,0 +1,219 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <mpi.h>
+
+#include "commthread.h"
+#include "params.h"
+#include "dstructs.h"
+#include "halo.h"
+#include "timers.h"
+#include "affinity.h"
+
+/* One exchange in flight at a time, so two slots are plenty. */
+#define COMM_QUEUE 2
+
+/* Idle polling: this many yields, then naps from COMM_NAP_MIN_NS doubling
+   to COMM_NAP_MAX_NS (commthread.h). */
+#define COMM_SPINS 256
+#define COMM_NAP_MIN_NS 1000L
+#define COMM_NAP_MAX_NS 64000L
+
+/* What the master hands over; stop ends the thread. */
+typedef struct {
+  element *R;
+  const int *layout;
+  int stop;
+} commjob;
+
+typedef struct {
+  pthread_t thread;
+  spscqueue todo, done;
+  const halobackend *H;
+  MPI_Comm comm;
+  struct paramstype *params;
+  int cpu;
+  commjob job;
+} commthreadtype;
+
+static commthreadtype T;
+
+
+/* ------------------------------------------------------------------------- */
+/* --------------------------- Single Producer Queue ----------------------- */
+/* ------------------------------------------------------------------------- */
+
+spscqueue new_spsc_queue(unsigned long capacity)
+/* capacity is rounded up to a power of two. */
+{
+  unsigned long size = 1;
+  spscqueue Q = malloc(sizeof(spscqueuetype));
+
+  while (size < capacity) { size <<= 1; }
+  Q->slots = calloc(size, sizeof(void *));
+  Q->mask = size - 1;
+  atomic_init(&Q->head, 0);
+  atomic_init(&Q->tail, 0);
+  return Q;
+}
+
+void delete_spsc_queue(spscqueue Q)
+{
+  free(Q->slots);
+  free(Q);
+}
+
+int spsc_push(spscqueue Q, void *item)
+{
+  unsigned long tail = atomic_load_explicit(&Q->tail, memory_order_relaxed);
+
+  if (tail - atomic_load_explicit(&Q->head, memory_order_acquire) > Q->mask) { return 0; }
+  Q->slots[tail & Q->mask] = item;
+  atomic_store_explicit(&Q->tail, tail + 1, memory_order_release);
+  return 1;
+}
+
+void *spsc_pop(spscqueue Q)
+{
+  unsigned long head = atomic_load_explicit(&Q->head, memory_order_relaxed);
+  void *item;
+
+  if (head == atomic_load_explicit(&Q->tail, memory_order_acquire)) { return NULL; }
+  item = Q->slots[head & Q->mask];
+  atomic_store_explicit(&Q->head, head + 1, memory_order_release);
+  return item;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* -------------------------- Communication Thread ------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static void back_off(int *idle)
+/* One empty poll; *idle counts them since the last item and is reset by
+   the caller. */
+{
+  struct timespec nap = { 0, COMM_NAP_MAX_NS };
+  int shift = *idle - COMM_SPINS;
+
+  if (*idle < COMM_SPINS + 16) { (*idle)++; }
+  if (shift < 0) {
+    sched_yield();
+    return;
+  }
+  if ((COMM_NAP_MIN_NS << shift) < COMM_NAP_MAX_NS) { nap.tv_nsec = COMM_NAP_MIN_NS << shift; }
+  nanosleep(&nap, NULL);
+}
+
+static void *comm_main(void *unused)
+/* Take exchanges off the queue until told to stop. */
+{
+  commjob *job;
+  cpu_set_t set;
+  int idle = 0;
+
+  (void) unused;
+  if (T.cpu >= 0) {
+    CPU_ZERO(&set);
+    CPU_SET(T.cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      printf("Communication thread: could not bind to cpu %d.\n", T.cpu);
+    }
+  }
+  register_helper_thread(T.params);
+
+  for (;;) {
+    job = spsc_pop(T.todo);
+    if (job == NULL) {
+      back_off(&idle);
+      continue;
+    }
+    idle = 0;
+    if (job->stop) { break; }
+
+    T.H->exchange(job->R, job->layout, T.comm, T.params);
+    while (!spsc_push(T.done, job)) { sched_yield(); }
+  }
+  return NULL;
+}
+
+int start_comm_thread(const halobackend *H, MPI_Comm cart_comm, struct paramstype *params)
+{
+  int provided, rank;
+
+  MPI_Comm_rank(cart_comm, &rank);
+  MPI_Query_thread(&provided);
+  if (provided < MPI_THREAD_SERIALIZED) {
+    if (rank == params->PROBED_RANK) {
+      printf("Communication thread: MPI does not provide MPI_THREAD_SERIALIZED, not starting it.\n");
+    }
+    return 0;
+  }
+
+  memset(&T, 0, sizeof(T));
+  T.todo = new_spsc_queue(COMM_QUEUE);
+  T.done = new_spsc_queue(COMM_QUEUE);
+  T.H = H;
+  T.comm = cart_comm;
+  T.params = params;
+  T.cpu = (params->COMM_CPU[0] != '\0') ? (int) strtol(params->COMM_CPU, NULL, 10) : spare_cpu();
+  if (T.cpu < 0 && rank == params->PROBED_RANK) {
+    printf("Communication thread: no cpu free of OpenMP threads (affinity %s), not bound.\n",
+           params->AFFINITY);
+  }
+
+  pthread_create(&T.thread, NULL, comm_main, NULL);
+  return 1;
+}
+
+void stop_comm_thread(void)
+{
+  T.job.stop = 1;
+  while (!spsc_push(T.todo, &T.job)) { sched_yield(); }
+  pthread_join(T.thread, NULL);
+  delete_spsc_queue(T.todo);
+  delete_spsc_queue(T.done);
+}
+
+void post_exchange(element *R, const int *layout)
+{
+  T.job.R = R;
+  T.job.layout = layout;
+  T.job.stop = 0;
+  while (!spsc_push(T.todo, &T.job)) { sched_yield(); }
+}
+
+void wait_exchange(void)
+{
+  int idle = 0;
+
+  while (spsc_pop(T.done) == NULL) { back_off(&idle); }
+}
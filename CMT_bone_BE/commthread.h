@@ -0,0 +1,88 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMMTHREAD_H_
+#define COMMTHREAD_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <mpi.h>
+
+#include "params.h"
+#include "dstructs.h"
+#include "halo.h"
+
+
+/* --------------------------- Single Producer Queue ----------------------- */
+
+/* A bounded lock-free queue between exactly one producer and one consumer
+   thread. head is only written by the consumer and tail by the producer;
+   the release/acquire pair on them publishes the slot contents. */
+typedef struct {
+  void **slots;
+  unsigned long mask;          // capacity - 1, capacity a power of two
+  atomic_ulong head, tail;
+} spscqueuetype, *spscqueue;
+
+spscqueue new_spsc_queue(unsigned long capacity);
+void delete_spsc_queue(spscqueue Q);
+
+/* Nonzero if item was queued, 0 if the queue is full. Producer only. */
+int spsc_push(spscqueue Q, void *item);
+
+/* The oldest item, NULL if there is none. Consumer only. */
+void *spsc_pop(spscqueue Q);
+
+
+/* -------------------------- Communication Thread ------------------------- */
+
+/* With params->COMM_THREAD, a dedicated thread runs the face exchange, so
+   it progresses while the OpenMP threads compute instead of only inside
+   MPI calls of the master thread. It is pinned to COMM_CPU if given, else
+   to a cpu AFFINITY left without an OpenMP thread (spare_cpu, affinity.h),
+   else not at all. The master hands it an exchange through one queue and
+   takes the finished one back through another; nothing else is shared.
+   Needs at least MPI_THREAD_SERIALIZED: the master makes no MPI calls
+   between posting an exchange and waiting for it.
+
+   Both sides poll their queue. An empty poll yields the core at first and
+   then sleeps, doubling the nap up to COMM_NAP_MAX_NS: an idle thread
+   costs a wakeup per nap instead of a core, and a posted or finished
+   exchange is noticed at most one nap late. */
+
+/* Start the thread, which exchanges with backend H on cart_comm. Call
+   after setup_affinity. Returns 0 (and starts nothing) if the MPI library
+   does not allow it. */
+int start_comm_thread(const halobackend *H, MPI_Comm cart_comm, struct paramstype *params);
+
+/* Stop and join the thread. */
+void stop_comm_thread(void);
+
+/* Hand the exchange of R's faces (layout as in halobackend) to the thread. */
+void post_exchange(element *R, const int *layout);
+
+/* Wait until the posted exchange has finished. */
+void wait_exchange(void);
+
+#endif
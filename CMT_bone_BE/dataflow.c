@@ -0,0 +1,153 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <mpi.h>
+
+#include "dataflow.h"
+#include "params.h"
+#include "halo.h"
+#include "order.h"
+#include "utils.h"
+
+/* The ready list has a single producer, the thread running the exchange,
+   so only the counts and the two cursors need to be atomic. */
+typedef struct {
+  int count;
+  int *deps;                  // face sets each stored element waits for
+  atomic_int *pending;        // what is left of deps this stage
+  int *ready;                 // stored indices, in the order they became ready
+  int filled;                 // entries of ready written (producer only)
+  atomic_int published;       // entries of ready the consumers may take
+  atomic_int claimed;         // entries of ready handed out
+  int sets, arrived;          // face sets per stage, and folded so far
+  int faces[CARTESIAN_DIMENSIONS];
+  const int *layout;
+  struct timespec in;
+} dataflowtype;
+
+static dataflowtype F;
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Dependencies ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static void faces_arrived(int axis, int sign)
+/* The unpack hook: one face set of axis is in. Its elements are the same
+   for either sign (new_extracted_faces). */
+{
+  int e, s;
+
+  (void) sign;
+  for (e = 0; e < F.faces[axis]; e++) {
+    s = F.layout ? F.layout[e] : e;
+    if (atomic_fetch_sub_explicit(&F.pending[s], 1, memory_order_relaxed) == 1) {
+      F.ready[F.filled++] = s;
+    }
+  }
+  atomic_store_explicit(&F.published, F.filled, memory_order_release);
+
+  if (++F.arrived == F.sets) { F.in = now(); }
+}
+
+void setup_dataflow(MPI_Comm cart_comm, int count, struct paramstype *params)
+{
+  int axis, i, e, neighbor[2];
+
+  memset(&F, 0, sizeof(F));
+  F.count = count;
+  F.deps = calloc(count, sizeof(int));
+  F.pending = malloc(sizeof(atomic_int) * count);
+  F.ready = malloc(sizeof(int) * count);
+  F.layout = layout_table();
+
+  F.faces[0] = params->ELEMENTS_ON_X_FACE;
+  F.faces[1] = params->ELEMENTS_ON_Y_FACE;
+  F.faces[2] = params->ELEMENTS_ON_Z_FACE;
+
+  /* Every neighbor sends one face set per stage (halo.h). */
+  for (axis = 0; axis < CARTESIAN_DIMENSIONS; axis++) {
+    if (F.faces[axis] > count) { F.faces[axis] = count; }
+    MPI_Cart_shift(cart_comm, axis, 1, &neighbor[1], &neighbor[0]);
+    for (i = 0; i < 2; i++) {
+      if (neighbor[i] == MPI_PROC_NULL) { continue; }
+      F.sets++;
+      for (e = 0; e < F.faces[axis]; e++) { F.deps[F.layout ? F.layout[e] : e]++; }
+    }
+  }
+
+  for (e = 0; e < count; e++) { atomic_init(&F.pending[e], 0); }
+  atomic_init(&F.published, 0);
+  atomic_init(&F.claimed, 0);
+
+  set_unpack_hook(faces_arrived);
+}
+
+void delete_dataflow(void)
+{
+  set_unpack_hook(NULL);
+  free(F.deps);
+  free(F.pending);
+  free(F.ready);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------- Ready List ------------------------------ */
+/* ------------------------------------------------------------------------- */
+
+void arm_dataflow(void)
+/* Elements on no face go first, in storage order. */
+{
+  int s;
+
+  F.filled = 0;
+  F.arrived = 0;
+  for (s = 0; s < F.count; s++) {
+    atomic_store_explicit(&F.pending[s], F.deps[s], memory_order_relaxed);
+    if (F.deps[s] == 0) { F.ready[F.filled++] = s; }
+  }
+  atomic_store_explicit(&F.claimed, 0, memory_order_relaxed);
+  atomic_store_explicit(&F.published, F.filled, memory_order_release);
+
+  if (F.sets == 0) { F.in = now(); }
+}
+
+int next_ready_element(void)
+{
+  int i = atomic_fetch_add_explicit(&F.claimed, 1, memory_order_relaxed);
+
+  if (i >= F.count) { return -1; }
+  while (i >= atomic_load_explicit(&F.published, memory_order_acquire)) { sched_yield(); }
+  return F.ready[i];
+}
+
+struct timespec dataflow_faces_in(void)
+{
+  return F.in;
+}
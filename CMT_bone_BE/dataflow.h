@@ -0,0 +1,78 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DATAFLOW_H_
+#define DATAFLOW_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <mpi.h>
+
+#include "params.h"
+
+
+/* ---------------------------- Dataflow Compute (B) ----------------------- */
+
+/* With params->DATAFLOW, Compute (B) does not wait for the whole exchange.
+   Every element has an atomic count of the face sets still to be folded
+   into its R (one per axis and neighbor whose faces it is on). The thread
+   that runs the exchange decrements the counts as each face set is
+   unpacked (set_unpack_hook) and publishes the elements that reach zero on
+   a ready list; the compute threads take elements off that list and
+   update them right away. Elements on no exchanged face are ready from the
+   start.
+
+   Compute (B) overwrites an element's R (operation_rk is called with R as
+   the array it updates), so it is safe only because of this invariant:
+   once an element's count reaches zero, no part of the exchange still to
+   come reads or writes it. An element's faces are extracted (or refreshed)
+   for (axis, sign) exactly when a face set is folded back into it for
+   (axis, sign), and every backend extracts a face set before it unpacks
+   the matching one, so the last unpack into an element follows every
+   access to it. A backend that extracts after unpacking, or unpacks into
+   elements it does not count, breaks this. */
+
+/* Count the face sets each of this rank's count elements (stored in the
+   element ordering's layout, order.h) depends on, given its neighbors in
+   cart_comm, and hook into the exchange backends. */
+void setup_dataflow(MPI_Comm cart_comm, int count, struct paramstype *params);
+
+/* Unhook and release everything. */
+void delete_dataflow(void);
+
+/* Reset the counts for one stage and publish the elements that depend on
+   no face. Call before the exchange starts, from the thread that will run
+   it or one that hands it over with release/acquire ordering. */
+void arm_dataflow(void);
+
+/* The next element whose faces are all in, waiting (yielding) for one if
+   none is ready yet, or -1 once every element has been handed out. Any
+   number of threads may call it concurrently. */
+int next_ready_element(void);
+
+/* When the last face set of the stage was folded in (arm_dataflow's time if
+   there were none). Read it once the exchange has returned. */
+struct timespec dataflow_faces_in(void);
+
+#endif
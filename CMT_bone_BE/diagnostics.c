@@ -0,0 +1,198 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <mpi.h>
+
+#include "diagnostics.h"
+#include "params.h"
+#include "flux.h"
+#include "utils.h"
+
+typedef struct {
+  MPI_Comm comm;
+  struct paramstype *params;
+  int rank, blocks, threads;
+  double **acc;          // per thread, blocks * REDUCE_COUNT
+  double *sums, *mins;   // send buffers: { sum, squares } and { min, -max } per block
+  double *gsums, *gmins; // results
+  double values;         // values reduced per block, over all ranks
+  MPI_Request request[2];
+  int pending, step, stage;
+  int count;
+  double exposed;
+  FILE *file;
+} diagnosticsstate;
+
+static diagnosticsstate D;
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------- Reduction ------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+void setup_diagnostics(MPI_Comm comm, struct paramstype *params)
+/* Accumulators are touched by their own thread. Collective. */
+{
+  int ranks;
+
+  memset(&D, 0, sizeof(D));
+  D.comm = comm;
+  D.params = params;
+  D.blocks = params->PHYSICAL_PARAMS;
+  D.threads = params->THREADS;
+  MPI_Comm_rank(comm, &D.rank);
+  MPI_Comm_size(comm, &ranks);
+
+  D.acc = malloc(sizeof(double *) * D.threads);
+  #pragma omp parallel
+  {
+    D.acc[ thread_num() ] = malloc(sizeof(double) * D.blocks * REDUCE_COUNT);
+  }
+  D.sums = malloc(sizeof(double) * D.blocks * 2);
+  D.mins = malloc(sizeof(double) * D.blocks * 2);
+  D.gsums = malloc(sizeof(double) * D.blocks * 2);
+  D.gmins = malloc(sizeof(double) * D.blocks * 2);
+  D.request[0] = D.request[1] = MPI_REQUEST_NULL;
+  D.values = (double) ranks * params->ELEMENTS_PER_PROCESS * params->ELEMENT_SIZE *
+             params->ELEMENT_SIZE * params->ELEMENT_SIZE;
+
+  if (D.rank == 0 && params->DIAGNOSTICS_FILE[0] != '\0') {
+    D.file = fopen(params->DIAGNOSTICS_FILE, "w");
+    if (D.file == NULL) { printf("Could not open diagnostics file %s.\n", params->DIAGNOSTICS_FILE); }
+    else { fprintf(D.file, "step,stage,param,sum,mean,rms,min,max\n"); }
+  }
+}
+
+int diagnostics_due(int step, int stage, struct paramstype *params)
+{
+  return stage == (int) params->RK - 1 && (step + 1) % params->DIAGNOSTICS_EVERY == 0;
+}
+
+void begin_diagnostics(void)
+{
+  int i, b;
+
+  for (i = 0; i < D.threads; i++) {
+    for (b = 0; b < D.blocks; b++) {
+      double *a = D.acc[i] + b * REDUCE_COUNT;
+      a[REDUCE_SUM] = 0;
+      a[REDUCE_SQUARES] = 0;
+      a[REDUCE_MIN] = DBL_MAX;
+      a[REDUCE_MAX] = -DBL_MAX;
+    }
+  }
+}
+
+double *diagnostics_accumulator(int thread, int b)
+{
+  return D.acc[thread] + b * REDUCE_COUNT;
+}
+
+void start_diagnostics(int step, int stage)
+/* One sum and one min reduction; max travels as -max in the min. */
+{
+  int i, b;
+
+  wait_diagnostics();
+
+  for (b = 0; b < D.blocks; b++) {
+    D.sums[2 * b] = D.sums[2 * b + 1] = 0;
+    D.mins[2 * b] = D.mins[2 * b + 1] = DBL_MAX;
+    for (i = 0; i < D.threads; i++) {
+      double *a = D.acc[i] + b * REDUCE_COUNT;
+      D.sums[2 * b] += a[REDUCE_SUM];
+      D.sums[2 * b + 1] += a[REDUCE_SQUARES];
+      if (a[REDUCE_MIN] < D.mins[2 * b]) { D.mins[2 * b] = a[REDUCE_MIN]; }
+      if (-a[REDUCE_MAX] < D.mins[2 * b + 1]) { D.mins[2 * b + 1] = -a[REDUCE_MAX]; }
+    }
+  }
+
+  MPI_Iallreduce(D.sums, D.gsums, 2 * D.blocks, MPI_DOUBLE, MPI_SUM, D.comm, &D.request[0]);
+  MPI_Iallreduce(D.mins, D.gmins, 2 * D.blocks, MPI_DOUBLE, MPI_MIN, D.comm, &D.request[1]);
+  D.pending = 1;
+  D.step = step;
+  D.stage = stage;
+
+  if (!D.params->DIAGNOSTICS_OVERLAP) { wait_diagnostics(); }
+}
+
+void progress_diagnostics(void)
+{
+  int done;
+  if (D.pending) { MPI_Testall(2, D.request, &done, MPI_STATUSES_IGNORE); }
+}
+
+void wait_diagnostics(void)
+{
+  int b;
+  struct timespec t0;
+
+  if (!D.pending) { return; }
+
+  t0 = now();
+  MPI_Waitall(2, D.request, MPI_STATUSES_IGNORE);
+  D.exposed += tdiff(t0, now());
+  D.pending = 0;
+  D.count++;
+
+  if (D.file != NULL) {
+    for (b = 0; b < D.blocks; b++) {
+      fprintf(D.file, "%d,%d,%d,%.17g,%.17g,%.17g,%.17g,%.17g\n", D.step, D.stage, b,
+              D.gsums[2 * b], D.gsums[2 * b] / D.values, sqrt(D.gsums[2 * b + 1] / D.values),
+              D.gmins[2 * b], -D.gmins[2 * b + 1]);
+    }
+  }
+}
+
+void finish_diagnostics(void)
+{
+  int b;
+  double exposed;
+
+  wait_diagnostics();
+  MPI_Reduce(&D.exposed, &exposed, 1, MPI_DOUBLE, MPI_MAX, 0, D.comm);
+
+  if (D.rank == 0 && D.count > 0) {
+    printf("Diagnostics: %d reductions of %s, %s, exposed wait %.6f s in total (slowest rank).\n",
+           D.count, D.params->DIAGNOSTICS, D.params->DIAGNOSTICS_OVERLAP ? "overlapped" : "blocking",
+           exposed);
+    for (b = 0; b < D.blocks; b++) {
+      printf("  param %d after step %d: mean %.9g rms %.9g min %.9g max %.9g\n", b, D.step,
+             D.gsums[2 * b] / D.values, sqrt(D.gsums[2 * b + 1] / D.values),
+             D.gmins[2 * b], -D.gmins[2 * b + 1]);
+    }
+  }
+
+  if (D.file != NULL) { fclose(D.file); }
+  for (b = 0; b < D.threads; b++) { free(D.acc[b]); }
+  free(D.acc);
+  free(D.sums);
+  free(D.mins);
+  free(D.gsums);
+  free(D.gmins);
+}
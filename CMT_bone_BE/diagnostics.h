@@ -0,0 +1,74 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DIAGNOSTICS_H_
+#define DIAGNOSTICS_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+#include "flux.h"
+
+
+/* ------------------------------ Diagnostics ------------------------------ */
+
+/* In-situ statistics of every physical parameter (sum, mean, rms, min and
+   max over all ranks) on the last stage of every DIAGNOSTICS_EVERY-th
+   timestep. The local part is folded into Compute (B) through the
+   kernels' rk_reduce, so it costs no extra pass over memory; the global
+   part is a nonblocking allreduce that drains during the next stage's
+   Compute (A) and is only waited for after it. */
+
+/* Per-thread accumulators and the results file. Collective on comm. */
+void setup_diagnostics(MPI_Comm comm, struct paramstype *params);
+
+/* Nonzero if stage of the 0-based timestep step (counted from the start of
+   the simulation) gathers statistics. */
+int diagnostics_due(int step, int stage, struct paramstype *params);
+
+/* Clear every thread's accumulators before a stage that gathers. */
+void begin_diagnostics(void);
+
+/* The REDUCE_COUNT accumulators of block b on thread. */
+double *diagnostics_accumulator(int thread, int b);
+
+/* Combine the threads and start the global reduction of the statistics
+   taken after timestep step (counted from the start of the simulation, so
+   1 is the first) and stage, finishing it at once unless
+   DIAGNOSTICS_OVERLAP. Collective. */
+void start_diagnostics(int step, int stage);
+
+/* Let a reduction in flight progress; call from the MPI thread only. */
+void progress_diagnostics(void);
+
+/* Finish the reduction in flight, if any, and record its results. The time
+   spent here is the part of the cost that was not hidden. Collective. */
+void wait_diagnostics(void);
+
+/* Finish, print the cost and the last statistics on rank 0 and release
+   everything. Collective. */
+void finish_diagnostics(void);
+
+#endif
@@ -24,13 +24,88 @@ Original:
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
-#include <mpi.h>
+#include <stdatomic.h>
 
 #include "dstructs.h"
 #include "params.h"
+#include "rng.h"
+#include "utils.h"
 #include "time.h"
 
 
+/* -------------------------- Memory Accounting ---------------------------- */
+
+const char *memory_names[MEMORY_COUNT] = { "Q", "R", "RX", "scratch", "faces", "ghosts", "other" };
+
+/* Live bytes (payload + overhead) and payload per category, the
+   high-water marks, and the same over all categories. Objects are made
+   from many threads at once. */
+static atomic_long live[MEMORY_COUNT], payload[MEMORY_COUNT], peak[MEMORY_COUNT];
+static atomic_long live_all, peak_all;
+static int current = MEMORY_OTHER;
+
+/* Heap taken by one malloc(bytes): glibc adds an 8 byte header and rounds
+   up to 16 bytes, 32 at least. */
+static long chunk(long bytes)
+{
+  long c = (bytes + 8 + 15) & ~15L;
+  return c < 32 ? 32 : c;
+}
+
+static void raise_peak(atomic_long *mark, long value)
+{
+  long seen = atomic_load_explicit(mark, memory_order_relaxed);
+  while (value > seen &&
+         !atomic_compare_exchange_weak_explicit(mark, &seen, value, memory_order_relaxed,
+                                                memory_order_relaxed)) { }
+}
+
+/* Add heap bytes, values included, of which values are payload; both are
+   negative when released. */
+static void account(int category, long heap, long values)
+{
+  long now = atomic_fetch_add_explicit(&live[category], heap, memory_order_relaxed) + heap;
+  atomic_fetch_add_explicit(&payload[category], values, memory_order_relaxed);
+  raise_peak(&peak[category], now);
+  now = atomic_fetch_add_explicit(&live_all, heap, memory_order_relaxed) + heap;
+  raise_peak(&peak_all, now);
+}
+
+/* Heap of a ternix: the struct, the row and column pointer arrays and one
+   malloc per line of layers. */
+static long ternix_heap(int rows, int cols, int layers)
+{
+  return chunk(sizeof(ternixtype)) + chunk(sizeof(dtype *) * rows) +
+         (long) rows * (chunk(sizeof(dtype *) * cols) + cols * chunk(sizeof(dtype) * layers));
+}
+
+int memory_category(int category)
+{
+  int previous = current;
+  current = category;
+  return previous;
+}
+
+void memory_track(int category, long bytes, int sign)
+{
+  account(category, sign * chunk(bytes), sign * bytes);
+}
+
+memoryusage memory_usage(int category)
+{
+  memoryusage U;
+  U.payload = atomic_load(&payload[category]);
+  U.overhead = atomic_load(&live[category]) - U.payload;
+  U.peak = atomic_load(&peak[category]);
+  return U;
+}
+
+long memory_peak(void)
+{
+  return atomic_load(&peak_all);
+}
+
+
 /* -------------------------- Vector Functions ----------------------------- */
 
 /* Make a new 'vector' type and allocate memory for it. */
@@ -38,13 +113,17 @@ vector new_vector(int size)
 {
   vector X = malloc(sizeof(vectortype));
   X->size = size;
-  X->V = malloc(sizeof( dtype * ) * size);
+  X->V = malloc(sizeof( dtype ) * size);
+  account(MEMORY_FACES, chunk(sizeof(vectortype)) + chunk(sizeof(dtype) * size),
+          sizeof(dtype) * size);
   return X;
 }
 
 /* Free up the memory allocated for the vector X. */
 void delete_vector(vector X)
 {
+  account(MEMORY_FACES, -(chunk(sizeof(vectortype)) + chunk(sizeof(dtype) * X->size)),
+          -(long) sizeof(dtype) * X->size);
   free(X->V);
   free(X);
 }
@@ -76,12 +155,15 @@ matrix new_matrix(int rows, int cols)
   matrix A = malloc(sizeof(matrixtype));
   A->rows = rows;
   A->cols = cols;
+  A->category = current;
   A->M = malloc(sizeof( dtype * ) * rows);
 
   for (i = 0; i < rows; i++) {
-    A->M[i] = malloc(sizeof( dtype * ) * cols);
+    A->M[i] = malloc(sizeof( dtype ) * cols);
   }
 
+  account(A->category, chunk(sizeof(matrixtype)) + chunk(sizeof(dtype *) * rows) +
+          (long) rows * chunk(sizeof(dtype) * cols), (long) sizeof(dtype) * rows * cols);
   return A;
 }
 
@@ -89,6 +171,8 @@ matrix new_matrix(int rows, int cols)
 void delete_matrix(matrix A)
 {
   int row;
+  account(A->category, -(chunk(sizeof(matrixtype)) + chunk(sizeof(dtype *) * A->rows) +
+          (long) A->rows * chunk(sizeof(dtype) * A->cols)), -(long) sizeof(dtype) * A->rows * A->cols);
   for (row = 0; row<(A->rows); row++) { free(A->M[row]); }
   free(A->M);
   free(A);
@@ -125,17 +209,39 @@ matrix new_random_matrix(int rows, int cols, dtype lower, dtype upper)
 }
 
 
+/* Fill a matrix from the counter-based generator over [lower, upper). */
+void counter_fill_matrix(matrix A, dtype lower, dtype upper, rngkey key)
+{
+  int row, col;
+  rngkey n = 0;
+  for (row = 0; row<(A->rows); row++) {
+    for (col = 0; col<(A->cols); col++) {
+      A->M[row][col] = (dtype) rng_uniform(key, n++) * (upper - lower + 1) + lower;
+    }
+  }
+}
+
+
+/* Return a newly-allocated matrix filled from the counter-based generator. */
+matrix new_counter_matrix(int rows, int cols, dtype lower, dtype upper, rngkey key)
+{
+  matrix A = new_matrix(rows, cols);
+  counter_fill_matrix(A, lower, upper, key);
+  return A;
+}
+
+
 /* -------------------------- Ternix Functions ----------------------------- */
 
-/* Make a new 'ternix' type and allocate memory for it.
-  Access is done by: A->T[row][column][layer]. */
-ternix new_ternix(int rows, int cols, int layers)
+/* new_ternix, counted under category. */
+static ternix tagged_ternix(int rows, int cols, int layers, int category)
 {
   int i, j;
   ternix A = malloc(sizeof(ternixtype));
   A->rows = rows;
   A->cols = cols;
   A->layers = layers;
+  A->category = category;
   A->T = malloc( sizeof( dtype * ) * rows );
 
   for (i = 0; i<rows; i++) {
@@ -145,14 +251,25 @@ ternix new_ternix(int rows, int cols, int layers)
     }
   }
 
+  account(category, ternix_heap(rows, cols, layers), (long) sizeof(dtype) * rows * cols * layers);
   return A;
 }
 
 
+/* Make a new 'ternix' type and allocate memory for it.
+  Access is done by: A->T[row][column][layer]. */
+ternix new_ternix(int rows, int cols, int layers)
+{
+  return tagged_ternix(rows, cols, layers, current);
+}
+
+
 /* Free up the memory allocated for the ternix A. */
 void delete_ternix(ternix A)
 {
   int row, col;
+  account(A->category, -ternix_heap(A->rows, A->cols, A->layers),
+          -(long) sizeof(dtype) * A->rows * A->cols * A->layers);
   for (row = 0; row<(A->rows); row++) {
     for (col = 0; col<(A->cols); col++) {
       free(A->T[row][col]);
@@ -212,8 +329,62 @@ ternix new_random_ternix(int rows, int cols, int layers,
 }
 
 
+/* Fill a ternix from the counter-based generator over [lower, upper): the
+   value at (row, col, layer) depends only on key and its position. */
+void counter_fill_ternix(ternix A, dtype lower, dtype upper, rngkey key)
+{
+  int row, col, layer;
+  rngkey n = 0;
+  for (row = 0; row<(A->rows); row++) {
+    for (col = 0; col<(A->cols); col++) {
+      for(layer = 0; layer<(A->layers); layer++) {
+        A->T[row][col][layer] = (dtype) rng_uniform(key, n++) * (upper - lower + 1) + lower;
+      }
+    }
+  }
+}
+
+
+/* Return a newly-allocated ternix filled from the counter-based generator. */
+ternix new_counter_ternix(int rows, int cols, int layers,
+                          dtype lower, dtype upper, rngkey key)
+{
+  ternix A = new_ternix(rows, cols, layers);
+  counter_fill_ternix(A, lower, upper, key);
+  return A;
+}
+
+
 /* -------------------------- Element Functions ---------------------------- */
 
+/* Count (sign 1) or release (sign -1) the struct and block array of A;
+   its blocks count themselves. */
+static void track_element(element A, int sign, struct paramstype *params)
+{
+  if (sign > 0) { A->category = current; }
+  account(A->category, sign * (chunk(sizeof(elementtype)) +
+                               chunk(sizeof(ternix) * params->PHYSICAL_PARAMS)), 0);
+}
+
+
+/* Return an element with PHYSICAL_PARAMTERS blocks of ELEMENT_SIZE, left
+   uninitialized for the caller to fill. */
+element new_element(struct paramstype *params)
+{
+  int i;
+  element A = malloc(sizeof(elementtype));
+
+  A->B = malloc(sizeof( ternix * ) * params->PHYSICAL_PARAMS);
+  track_element(A, 1, params);
+
+  for (i = 0; i < params->PHYSICAL_PARAMS; i++) {
+    A->B[i] = new_ternix(params->ELEMENT_SIZE, params->ELEMENT_SIZE, params->ELEMENT_SIZE);
+  }
+
+  return A;
+}
+
+
 /* Return an element with PHYSICAL_PARAMTERS blocks of ELEMENT_SIZE,
    randomly filled with ternices over [lower, upper). */
 element new_random_element(dtype lower, dtype upper, struct paramstype *params)
@@ -222,6 +393,7 @@ element new_random_element(dtype lower, dtype upper, struct paramstype *params)
   element A = malloc(sizeof(elementtype));
 
   A->B = malloc(sizeof( ternix * ) * params->PHYSICAL_PARAMS);
+  track_element(A, 1, params);
 
   for (i = 0; i < params->PHYSICAL_PARAMS; i++) {
     A->B[i] = new_random_ternix( params->ELEMENT_SIZE, params->ELEMENT_SIZE, params->ELEMENT_SIZE,
@@ -232,6 +404,26 @@ element new_random_element(dtype lower, dtype upper, struct paramstype *params)
 }
 
 
+/* Same as new_random_element, but block b is filled from the counter-based
+   generator under rng_key(key, b), so the element is reproducible no matter
+   which thread creates it or when. */
+element new_counter_element(dtype lower, dtype upper, rngkey key, struct paramstype *params)
+{
+  int i;
+  element A = malloc(sizeof(elementtype));
+
+  A->B = malloc(sizeof( ternix * ) * params->PHYSICAL_PARAMS);
+  track_element(A, 1, params);
+
+  for (i = 0; i < params->PHYSICAL_PARAMS; i++) {
+    A->B[i] = new_counter_ternix( params->ELEMENT_SIZE, params->ELEMENT_SIZE, params->ELEMENT_SIZE,
+                                  lower, upper, rng_key(key, i) );
+  }
+
+  return A;
+}
+
+
 /* Return an element with PHYSICAL_PARAMTERS blocks of ELEMENT_SIZE. */
 element new_zero_element(struct paramstype *params)
 {
@@ -239,6 +431,7 @@ element new_zero_element(struct paramstype *params)
   element A = malloc( sizeof(elementtype) );
 
   A->B = malloc( sizeof( ternix * ) * params->PHYSICAL_PARAMS );
+  track_element(A, 1, params);
 
   for (i = 0; i < params->PHYSICAL_PARAMS; i++) {
     A->B[i] = new_zero_ternix(params->ELEMENT_SIZE, params->ELEMENT_SIZE, params->ELEMENT_SIZE);
@@ -255,9 +448,162 @@ void delete_element(element A, struct paramstype *params)
 
   for (i = 0; i < params->PHYSICAL_PARAMS; i++) { delete_ternix( A->B[i] ); }
 
+  track_element(A, -1, params);
   free(A->B);
   free(A);
 }
 
 
+/* -------------------------- Scratch Functions ---------------------------- */
+
+/* A zeroed N^3 ternix counted as scratch whatever the current category. */
+static ternix scratch_ternix(int N)
+{
+  ternix A = tagged_ternix(N, N, N, MEMORY_SCRATCH);
+  zero_ternix(A);
+  return A;
+}
+
+
+/* Return a zeroed set of Compute (A) intermediates. Call this from the
+   thread that will use it so the pages land on that thread's NUMA node. */
+scratch new_scratch(struct paramstype *params)
+{
+  int N = params->ELEMENT_SIZE;
+  scratch S = malloc(sizeof(scratchtype));
+
+  S->Ur = scratch_ternix(N);
+  S->Us = scratch_ternix(N);
+  S->Ut = scratch_ternix(N);
+  S->Vr = scratch_ternix(N);
+  S->Vs = scratch_ternix(N);
+  S->Vt = scratch_ternix(N);
+  S->W = NULL;
+  S->Wbytes = 0;
+  account(MEMORY_SCRATCH, chunk(sizeof(scratchtype)), 0);
+
+  return S;
+}
 
+
+/* Frees up the memory allocated for the scratch set S. */
+void delete_scratch(scratch S)
+{
+  delete_ternix(S->Ur);
+  delete_ternix(S->Us);
+  delete_ternix(S->Ut);
+  delete_ternix(S->Vr);
+  delete_ternix(S->Vs);
+  delete_ternix(S->Vt);
+  if (S->W != NULL) { memory_track(MEMORY_SCRATCH, S->Wbytes, -1); }
+  account(MEMORY_SCRATCH, -chunk(sizeof(scratchtype)), 0);
+  free(S->W);
+  free(S);
+}
+
+
+/* Return a zeroed tile of Compute (A) intermediates for up to blocks
+   blocks. Like new_scratch, call this from the thread that will use it. */
+tilescratch new_tile_scratch(int blocks, struct paramstype *params)
+{
+  int N = params->ELEMENT_SIZE, i;
+  tilescratch S = malloc(sizeof(tilescratchtype));
+
+  S->blocks = blocks;
+  S->Ur = malloc(sizeof(ternix) * blocks);
+  S->Us = malloc(sizeof(ternix) * blocks);
+  S->Ut = malloc(sizeof(ternix) * blocks);
+  S->Vr = malloc(sizeof(ternix) * blocks);
+  S->Vs = malloc(sizeof(ternix) * blocks);
+  S->Vt = malloc(sizeof(ternix) * blocks);
+  account(MEMORY_SCRATCH, chunk(sizeof(tilescratchtype)) + 6 * chunk(sizeof(ternix) * blocks), 0);
+
+  for (i = 0; i < blocks; i++) {
+    S->Ur[i] = scratch_ternix(N);
+    S->Us[i] = scratch_ternix(N);
+    S->Ut[i] = scratch_ternix(N);
+    S->Vr[i] = scratch_ternix(N);
+    S->Vs[i] = scratch_ternix(N);
+    S->Vt[i] = scratch_ternix(N);
+  }
+
+  return S;
+}
+
+
+/* Frees up the memory allocated for the tile S. */
+void delete_tile_scratch(tilescratch S)
+{
+  int i;
+
+  for (i = 0; i < S->blocks; i++) {
+    delete_ternix(S->Ur[i]);
+    delete_ternix(S->Us[i]);
+    delete_ternix(S->Ut[i]);
+    delete_ternix(S->Vr[i]);
+    delete_ternix(S->Vs[i]);
+    delete_ternix(S->Vt[i]);
+  }
+  account(MEMORY_SCRATCH, -(chunk(sizeof(tilescratchtype)) + 6 * chunk(sizeof(ternix) * S->blocks)), 0);
+  free(S->Ur);
+  free(S->Us);
+  free(S->Ut);
+  free(S->Vr);
+  free(S->Vs);
+  free(S->Vt);
+  free(S);
+}
+
+
+/* Return a pool of scratch sets, one per thread, each made by its thread so
+   its pages land on that thread's NUMA node. */
+scratchpool new_scratch_pool(int tile, long wvalues, struct paramstype *params)
+{
+  scratchpool P = malloc(sizeof(scratchpooltype));
+
+  P->threads = params->THREADS;
+  P->S = malloc(sizeof(scratch) * P->threads);
+  P->tiles = tile > 0 ? malloc(sizeof(tilescratch) * P->threads) : NULL;
+
+  #pragma omp parallel
+  {
+    scratch S = P->S[ thread_num() ] = new_scratch(params);
+    if (wvalues > 0) {
+      S->Wbytes = wvalues * sizeof(dtype);
+      S->W = calloc(wvalues, sizeof(dtype));
+      memory_track(MEMORY_SCRATCH, S->Wbytes, 1);
+    }
+    if (tile > 0) { P->tiles[ thread_num() ] = new_tile_scratch(tile, params); }
+  }
+
+  return P;
+}
+
+
+/* Frees up the pool P and every set in it. */
+void delete_scratch_pool(scratchpool P)
+{
+  int i;
+
+  for (i = 0; i < P->threads; i++) {
+    delete_scratch(P->S[i]);
+    if (P->tiles != NULL) { delete_tile_scratch(P->tiles[i]); }
+  }
+  free(P->S);
+  free(P->tiles);
+  free(P);
+}
+
+
+/* The calling thread's scratch set. */
+scratch pool_scratch(scratchpool P)
+{
+  return P->S[ thread_num() ];
+}
+
+
+/* The calling thread's tile. */
+tilescratch pool_tile(scratchpool P)
+{
+  return P->tiles[ thread_num() ];
+}
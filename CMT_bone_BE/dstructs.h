@@ -27,9 +27,10 @@ Original:
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
-#include <mpi.h>
+#include <float.h>
 
 #include "params.h"
+#include "rng.h"
 
 /* -------------------------- Type Definitions ---------------------------- */
 
@@ -37,7 +38,16 @@ Original:
    so it is dependent on the macro PHYSICAL_PARAMS for the size of B. */
 
 
+/* Working precision, chosen at build time (make PRECISION=single). */
+#ifdef CMT_SINGLE
+typedef float dtype;  // dtype: internal data storage type for calculations
+#define DTYPE_EPSILON FLT_EPSILON
+#define DTYPE_NAME "single"
+#else
 typedef double dtype; // dtype: internal data storage type for calculations
+#define DTYPE_EPSILON DBL_EPSILON
+#define DTYPE_NAME "double"
+#endif
 
 typedef struct {
   int size;
@@ -48,6 +58,7 @@ typedef struct {
   int rows;
   int cols;
   dtype ** M;
+  int category;         // memory category it is counted under
 } matrixtype, *matrix;
 
 typedef struct {
@@ -55,12 +66,71 @@ typedef struct {
   int cols;
   int layers;
   dtype *** T;
+  int category;
 } ternixtype, *ternix;
 
 typedef struct {
   ternix *B;
+  int category;
 } elementtype, *element;
 
+/* Per-thread intermediate ternices used by Compute (A). */
+typedef struct {
+  ternix Ur, Us, Ut;    // conv outputs
+  ternix Vr, Vs, Vt;    // derivative outputs
+  dtype *W;             // whole-element work area of the interleaved kernels (flux.h), or NULL
+  long Wbytes;          // its size
+} scratchtype, *scratch;
+
+/* Per-thread intermediates of a Compute (A) tile of several blocks: the
+   conv and derivative outputs of every block. */
+typedef struct {
+  int blocks;
+  ternix *Ur, *Us, *Ut;
+  ternix *Vr, *Vs, *Vt;
+} tilescratchtype, *tilescratch;
+
+/* One scratch set, and optionally one tile, per thread. The kernels
+   overwrite what they use, so a set serves every call its thread makes. */
+typedef struct {
+  int threads;
+  scratch *S;
+  tilescratch *tiles;   // NULL without tiles
+} scratchpooltype, *scratchpool;
+
+/* -------------------------- Memory Accounting ---------------------------- */
+
+/* Every new_* and delete_* below counts what it takes from the heap under
+   a category: the payload (the dtype values) and the overhead (structs,
+   the pointer arrays of matrices and ternices, and the allocator's own
+   header and rounding of each malloc). Vectors are face buffers and
+   scratch sets are scratch; matrices, ternices and elements go to the
+   category set with memory_category when they are made. */
+enum {
+  MEMORY_Q, MEMORY_R, MEMORY_RX, MEMORY_SCRATCH, MEMORY_FACES, MEMORY_GHOSTS, MEMORY_OTHER,
+  MEMORY_COUNT
+};
+
+extern const char *memory_names[MEMORY_COUNT];
+
+/* Live bytes of one category and its high-water mark (payload + overhead). */
+typedef struct {
+  long payload, overhead, peak;
+} memoryusage;
+
+/* Category of the matrices, ternices and elements made from now on;
+   returns the previous one. Set it outside parallel regions. */
+	int memory_category(int category);
+
+/* Count (sign 1) or release (sign -1) one malloc of bytes of values made
+   outside this file. */
+	void memory_track(int category, long bytes, int sign);
+
+	memoryusage memory_usage(int category);
+
+/* High-water mark of all categories together. */
+	long memory_peak(void);
+
 /* -------------------------- Vector Functions ----------------------------- */
 	vector new_vector(int size);
 	void delete_vector(vector X);
@@ -73,6 +143,8 @@ typedef struct {
 	void zero_matrix(matrix A);
 	void random_fill_matrix(matrix A, dtype lower, dtype upper);
 	matrix new_random_matrix(int rows, int cols, dtype lower, dtype upper);
+	void counter_fill_matrix(matrix A, dtype lower, dtype upper, rngkey key);
+	matrix new_counter_matrix(int rows, int cols, dtype lower, dtype upper, rngkey key);
 
 /* -------------------------- Ternix Functions ----------------------------- */
 	ternix new_ternix(int rows, int cols, int layers);
@@ -82,11 +154,32 @@ typedef struct {
 	void random_fill_ternix(ternix A, dtype lower, dtype upper);
 	ternix new_random_ternix(int rows, int cols, int layers,
                          dtype lower, dtype upper);
+	void counter_fill_ternix(ternix A, dtype lower, dtype upper, rngkey key);
+	ternix new_counter_ternix(int rows, int cols, int layers,
+                          dtype lower, dtype upper, rngkey key);
 
 /* -------------------------- Element Functions ---------------------------- */
+	element new_element(struct paramstype *params);
 	element new_random_element(dtype lower, dtype upper, struct paramstype *params);
+	element new_counter_element(dtype lower, dtype upper, rngkey key, struct paramstype *params);
 	element new_zero_element(struct paramstype *params);
 	void delete_element(element A, struct paramstype *params);
 
+/* -------------------------- Scratch Functions ---------------------------- */
+	scratch new_scratch(struct paramstype *params);
+	void delete_scratch(scratch S);
+	tilescratch new_tile_scratch(int blocks, struct paramstype *params);
+	void delete_tile_scratch(tilescratch S);
+
+/* A pool for params->THREADS threads, each set made (and first touched)
+   by its thread: tiles of tile blocks if tile > 0, and a W of wvalues
+   values (flux.h) if wvalues > 0. Call it outside parallel regions. */
+	scratchpool new_scratch_pool(int tile, long wvalues, struct paramstype *params);
+	void delete_scratch_pool(scratchpool P);
+
+/* The calling thread's set and tile. */
+	scratch pool_scratch(scratchpool P);
+	tilescratch pool_tile(scratchpool P);
+
 #endif
 
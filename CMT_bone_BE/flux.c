@@ -24,17 +24,20 @@ Original:
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
-#include <mpi.h>
+
+#include <string.h>
 
 #include "params.h"
 #include "dstructs.h"
+#include "flux.h"
 
 
 /* ------------------------------------------------------------------------- */
 /* ---------------------------- Face Functions ----------------------------- */
 /* ------------------------------------------------------------------------- */
 
-vector new_extracted_faces(element *elements, int axis, int sign, struct paramstype *params)
+vector new_extracted_faces(element *elements, const int *layout, int axis, int sign,
+                           struct paramstype *params)
 /* Return a collection of faces from a set of elements, where the faces
    for each physical parameter have been clumped together in anticipation
    of a transfer operation. Possible values for arguments:
@@ -45,7 +48,7 @@ vector new_extracted_faces(element *elements, int axis, int sign, struct paramst
    The resulting vector output is of size: PHYSICAL_PARAMS * FACE_SIZE
    multiplied by the number of elements on the face of interest. */
 {
-  int i, b, e, row, col, layer, plane, EoF;
+  int i, b, e, s, row, col, layer, plane, EoF;
 
   EoF=0;
   switch (axis) { /* EoF: elements on face */
@@ -66,6 +69,9 @@ vector new_extracted_faces(element *elements, int axis, int sign, struct paramst
   /* For each element owned by this rank: */
   for (e = 0; e < EoF; e++) {
 
+    /* Where it is stored. */
+    s = layout ? layout[e] : e;
+
     /* For each block in the element: */
     for (b = 0; b < params->PHYSICAL_PARAMS; b++) {
 
@@ -74,21 +80,21 @@ vector new_extracted_faces(element *elements, int axis, int sign, struct paramst
 
         for (col = 0; col < params->ELEMENT_SIZE; col++) {
           for (layer = 0; layer < params->ELEMENT_SIZE; layer++) {
-            faces->V[i] = elements[e]->B[b]->T[plane][col][layer]; i++; } }
+            faces->V[i] = elements[s]->B[b]->T[plane][col][layer]; i++; } }
 
       } else if ( axis == 1 ) {
         /* If this is the Y axis, the plane is on the column dimension. */
 
         for (row = 0; row < params->ELEMENT_SIZE; row++) {
           for (layer = 0; layer < params->ELEMENT_SIZE; layer++) {
-            faces->V[i] = elements[e]->B[b]->T[row][plane][layer]; i++; } }
+            faces->V[i] = elements[s]->B[b]->T[row][plane][layer]; i++; } }
 
       } else if ( axis == 2 ) {
         /* If this is the Z axis, the plane is on the layer dimension. */
 
         for (row = 0; row < params->ELEMENT_SIZE; row++) {
           for (col = 0; col < params->ELEMENT_SIZE; col++) {
-            faces->V[i] = elements[e]->B[b]->T[row][col][plane]; i++; } }
+            faces->V[i] = elements[s]->B[b]->T[row][col][plane]; i++; } }
       }
     }
   }
@@ -110,98 +116,187 @@ vector new_empty_faces(int axis, struct paramstype *params)
   return new_vector(EoF * params->PHYSICAL_PARAMS * params->FACE_SIZE);
 }
 
+
+
+void refresh_faces(element *elements, const int *layout, vector faces, int axis, int sign,
+                   int touched, struct paramstype *params)
+/* Re-read the entries of faces (as extracted with the same axis and sign)
+   that lie on either boundary plane of axis touched, for the elements both
+   axes exchange. Those are the edge lines unpack_faces on touched can
+   change; after it, faces equal a fresh extraction. */
+{
+  int e, s, b, d, w, x[3], N = params->ELEMENT_SIZE, EoF[3], lo, hi, other;
+  long base;
+
+  EoF[0] = params->ELEMENTS_ON_X_FACE;
+  EoF[1] = params->ELEMENTS_ON_Y_FACE;
+  EoF[2] = params->ELEMENTS_ON_Z_FACE;
+
+  /* The face's two dimensions, in extraction order, and the one of them
+     that runs along the edge lines. */
+  lo = (axis == 0) ? 1 : 0;
+  hi = 3 - axis - lo;
+  other = (touched == lo) ? hi : lo;
+
+  x[axis] = (sign == 1) ? N - 1 : 0;
+
+  for (e = 0; e < EoF[axis] && e < EoF[touched]; e++) {
+    s = layout ? layout[e] : e;
+    for (b = 0; b < params->PHYSICAL_PARAMS; b++) {
+      base = ((long) e * params->PHYSICAL_PARAMS + b) * N * N;
+      for (d = 0; d < 2; d++) {
+        x[touched] = d ? N - 1 : 0;
+        for (w = 0; w < N; w++) {
+          x[other] = w;
+          faces->V[base + (long) x[lo] * N + x[hi]] = elements[s]->B[b]->T[x[0]][x[1]][x[2]];
+        }
+      }
+    }
+  }
+}
+
+
+
+void unpack_faces(element *elements, const int *layout, vector faces, int axis, int sign,
+                  struct paramstype *params)
+/* Fold a neighbor's faces (as produced by new_extracted_faces on the other
+   side) into the matching face planes of our elements. This is the faked
+   flux: the boundary plane becomes the average of both sides. Without
+   FOLD_FACES the faces are dropped, as the original exchange did. */
+{
+  int i, b, e, s, row, col, layer, plane, EoF;
+
+  if (!params->FOLD_FACES) { return; }
+
+  EoF=0;
+  switch (axis) { /* EoF: elements on face */
+  case 0: EoF = params->ELEMENTS_ON_X_FACE; break;
+  case 1: EoF = params->ELEMENTS_ON_Y_FACE; break;
+  case 2: EoF = params->ELEMENTS_ON_Z_FACE; break; }
+
+  /* Same plane and ordering as the extraction on our side. */
+  plane = (sign > 0) ? params->ELEMENT_SIZE - 1 : 0;
+  i = 0;
+
+  for (e = 0; e < EoF; e++) {
+    s = layout ? layout[e] : e;
+    for (b = 0; b < params->PHYSICAL_PARAMS; b++) {
+
+      if ( axis == 0 ) {
+        for (col = 0; col < params->ELEMENT_SIZE; col++) {
+          for (layer = 0; layer < params->ELEMENT_SIZE; layer++) {
+            dtype *x = &elements[s]->B[b]->T[plane][col][layer];
+            *x = 0.5 * (*x + faces->V[i]); i++; } }
+
+      } else if ( axis == 1 ) {
+        for (row = 0; row < params->ELEMENT_SIZE; row++) {
+          for (layer = 0; layer < params->ELEMENT_SIZE; layer++) {
+            dtype *x = &elements[s]->B[b]->T[row][plane][layer];
+            *x = 0.5 * (*x + faces->V[i]); i++; } }
+
+      } else if ( axis == 2 ) {
+        for (row = 0; row < params->ELEMENT_SIZE; row++) {
+          for (col = 0; col < params->ELEMENT_SIZE; col++) {
+            dtype *x = &elements[s]->B[b]->T[row][col][plane];
+            *x = 0.5 * (*x + faces->V[i]); i++; } }
+      }
+    }
+  }
+}
+
 /* ------------------------------------------------------------------------- */
 /* ------------------------ Faked CMT-Nek Operations ----------------------- */
 /* ------------------------------------------------------------------------- */
 
 void operation_dr(matrix A, ternix B, ternix C, struct paramstype *params)
-/* Perform the R axis derivative operation, with kernel A and result C. */
+/* Perform the R axis derivative operation, with kernel A and result C.
+   Every output is assigned once, so C needs no zeroing beforehand. */
 {
-  zero_ternix(C);
-
   int k, j, i, g;
+  dtype s;
 
   for (k = 0; k < params->ELEMENT_SIZE; k++) {
     for (j = 0; j < params->ELEMENT_SIZE; j++) {
       for (i = 0; i < params->ELEMENT_SIZE; i++) {
-        for (g = 0; g < params->ELEMENT_SIZE; g++) {
-          C->T[i][j][k] += A->M[i][g] * B->T[g][j][k]; } } } }
+        s = A->M[i][0] * B->T[0][j][k];
+        for (g = 1; g < params->ELEMENT_SIZE; g++) {
+          s += A->M[i][g] * B->T[g][j][k]; }
+        C->T[i][j][k] = s; } } }
 }
 
 void operation_ds(matrix A, ternix B, ternix C, struct paramstype *params)
-/* Perform the S axis derivative operation, with kernel A and result C. */
+/* Perform the S axis derivative operation, with kernel A and result C.
+   Every output is assigned once, so C needs no zeroing beforehand. */
 {
-  zero_ternix(C);
-
   int k, j, i, g;
+  dtype s;
 
   for (k = 0; k < params->ELEMENT_SIZE; k++) {
     for (j = 0; j < params->ELEMENT_SIZE; j++) {
       for (i = 0; i < params->ELEMENT_SIZE; i++) {
-        for (g = 0; g < params->ELEMENT_SIZE; g++) {
-          C->T[i][j][k] += A->M[j][g] * B->T[i][g][k]; } } } }
+        s = A->M[j][0] * B->T[i][0][k];
+        for (g = 1; g < params->ELEMENT_SIZE; g++) {
+          s += A->M[j][g] * B->T[i][g][k]; }
+        C->T[i][j][k] = s; } } }
 }
 
 void operation_dt(matrix A, ternix B, ternix C, struct paramstype *params)
-/* Perform the T axis derivative operation, with kernel A and result C. */
+/* Perform the T axis derivative operation, with kernel A and result C.
+   Every output is assigned once, so C needs no zeroing beforehand. */
 {
-  zero_ternix(C);
-
   int k, j, i, g;
+  dtype s;
 
   for (k = 0; k < params->ELEMENT_SIZE; k++) {
     for (j = 0; j < params->ELEMENT_SIZE; j++) {
       for (i = 0; i < params->ELEMENT_SIZE; i++) {
-        for (g = 0; g < params->ELEMENT_SIZE; g++) {
-          C->T[i][j][k] += A->M[k][g] * B->T[i][j][g]; } } } }
+        s = A->M[k][0] * B->T[i][j][0];
+        for (g = 1; g < params->ELEMENT_SIZE; g++) {
+          s += A->M[k][g] * B->T[i][j][g]; }
+        C->T[i][j][k] = s; } } }
 }
 
-void operation_conv(ternix Q, ternix *RX, ternix Hx, ternix Hy, ternix Hz,
-                    ternix Ur, ternix Us, ternix Ut, struct paramstype *params)
-/* Given Q, produce UR, US, and UT by faked transformation. HX, HY, and HZ
-   are temporary space. RX is the list of transformation ternices. */
+void operation_conv(ternix Q, ternix *RX, const dtype *coef, ternix Ur, ternix Us, ternix Ut,
+                    struct paramstype *params)
+/* Given Q, produce UR, US, and UT by faked transformation. RX is the list
+   of transformation ternices and coef the three scaling constants (the
+   caller draws them, see rng.h). */
 {
 
-  /* Generate three random constants. */
+  /* The three random constants. */
 
-  dtype a = ((dtype) rand() / (RAND_MAX));
-  dtype b = ((dtype) rand() / (RAND_MAX));
-  dtype c = ((dtype) rand() / (RAND_MAX));
+  dtype a = coef[0];
+  dtype b = coef[1];
+  dtype c = coef[2];
 
   int k, j, i;
+  dtype hx, hy, hz;
 
-  /* First, make HX, HY, and HZ, which are used in the next step. */
+  /* HX, HY, and HZ are scaled copies of Q, made point by point and never
+     stored. */
 
   for (k = 0; k < params->ELEMENT_SIZE; k++) {
     for (j = 0; j < params->ELEMENT_SIZE; j++) {
       for (i = 0; i < params->ELEMENT_SIZE; i++) {
-        Hx->T[i][j][k] = a * Q->T[i][j][k];
-        Hy->T[i][j][k] = b * Q->T[i][j][k];
-        Hz->T[i][j][k] = c * Q->T[i][j][k];
-      }
-    }
-  }
-
-  /* Then, produce our outputs using HX, HY, HZ, and RX. */
 
-  for (k = 0; k < params->ELEMENT_SIZE; k++) {
-    for (j = 0; j < params->ELEMENT_SIZE; j++) {
-      for (i = 0; i < params->ELEMENT_SIZE; i++) {
+        hx = a * Q->T[i][j][k];
+        hy = b * Q->T[i][j][k];
+        hz = c * Q->T[i][j][k];
 
         /* Generate UR. */
-        Ur->T[i][j][k] = ( RX[0]->T[i][j][k] * Hx->T[i][j][k] +
-                           RX[1]->T[i][j][k] * Hy->T[i][j][k] +
-                           RX[2]->T[i][j][k] * Hz->T[i][j][k] );
+        Ur->T[i][j][k] = ( RX[0]->T[i][j][k] * hx +
+                           RX[1]->T[i][j][k] * hy +
+                           RX[2]->T[i][j][k] * hz );
 
-        /* Generate UR. */
-        Us->T[i][j][k] = ( RX[3]->T[i][j][k] * Hx->T[i][j][k] +
-                           RX[4]->T[i][j][k] * Hy->T[i][j][k] +
-                           RX[5]->T[i][j][k] * Hz->T[i][j][k] );
+        /* Generate US. */
+        Us->T[i][j][k] = ( RX[3]->T[i][j][k] * hx +
+                           RX[4]->T[i][j][k] * hy +
+                           RX[5]->T[i][j][k] * hz );
 
         /* Generate UT. */
-        Ut->T[i][j][k] = ( RX[6]->T[i][j][k] * Hx->T[i][j][k] +
-                           RX[7]->T[i][j][k] * Hy->T[i][j][k] +
-                           RX[8]->T[i][j][k] * Hz->T[i][j][k] );
+        Ut->T[i][j][k] = ( RX[6]->T[i][j][k] * hx +
+                           RX[7]->T[i][j][k] * hy +
+                           RX[8]->T[i][j][k] * hz );
 
       }
     }
@@ -239,3 +334,278 @@ void operation_rk(ternix Q, ternix R, struct paramstype *params)
 }
 
 
+void operation_rk_reduce(ternix Q, ternix R, int updated, double *acc,
+                         struct paramstype *params)
+/* The same stage as operation_rk, reducing while the values are in
+   registers rather than in a second pass. */
+{
+  int k, j, i;
+  double v, sum = 0, squares = 0, lo = acc[REDUCE_MIN], hi = acc[REDUCE_MAX];
+
+  for (k = 0; k < params->ELEMENT_SIZE; k++) {
+    for (j = 0; j < params->ELEMENT_SIZE; j++) {
+      for (i = 0; i < params->ELEMENT_SIZE; i++) {
+        Q->T[i][j][k] = ( R->T[i][j][k] * 0.5 +
+                          R->T[i][j][k] * 0.25 +
+                          Q->T[i][j][k] * 0.5 );
+        v = updated ? Q->T[i][j][k] : R->T[i][j][k];
+        sum += v;
+        squares += v * v;
+        if (v < lo) { lo = v; }
+        if (v > hi) { hi = v; }
+      }
+    }
+  }
+
+  acc[REDUCE_SUM] += sum;
+  acc[REDUCE_SQUARES] += squares;
+  acc[REDUCE_MIN] = lo;
+  acc[REDUCE_MAX] = hi;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------ Interleaved Operations ------------------------- */
+/* ------------------------------------------------------------------------- */
+
+long interleaved_values(struct paramstype *params)
+/* Size of W in values, for new_scratch_pool. */
+{
+  long N = params->ELEMENT_SIZE;
+  return W_ARRAYS * N * N * N * params->PHYSICAL_PARAMS;
+}
+
+void operation_conv_params(element Q, ternix *RX, const dtype *coef, dtype *W,
+                           struct paramstype *params)
+/* Pack Q's blocks into W and produce U. coef holds the three constants of
+   every block in turn. */
+{
+  int i, j, k, p, m, N = params->ELEMENT_SIZE, P = params->PHYSICAL_PARAMS;
+  long x, size = (long) N * N * N * P;
+  dtype *q = W + W_Q * size, *ur = W + W_UR * size, *us = W + W_US * size, *ut = W + W_UT * size;
+  dtype hx, hy, hz, rx[9];
+
+  /* The parameters of a point side by side. */
+  for (p = 0; p < P; p++) {
+    for (i = 0; i < N; i++) {
+      for (j = 0; j < N; j++) {
+        for (k = 0; k < N; k++) { q[((i * N + j) * N + k) * P + p] = Q->B[p]->T[i][j][k]; } } } }
+
+  /* RX once per point for all the parameters. */
+  for (i = 0; i < N; i++) {
+    for (j = 0; j < N; j++) {
+      for (k = 0; k < N; k++) {
+        x = ((i * N + j) * N + k) * P;
+        for (m = 0; m < 9; m++) { rx[m] = RX[m]->T[i][j][k]; }
+
+        for (p = 0; p < P; p++) {
+          hx = coef[3 * p + 0] * q[x + p];
+          hy = coef[3 * p + 1] * q[x + p];
+          hz = coef[3 * p + 2] * q[x + p];
+          ur[x + p] = rx[0] * hx + rx[1] * hy + rx[2] * hz;
+          us[x + p] = rx[3] * hx + rx[4] * hy + rx[5] * hz;
+          ut[x + p] = rx[6] * hx + rx[7] * hy + rx[8] * hz;
+        }
+      }
+    }
+  }
+}
+
+void operation_dr_params(matrix A, dtype *W, struct paramstype *params)
+/* Vr[i] = sum over g of A[i][g] Ur[g], each a whole j, k, param slab. */
+{
+  int i, g, N = params->ELEMENT_SIZE;
+  long m, slab = (long) N * N * params->PHYSICAL_PARAMS, size = N * slab;
+  dtype a, *u, *v, *ur = W + W_UR * size, *vr = W + W_VR * size;
+
+  for (i = 0; i < N; i++) {
+    v = vr + i * slab;
+    a = A->M[i][0];
+    for (m = 0; m < slab; m++) { v[m] = a * ur[m]; }
+    for (g = 1; g < N; g++) {
+      a = A->M[i][g];
+      u = ur + g * slab;
+      for (m = 0; m < slab; m++) { v[m] += a * u[m]; } } }
+}
+
+void operation_ds_params(matrix A, dtype *W, struct paramstype *params)
+/* Vs[i][j] = sum over g of A[j][g] Us[i][g], each a whole k, param row. */
+{
+  int i, j, g, N = params->ELEMENT_SIZE;
+  long m, row = (long) N * params->PHYSICAL_PARAMS, size = N * N * row;
+  dtype a, *u, *v, *us = W + W_US * size, *vs = W + W_VS * size;
+
+  for (i = 0; i < N; i++) {
+    for (j = 0; j < N; j++) {
+      v = vs + (i * N + j) * row;
+      a = A->M[j][0];
+      u = us + i * N * row;
+      for (m = 0; m < row; m++) { v[m] = a * u[m]; }
+      for (g = 1; g < N; g++) {
+        a = A->M[j][g];
+        u = us + (i * N + g) * row;
+        for (m = 0; m < row; m++) { v[m] += a * u[m]; } } } }
+}
+
+void operation_dt_params(matrix A, dtype *W, struct paramstype *params)
+/* Vt[i][j][k] = sum over g of A[k][g] Ut[i][j][g], over the params. */
+{
+  int i, j, k, g, p, N = params->ELEMENT_SIZE, P = params->PHYSICAL_PARAMS;
+  long size = (long) N * N * N * P;
+  dtype a, *u, *v, *ut = W + W_UT * size, *vt = W + W_VT * size;
+
+  for (i = 0; i < N; i++) {
+    for (j = 0; j < N; j++) {
+      for (k = 0; k < N; k++) {
+        v = vt + ((i * N + j) * N + k) * P;
+        a = A->M[k][0];
+        u = ut + (i * N + j) * N * P;
+        for (p = 0; p < P; p++) { v[p] = a * u[p]; }
+        for (g = 1; g < N; g++) {
+          a = A->M[k][g];
+          u = ut + ((i * N + j) * N + g) * P;
+          for (p = 0; p < P; p++) { v[p] += a * u[p]; } } } } }
+}
+
+void operation_sum_params(dtype *W, element R, struct paramstype *params)
+/* Add the three V of W into R's blocks. */
+{
+  int i, j, k, p, N = params->ELEMENT_SIZE, P = params->PHYSICAL_PARAMS;
+  long x, size = (long) N * N * N * P;
+  dtype *vr = W + W_VR * size, *vs = W + W_VS * size, *vt = W + W_VT * size;
+
+  for (p = 0; p < P; p++) {
+    for (i = 0; i < N; i++) {
+      for (j = 0; j < N; j++) {
+        for (k = 0; k < N; k++) {
+          x = ((i * N + j) * N + k) * P + p;
+          R->B[p]->T[i][j][k] = vr[x] + vs[x] + vt[x]; } } } }
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ---------------------------- Tiled Operations --------------------------- */
+/* ------------------------------------------------------------------------- */
+
+void operation_dr_tile(matrix A, ternix *B, ternix *C, int count, struct paramstype *params)
+/* C[t][i][j][k] = sum over g of A[i][g] B[t][g][j][k]: one A[i][g] for the
+   whole tile, contiguous rows of B and C underneath. */
+{
+  int t, k, j, i, g, N = params->ELEMENT_SIZE;
+  dtype a, *b, *c;
+
+  for (i = 0; i < N; i++) {
+    for (g = 0; g < N; g++) {
+      a = A->M[i][g];
+      for (t = 0; t < count; t++) {
+        for (j = 0; j < N; j++) {
+          b = B[t]->T[g][j];
+          c = C[t]->T[i][j];
+          if (g == 0) { for (k = 0; k < N; k++) { c[k] = a * b[k]; } }
+          else { for (k = 0; k < N; k++) { c[k] += a * b[k]; } } } } } }
+}
+
+void operation_ds_tile(matrix A, ternix *B, ternix *C, int count, struct paramstype *params)
+/* C[t][i][j][k] = sum over g of A[j][g] B[t][i][g][k], one row of C
+   accumulated from N rows of B. */
+{
+  int t, k, j, i, g, N = params->ELEMENT_SIZE;
+  dtype a, *b, *c;
+
+  for (t = 0; t < count; t++) {
+    for (i = 0; i < N; i++) {
+      for (j = 0; j < N; j++) {
+        c = C[t]->T[i][j];
+        a = A->M[j][0];
+        b = B[t]->T[i][0];
+        for (k = 0; k < N; k++) { c[k] = a * b[k]; }
+        for (g = 1; g < N; g++) {
+          a = A->M[j][g];
+          b = B[t]->T[i][g];
+          for (k = 0; k < N; k++) { c[k] += a * b[k]; } } } } }
+}
+
+void operation_dt_tile(matrix A, ternix *B, ternix *C, int count, struct paramstype *params)
+/* C[t][i][j][k] = sum over g of A[k][g] B[t][i][j][g]; the contraction runs
+   along the contiguous dimension, so each output is a dot product with a
+   row of A, which stays in L1 across the tile. */
+{
+  int t, k, j, i, g, N = params->ELEMENT_SIZE;
+  dtype s, *b, *c;
+
+  for (t = 0; t < count; t++) {
+    for (i = 0; i < N; i++) {
+      for (j = 0; j < N; j++) {
+        b = B[t]->T[i][j];
+        c = C[t]->T[i][j];
+        for (k = 0; k < N; k++) {
+          s = 0;
+          for (g = 0; g < N; g++) { s += A->M[k][g] * b[g]; }
+          c[k] = s; } } } }
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Work Model ------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+const char *kernel_names[KERNEL_COUNT] = { "conv", "dr", "ds", "dt", "sum", "rk" };
+
+double kernel_flops(int kernel, struct paramstype *params)
+/* FLOPs of one call of a kernel on one block. */
+{
+  double N = params->ELEMENT_SIZE, N3 = N * N * N;
+
+  switch (kernel) {
+  case KERNEL_CONV: return 18 * N3;        /* 3 scalings, 3 x (3 mul + 2 add) */
+  case KERNEL_DR:
+  case KERNEL_DS:
+  case KERNEL_DT:   return 2 * N3 * N;     /* N^3 outputs, N multiply-adds each */
+  case KERNEL_SUM:  return 2 * N3;
+  case KERNEL_RK:   return 5 * N3;         /* 3 mul + 2 add */
+  }
+  return 0;
+}
+
+double kernel_bytes(int kernel, struct paramstype *params)
+/* Bytes touched by one call of a kernel on one block. */
+{
+  double N = params->ELEMENT_SIZE, N3 = N * N * N;
+
+  switch (kernel) {
+  case KERNEL_CONV: return (1 + 9 + 3) * N3 * sizeof(dtype);          /* Q, RX, U out */
+  case KERNEL_DR:
+  case KERNEL_DS:
+  case KERNEL_DT:   return (2 * N3 + N * N) * sizeof(dtype);          /* read B, write C, kernel */
+  case KERNEL_SUM:  return 4 * N3 * sizeof(dtype);
+  case KERNEL_RK:   return 3 * N3 * sizeof(dtype);
+  }
+  return 0;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ---------------------------- Kernel Variants ---------------------------- */
+/* ------------------------------------------------------------------------- */
+
+const kernelset kernel_variants[] = {
+  { "reference", operation_conv, operation_dr, operation_ds, operation_dt,
+                 operation_sum, operation_rk, operation_rk_reduce,
+                 NULL, NULL, NULL, NULL, NULL },
+  { "interleaved", operation_conv, operation_dr, operation_ds, operation_dt,
+                 operation_sum, operation_rk, operation_rk_reduce,
+                 operation_conv_params, operation_dr_params, operation_ds_params,
+                 operation_dt_params, operation_sum_params },
+};
+
+const int kernel_variant_count = sizeof(kernel_variants) / sizeof(kernel_variants[0]);
+
+const kernelset *find_kernels(const char *name)
+/* Look up a variant by name, NULL if there is none. */
+{
+  int i;
+  for (i = 0; i < kernel_variant_count; i++) {
+    if (strcmp(kernel_variants[i].name, name) == 0) { return &kernel_variants[i]; }
+  }
+  return NULL;
+}
@@ -28,7 +28,6 @@ Original:
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
-#include <mpi.h>
 
 #include "dstructs.h"
 
@@ -43,15 +42,37 @@ Original:
      sign:  {-1, 1}    |  Minus or Plus Face
 
    The resulting vector output is of size: PHYSICAL_PARAMS * FACE_SIZE
-   multiplied by the number of elements on the face of interest. */
-vector new_extracted_faces(element *elements, int axis, int sign, struct paramstype *params);
+   multiplied by the number of elements on the face of interest. Those are
+   the first ones of the original layout; layout gives where each of them
+   is stored (order.h), NULL if the elements are stored in that layout. */
+vector new_extracted_faces(element *elements, const int *layout, int axis, int sign,
+                           struct paramstype *params);
 
 /* Same as above, but intended for the recv side, so not initialized. */
 vector new_empty_faces(int axis, struct paramstype *params);
 
+/* After unpack_faces on axis touched, bring faces (extracted earlier with
+   this axis and sign) up to date: only the edge lines the two axes share
+   are re-read. Lets the next axis be packed while the previous one is
+   still in flight. */
+void refresh_faces(element *elements, const int *layout, vector faces, int axis, int sign,
+                   int touched, struct paramstype *params);
+
+/* Fold a neighbor's faces (as produced by new_extracted_faces on the other
+   side) into the matching face planes of our elements. This is the faked
+   flux: the boundary plane becomes the average of both sides. Does nothing
+   unless FOLD_FACES is set: the original mini-app received the faces and
+   dropped them. */
+void unpack_faces(element *elements, const int *layout, vector faces, int axis, int sign,
+                  struct paramstype *params);
+
 
 /* ------------------------ Faked CMT-Nek Operations ----------------------- */
 
+/* The operations write every value of their outputs without reading them
+   first, so outputs (like the caller's scratch, see new_scratch_pool) need
+   no zeroing between calls. */
+
 /* Perform the R axis derivative operation, with kernel A and result C. */
 void operation_dr(matrix A, ternix B, ternix C, struct paramstype *params);
 
@@ -61,10 +82,11 @@ void operation_ds(matrix A, ternix B, ternix C, struct paramstype *params);
 /* Perform the T axis derivative operation, with kernel A and result C. */
 void operation_dt(matrix A, ternix B, ternix C, struct paramstype *params);
 
-/* Given Q, produce UR, US, and UT by faked transformation. HX, HY, and HZ
-   are temporary space. RX is the list of transformation ternices. */
-void operation_conv(ternix Q, ternix *RX, ternix Hx, ternix Hy, ternix Hz,
-                    ternix Ur, ternix Us, ternix Ut, struct paramstype *params);
+/* Given Q, produce UR, US, and UT by faked transformation. RX is the list
+   of transformation ternices and coef the three scaling constants (the
+   caller draws them, see rng.h). */
+void operation_conv(ternix Q, ternix *RX, const dtype *coef, ternix Ur, ternix Us, ternix Ut,
+                    struct paramstype *params);
 
 /* Add three ternices together and put the result in R. */
 void operation_sum(ternix X, ternix Y, ternix Z, ternix R, struct paramstype *params);
@@ -72,4 +94,105 @@ void operation_sum(ternix X, ternix Y, ternix Z, ternix R, struct paramstype *pa
 /* Perform a faked Runge Kutta stage (no previous stage information used). */
 void operation_rk(ternix Q, ternix R, struct paramstype *params);
 
+/* Statistics operation_rk_reduce adds to, per block. */
+enum { REDUCE_SUM, REDUCE_SQUARES, REDUCE_MIN, REDUCE_MAX, REDUCE_COUNT };
+
+/* operation_rk, with the sum, sum of squares, min and max of the updated Q
+   (updated nonzero) or of R folded into acc[REDUCE_COUNT] in the same
+   sweep. */
+void operation_rk_reduce(ternix Q, ternix R, int updated, double *acc,
+                         struct paramstype *params);
+
+
+/* ------------------------ Interleaved Operations ------------------------- */
+
+/* Whole-element versions of conv, dr, ds, dt and sum. They work in W, which
+   holds seven arrays of ELEMENT_SIZE^3 x PHYSICAL_PARAMS values (Q, Ur, Us,
+   Ut, Vr, Vs and Vt) with the parameters of a point side by side,
+   [i][j][k][param]. Each value of RX and of the derivative matrix is
+   loaded once per element instead of once per block, and the innermost
+   loops run over the parameters or over whole rows of them, which map onto
+   SIMD lanes. Results equal the per-block operations'. */
+
+/* The seven arrays of W, each ELEMENT_SIZE^3 x PHYSICAL_PARAMS long. */
+enum { W_Q, W_UR, W_US, W_UT, W_VR, W_VS, W_VT, W_ARRAYS };
+
+/* Size of W in values, to give new_scratch_pool (dstructs.h). */
+long interleaved_values(struct paramstype *params);
+
+/* Pack Q's blocks into W and produce U. coef holds the three constants of
+   every block in turn. */
+void operation_conv_params(element Q, ternix *RX, const dtype *coef, dtype *W,
+                           struct paramstype *params);
+void operation_dr_params(matrix A, dtype *W, struct paramstype *params);
+void operation_ds_params(matrix A, dtype *W, struct paramstype *params);
+void operation_dt_params(matrix A, dtype *W, struct paramstype *params);
+
+/* Add the three V of W into R's blocks. */
+void operation_sum_params(dtype *W, element R, struct paramstype *params);
+
+
+/* ---------------------------- Tiled Operations --------------------------- */
+
+/* operation_dr, ds and dt on count blocks at once, B[t] into C[t]. A stays
+   in L1 while the tile streams past it, the innermost loops run along
+   contiguous rows, and every output is summed in the same order as in the
+   per-block operations, so the results are identical. */
+void operation_dr_tile(matrix A, ternix *B, ternix *C, int count, struct paramstype *params);
+void operation_ds_tile(matrix A, ternix *B, ternix *C, int count, struct paramstype *params);
+void operation_dt_tile(matrix A, ternix *B, ternix *C, int count, struct paramstype *params);
+
+
+/* ------------------------------ Work Model ------------------------------- */
+
+/* Kernel ids, in the order they appear in a kernelset. */
+enum {
+  KERNEL_CONV, KERNEL_DR, KERNEL_DS, KERNEL_DT, KERNEL_SUM, KERNEL_RK,
+  KERNEL_COUNT
+};
+
+extern const char *kernel_names[KERNEL_COUNT];
+
+/* Analytic FLOPs and bytes of one call of a kernel on one block, as
+   functions of ELEMENT_SIZE. Bytes count every operand the kernel reads or
+   writes once, i.e. no reuse across calls is assumed. */
+double kernel_flops(int kernel, struct paramstype *params);
+double kernel_bytes(int kernel, struct paramstype *params);
+
+
+/* ---------------------------- Kernel Variants ---------------------------- */
+
+/* One complete implementation of the per-block operations above. Every
+   variant must produce the reference results (up to rounding) for the same
+   inputs, so they can be swapped at runtime and compared by the bench.
+   A variant may also run Compute (A) a whole element at a time (the
+   *_params members, NULL otherwise); its per-block members then serve
+   Compute (B), and the bench compares both with the reference. */
+typedef struct {
+  const char *name;
+  void (*conv)(ternix Q, ternix *RX, const dtype *coef, ternix Ur, ternix Us, ternix Ut,
+               struct paramstype *params);
+  void (*dr)(matrix A, ternix B, ternix C, struct paramstype *params);
+  void (*ds)(matrix A, ternix B, ternix C, struct paramstype *params);
+  void (*dt)(matrix A, ternix B, ternix C, struct paramstype *params);
+  void (*sum)(ternix X, ternix Y, ternix Z, ternix R, struct paramstype *params);
+  void (*rk)(ternix Q, ternix R, struct paramstype *params);
+  void (*rk_reduce)(ternix Q, ternix R, int updated, double *acc, struct paramstype *params);
+  void (*conv_params)(element Q, ternix *RX, const dtype *coef, dtype *W, struct paramstype *params);
+  void (*dr_params)(matrix A, dtype *W, struct paramstype *params);
+  void (*ds_params)(matrix A, dtype *W, struct paramstype *params);
+  void (*dt_params)(matrix A, dtype *W, struct paramstype *params);
+  void (*sum_params)(dtype *W, element R, struct paramstype *params);
+} kernelset;
+
+/* All variants; entry 0 is the reference implementation:
+
+     reference    |  the original per-block loops
+     interleaved  |  whole elements, parameters interleaved (see above) */
+extern const kernelset kernel_variants[];
+extern const int kernel_variant_count;
+
+/* Look up a variant by name, NULL if there is none. */
+const kernelset *find_kernels(const char *name);
+
 #endif
@@ -0,0 +1,432 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "ghosts.h"
+#include "params.h"
+#include "dstructs.h"
+#include "flux.h"
+#include "halo.h"
+#include "order.h"
+#include "timers.h"
+#include "utils.h"
+
+#define GHOST_CALIBRATION_REPS 10
+#define GHOST_SWEEP 64
+
+/* Our own elements (copy 0) or one rank's face elements. */
+typedef struct {
+  int rank, ring;
+  int offset[CARTESIAN_DIMENSIONS];
+  element *Q, *R;             // original order, NULL for copy 0
+} ghostcopy;
+
+typedef struct {
+  struct paramstype *params;
+  MPI_Comm cart, comm;        // comm: graph of the ranks within the depth
+  int depth, F, faces[CARTESIAN_DIMENSIONS];
+  const int *layout;
+  int copies;                 // ours first, then ring by ring
+  ghostcopy *copy;
+  int *pairs[CARTESIAN_DIMENSIONS];   // (lower, upper, ring) per neighboring pair
+  int npairs[CARTESIAN_DIMENSIONS];
+  int sides[CARTESIAN_DIMENSIONS];    // our face neighbors per axis
+  int count;                  // ghost elements
+  ghostelement *ghost;
+  int *upto;                  // ghosts at most ring steps away, per ring
+  int record;                 // values each rank sends per ghost exchange
+  dtype *send, *recv;
+  long sent, received;        // their sizes in bytes
+  MPI_Request request;
+  long *folded;               // stages run, per stage of the window
+  double latency, full;       // one ghost exchange of one value and of record
+} ghoststype;
+
+static ghoststype G;
+
+
+/* ------------------------------------------------------------------------- */
+/* ---------------------------------- Setup -------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static double time_exchange(int count)
+/* Seconds per ghost exchange of count values on the slowest rank. */
+{
+  int r;
+  double mine, slowest;
+  struct timespec t0;
+
+  MPI_Barrier(G.cart);
+  t0 = now();
+  for (r = 0; r < GHOST_CALIBRATION_REPS; r++) {
+    MPI_Neighbor_allgather(G.send, count, MPI_DTYPE, G.recv, count, MPI_DTYPE, G.comm);
+  }
+  mine = tdiff(t0, now()) / GHOST_CALIBRATION_REPS;
+  MPI_Allreduce(&mine, &slowest, 1, MPI_DOUBLE, MPI_MAX, G.cart);
+  return slowest;
+}
+
+void setup_ghosts(MPI_Comm cart_comm, struct paramstype *params)
+{
+  int a, c, i, n = 0, ring, s = params->GHOST_DEPTH, side = 2 * s + 1;
+  int dims[CARTESIAN_DIMENSIONS], periods[CARTESIAN_DIMENSIONS], coords[CARTESIAN_DIMENSIONS];
+  int at[CARTESIAN_DIMENSIONS], d[CARTESIAN_DIMENSIONS];
+  int *slot = malloc(sizeof(int) * side * side * side), *neighbors, *weights;
+
+  memset(&G, 0, sizeof(G));
+  G.params = params;
+  G.cart = cart_comm;
+  G.depth = s;
+  G.layout = layout_table();
+  G.faces[0] = params->ELEMENTS_ON_X_FACE;
+  G.faces[1] = params->ELEMENTS_ON_Y_FACE;
+  G.faces[2] = params->ELEMENTS_ON_Z_FACE;
+  for (a = 0; a < CARTESIAN_DIMENSIONS; a++) {
+    if (G.faces[a] > G.F) { G.F = G.faces[a]; }
+  }
+
+  /* Every rank within s steps (Chebyshev distance), nearest first. */
+  MPI_Cart_get(cart_comm, CARTESIAN_DIMENSIONS, dims, periods, coords);
+  G.copy = malloc(sizeof(ghostcopy) * side * side * side);
+  for (i = 0; i < side * side * side; i++) { slot[i] = -1; }
+
+  for (ring = 0; ring <= s; ring++) {
+    for (d[2] = -ring; d[2] <= ring; d[2]++) {
+      for (d[1] = -ring; d[1] <= ring; d[1]++) {
+        for (d[0] = -ring; d[0] <= ring; d[0]++) {
+          int far = 0, inside = 1;
+          for (a = 0; a < CARTESIAN_DIMENSIONS; a++) {
+            if (abs(d[a]) > far) { far = abs(d[a]); }
+            at[a] = coords[a] + d[a];
+            if (at[a] < 0 || at[a] >= dims[a]) { inside = 0; }
+          }
+          if (far != ring || !inside) { continue; }
+
+          ghostcopy *C = &G.copy[n];
+          MPI_Cart_rank(cart_comm, at, &C->rank);
+          C->ring = ring;
+          memcpy(C->offset, d, sizeof(d));
+          C->Q = C->R = NULL;
+          slot[(d[0] + s) + side * ((d[1] + s) + side * (d[2] + s))] = n++;
+        }
+      }
+    }
+  }
+  G.copies = n;
+
+  /* Neighboring copies along each axis, and how far out the pair lies. */
+  for (a = 0; a < CARTESIAN_DIMENSIONS; a++) {
+    G.pairs[a] = malloc(sizeof(int) * 3 * n);
+    for (c = 0; c < n; c++) {
+      int j;
+      memcpy(d, G.copy[c].offset, sizeof(d));
+      if (++d[a] > s) { continue; }
+      j = slot[(d[0] + s) + side * ((d[1] + s) + side * (d[2] + s))];
+      if (j < 0) { continue; }
+      G.pairs[a][3 * G.npairs[a] + 0] = c;
+      G.pairs[a][3 * G.npairs[a] + 1] = j;
+      G.pairs[a][3 * G.npairs[a] + 2] = G.copy[c].ring > G.copy[j].ring ? G.copy[c].ring : G.copy[j].ring;
+      G.npairs[a]++;
+      if (c == 0 || j == 0) { G.sides[a]++; }
+    }
+  }
+  free(slot);
+
+  /* The copies themselves. */
+  G.count = (n - 1) * G.F;
+  G.ghost = malloc(sizeof(ghostelement) * (G.count > 0 ? G.count : 1));
+  G.upto = calloc(s + 1, sizeof(int));
+  for (c = 1; c < n; c++) {
+    G.copy[c].Q = malloc(sizeof(element) * G.F);
+    G.copy[c].R = malloc(sizeof(element) * G.F);
+  }
+
+  int previous = memory_category(MEMORY_GHOSTS);
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < G.count; i++) {
+    ghostcopy *C = &G.copy[1 + i / G.F];
+    C->Q[i % G.F] = new_zero_element(params);
+    C->R[i % G.F] = new_zero_element(params);
+  }
+  memory_category(previous);
+
+  for (i = 0; i < G.count; i++) {
+    ghostcopy *C = &G.copy[1 + i / G.F];
+    G.ghost[i].Q = C->Q[i % G.F];
+    G.ghost[i].R = C->R[i % G.F];
+    G.ghost[i].key = C->rank * params->ELEMENTS_PER_PROCESS + i % G.F;
+    G.ghost[i].ring = C->ring;
+  }
+  for (ring = 0; ring <= s; ring++) {
+    for (i = 0; i < G.count; i++) { G.upto[ring] += (G.ghost[i].ring <= ring); }
+  }
+  G.folded = calloc(s, sizeof(long));
+
+  /* The ghost exchange is a neighborhood allgather on a symmetric graph. */
+  neighbors = malloc(sizeof(int) * 2 * (n > 1 ? n - 1 : 1));
+  weights = neighbors + (n > 1 ? n - 1 : 1);
+  for (c = 1; c < n; c++) {
+    neighbors[c - 1] = G.copy[c].rank;
+    weights[c - 1] = 1;
+  }
+  MPI_Dist_graph_create_adjacent(cart_comm, n - 1, neighbors, weights, n - 1, neighbors,
+                                 weights, MPI_INFO_NULL, 0, &G.comm);
+  free(neighbors);
+
+  G.record = G.F * params->PHYSICAL_PARAMS * params->ELEMENT_SIZE * params->ELEMENT_SIZE *
+             params->ELEMENT_SIZE;
+  G.sent = sizeof(dtype) * (G.record > 0 ? G.record : 1);
+  G.received = sizeof(dtype) * ((long) G.record * (n > 1 ? n - 1 : 1) + 1);
+  G.send = calloc(G.sent / sizeof(dtype), sizeof(dtype));
+  G.recv = calloc(G.received / sizeof(dtype), sizeof(dtype));
+  memory_track(MEMORY_GHOSTS, G.sent, 1);
+  memory_track(MEMORY_GHOSTS, G.received, 1);
+
+  G.latency = time_exchange(1);
+  G.full = time_exchange(G.record);
+}
+
+void delete_ghosts(void)
+{
+  int a, c, e;
+
+  for (c = 1; c < G.copies; c++) {
+    for (e = 0; e < G.F; e++) {
+      delete_element(G.copy[c].Q[e], G.params);
+      delete_element(G.copy[c].R[e], G.params);
+    }
+    free(G.copy[c].Q);
+    free(G.copy[c].R);
+  }
+  for (a = 0; a < CARTESIAN_DIMENSIONS; a++) { free(G.pairs[a]); }
+  free(G.copy);
+  free(G.ghost);
+  free(G.upto);
+  free(G.folded);
+  memory_track(MEMORY_GHOSTS, G.sent, -1);
+  memory_track(MEMORY_GHOSTS, G.received, -1);
+  free(G.send);
+  free(G.recv);
+  MPI_Comm_free(&G.comm);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ---------------------------- Ghost Exchange ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+void start_ghost_exchange(element *Q)
+/* Records are whole face elements in original order, row by row. */
+{
+  int e, b, row, col, N = G.params->ELEMENT_SIZE;
+  dtype *p = G.send;
+  regionmark m;
+
+  region_begin(&m);
+  for (e = 0; e < G.F; e++) {
+    element E = Q[G.layout ? G.layout[e] : e];
+    for (b = 0; b < G.params->PHYSICAL_PARAMS; b++) {
+      for (row = 0; row < N; row++) {
+        for (col = 0; col < N; col++) {
+          memcpy(p, E->B[b]->T[row][col], sizeof(dtype) * N);
+          p += N;
+        }
+      }
+    }
+  }
+  region_end(REGION_PACK, &m);
+
+  region_begin(&m);
+  MPI_Ineighbor_allgather(G.send, G.record, MPI_DTYPE, G.recv, G.record, MPI_DTYPE, G.comm,
+                          &G.request);
+  region_end(REGION_SEND, &m);
+}
+
+void finish_ghost_exchange(void)
+/* The i-th source of the graph is copy i + 1. */
+{
+  int i;
+  regionmark m;
+
+  region_begin(&m);
+  MPI_Wait(&G.request, MPI_STATUS_IGNORE);
+  region_end(REGION_RECV, &m);
+
+  region_begin(&m);
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < G.count; i++) {
+    int b, row, col, N = G.params->ELEMENT_SIZE;
+    const dtype *p = G.recv + (size_t) i * (G.record / (G.F > 0 ? G.F : 1));
+    for (b = 0; b < G.params->PHYSICAL_PARAMS; b++) {
+      for (row = 0; row < N; row++) {
+        for (col = 0; col < N; col++) {
+          memcpy(G.ghost[i].Q->B[b]->T[row][col], p, sizeof(dtype) * N);
+          p += N;
+        }
+      }
+    }
+  }
+  region_end(REGION_UNPACK, &m);
+}
+
+const ghostelement *ghost_elements(void)
+{
+  return G.ghost;
+}
+
+int ghost_count(int ring)
+{
+  if (ring < 0) { return 0; }
+  return G.upto[ring > G.depth ? G.depth : ring];
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------- Local Fold ------------------------------ */
+/* ------------------------------------------------------------------------- */
+
+static element copy_element(int c, int e, element *R)
+{
+  if (c == 0) { return R[G.layout ? G.layout[e] : e]; }
+  return G.copy[c].R[e];
+}
+
+void fold_ghost_faces(element *R, int k)
+/* Both sides of every pair get the mean, as each would from unpack_faces.
+   Within an axis every plane belongs to one pair only. Without FOLD_FACES
+   only the stage is counted. */
+{
+  int a, p, N = G.params->ELEMENT_SIZE;
+  regionmark m;
+
+  region_begin(&m);
+  G.folded[k]++;
+  if (!G.params->FOLD_FACES) {
+    region_end(REGION_UNPACK, &m);
+    return;
+  }
+  for (a = 0; a < CARTESIAN_DIMENSIONS; a++) {
+
+    #pragma omp parallel for schedule(static)
+    for (p = 0; p < G.npairs[a]; p++) {
+      const int *pair = &G.pairs[a][3 * p];
+      int e, b, u, v;
+      if (pair[2] > G.depth - k) { continue; }
+
+      for (e = 0; e < G.faces[a]; e++) {
+        element lower = copy_element(pair[0], e, R), upper = copy_element(pair[1], e, R);
+        for (b = 0; b < G.params->PHYSICAL_PARAMS; b++) {
+          dtype ***X = lower->B[b]->T, ***Y = upper->B[b]->T, *x, *y;
+          for (u = 0; u < N; u++) {
+            for (v = 0; v < N; v++) {
+              if (a == 0) { x = &X[N - 1][u][v]; y = &Y[0][u][v]; }
+              else if (a == 1) { x = &X[u][N - 1][v]; y = &Y[u][0][v]; }
+              else { x = &X[u][v][N - 1]; y = &Y[u][v][0]; }
+              *x = *y = 0.5 * (*x + *y);
+            }
+          }
+        }
+      }
+    }
+  }
+  region_end(REGION_UNPACK, &m);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* -------------------------------- Crossover ------------------------------ */
+/* ------------------------------------------------------------------------- */
+
+static double redundant_flops(struct paramstype *P, const long *stages)
+/* FLOPs of the ghosts' Compute (A) and (B) over the given stage counts. */
+{
+  int k, kernel;
+  double A = 0, B = kernel_flops(KERNEL_RK, P), flops = 0;
+
+  for (kernel = 0; kernel < KERNEL_COUNT; kernel++) {
+    if (kernel != KERNEL_RK) { A += kernel_flops(kernel, P); }
+  }
+  for (k = 0; k < G.depth; k++) {
+    flops += stages[k] * P->PHYSICAL_PARAMS *
+             (ghost_count(G.depth - k) * A + ghost_count(G.depth - k - 1) * B);
+  }
+  return flops;
+}
+
+void report_ghosts(double seconds, MPI_Comm cart_comm, struct paramstype *params)
+/* Per window of s stages, the ordinary exchange synchronizes 3s times
+   (the axes go in order) and the ghost exchange once. With per-message
+   latency L and the bandwidth measured above, the ghosts win when
+     3s L + s face bytes / bw  >  L + ghost bytes / bw + redundant time,
+   the redundant time at the FLOP rate this run achieved on the ghosts. */
+{
+  int rank, a, i, n, sizes[GHOST_SWEEP], s = G.depth;
+  long *once = malloc(sizeof(long) * s);
+  double bytes, bandwidth, rate;
+  struct paramstype P;
+
+  MPI_Comm_rank(cart_comm, &rank);
+  if (rank != params->PROBED_RANK) { free(once); return; }
+
+  for (i = 0; i < s; i++) { once[i] = 1; }
+  bytes = (double) (G.copies - 1) * G.record * sizeof(dtype);
+  bandwidth = G.full > G.latency ? bytes / (G.full - G.latency) : 0;
+  rate = seconds > 0 ? redundant_flops(params, G.folded) / seconds : 0;
+
+  printf("Ghosts: depth %d, %d ranks within it, %d ghost elements; one exchange every %d stages.\n",
+         s, G.copies - 1, G.count, s);
+  printf("Ghost exchange: %.3f us for one value, %.3f us for %.0f bytes (%.3f GB/s); "
+         "redundant work at %.3f GFLOP/s.\n",
+         G.latency * 1E6, G.full * 1E6, bytes, bandwidth / 1E9, rate / 1E9);
+
+  if (G.copies == 1 || bandwidth <= 0 || rate <= 0) {
+    printf("Ghosts: nothing measured to trade, no crossover.\n");
+    free(once);
+    return;
+  }
+
+  printf("ghosts,N,face_bytes_per_window,ghost_bytes_per_window,redundant_gflop_per_window,"
+         "redundant_us_per_window,crossover_latency_us\n");
+  n = parse_sweep(params->HALO_SIZES, sizes, GHOST_SWEEP);
+  for (i = 0; i < n; i++) {
+    double face = 0, ghost, flops, redundant, crossover;
+    P = *params;
+    P.ELEMENT_SIZE = sizes[i];
+    for (a = 0; a < CARTESIAN_DIMENSIONS; a++) {
+      face += (double) G.sides[a] * G.faces[a] * P.PHYSICAL_PARAMS * P.ELEMENT_SIZE * P.ELEMENT_SIZE;
+    }
+    face *= s * sizeof(dtype);
+    ghost = (double) (G.copies - 1) * G.F * P.PHYSICAL_PARAMS * P.ELEMENT_SIZE * P.ELEMENT_SIZE *
+            P.ELEMENT_SIZE * sizeof(dtype);
+    flops = redundant_flops(&P, once);
+    redundant = flops / rate;
+    crossover = (redundant + (ghost - face) / bandwidth) / (3 * s - 1);
+    printf("ghosts,%d,%.0f,%.0f,%.6f,%.3f,%.3f\n", sizes[i], face, ghost, flops / 1E9,
+           redundant * 1E6, crossover > 0 ? crossover * 1E6 : 0.0);
+  }
+  free(once);
+}
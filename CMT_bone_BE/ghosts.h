@@ -0,0 +1,85 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GHOSTS_H_
+#define GHOSTS_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+#include "dstructs.h"
+
+
+/* ------------------------ Communication-avoiding Mode -------------------- */
+
+/* With params->GHOST_DEPTH s > 0 the per-stage face exchange is replaced by
+   one exchange of whole elements every s stages. Each rank then holds a
+   copy of the face elements (those new_extracted_faces moves) of every
+   rank within s steps in the cartesian grid, diagonals included: the edge
+   lines make a stage depend on them too. Within the window every rank
+   recomputes its copies redundantly and folds the faces between all of
+   them locally, in the exchange's axis order. Copies r steps away are
+   only needed for the first s - r stages of the window, so the redundant
+   work shrinks stage by stage, and our own elements come out exactly as
+   with an exchange every stage. */
+
+/* A neighbor's element held redundantly, ring steps away. key is its data
+   key (balance.h), so its stage constants are the owner's. */
+typedef struct {
+  element Q, R;
+  int key;
+  int ring;
+} ghostelement;
+
+/* Find the ranks within GHOST_DEPTH, allocate their copies and time one
+   ghost exchange. Collective on cart_comm. */
+void setup_ghosts(MPI_Comm cart_comm, struct paramstype *params);
+
+void delete_ghosts(void);
+
+/* At the first stage of a window: send our face elements of Q (stored in
+   the element ordering's layout) to every rank within the depth, and
+   receive theirs. finish_ghost_exchange completes it. */
+void start_ghost_exchange(element *Q);
+void finish_ghost_exchange(void);
+
+/* All copies, nearest rings first; the first ghost_count(ring) are the
+   ones at most ring steps away. Stage k of the window (0 <= k < depth)
+   needs Compute (A) of ghost_count(depth - k) and Compute (B) of
+   ghost_count(depth - k - 1) of them. */
+const ghostelement *ghost_elements(void);
+int ghost_count(int ring);
+
+/* The exchange of stage k of the window, between our elements R and the
+   copies still needed. */
+void fold_ghost_faces(element *R, int k);
+
+/* Print, on the probed rank, the measured cost of the redundant work
+   (seconds, this rank's total) and of a ghost exchange, and the network
+   latency above which exchanging every depth stages beats exchanging
+   every stage, for each ELEMENT_SIZE of HALO_SIZES. */
+void report_ghosts(double seconds, MPI_Comm cart_comm, struct paramstype *params);
+
+#endif
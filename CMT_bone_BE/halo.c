@@ -0,0 +1,668 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "halo.h"
+#include "params.h"
+#include "dstructs.h"
+#include "flux.h"
+#include "timers.h"
+#include "utils.h"
+#include "rng.h"
+
+
+/* ------------------------------------------------------------------------- */
+/* --------------------------- Exchange Backends --------------------------- */
+/* ------------------------------------------------------------------------- */
+
+/* Told about every face set a backend folds in (set_unpack_hook). */
+static void (*unpack_hook)(int axis, int sign) = NULL;
+
+void set_unpack_hook(void (*hook)(int axis, int sign))
+{
+  unpack_hook = hook;
+}
+
+static void fold_faces(element *elements, const int *layout, vector faces, int axis, int sign,
+                       struct paramstype *params)
+/* unpack_faces, then tell the hook. */
+{
+  unpack_faces(elements, layout, faces, axis, sign, params);
+  if (unpack_hook != NULL) { unpack_hook(axis, sign); }
+}
+
+static void exchange_blocking(element *elements, const int *layout, MPI_Comm cart_comm,
+                              struct paramstype *params)
+/* The original exchange: blocking sends and receives, ordered by the parity
+   of our index on each axis so that neighbors never both send first. */
+{
+  int rank, axis;
+
+  /* above: plus neighbor, below: minus neighbor, index along this axis */
+  int above, below, index;
+
+  /* Unused status flag */
+  MPI_Status status;
+
+  /* Cartesian coordinates */
+  int coords[CARTESIAN_DIMENSIONS];
+
+  /* Determine our location in the cartesian grid. */
+  MPI_Comm_rank(cart_comm, &rank);
+  MPI_Cart_coords(cart_comm, rank, CARTESIAN_DIMENSIONS, coords);
+
+  vector above_faces_to_send, above_faces_to_recv;
+  vector below_faces_to_send, below_faces_to_recv;
+
+  /* Region marker for pack/send/recv/unpack */
+  regionmark m;
+
+  for ( axis = 0; axis < CARTESIAN_DIMENSIONS; axis++ ) {
+
+    /* Find our index along this axis. */
+    index = coords[axis];
+
+    /* Determine our neighbors. */
+    MPI_Cart_shift(cart_comm, axis, 1, &below, &above);
+
+    /* --------------------------- Transfers --------------------------- */
+
+    /* Significant operations are given a heading, everything else is just
+       instrumentation and logging. */
+
+    /* ------------------------ Even Axis Index ------------------------ */
+
+    if ( (index % 2) == 0 ) {
+
+      /* If my index on this axis is even:
+         - SEND  faces to    ABOVE  neighbor  (23)
+         - RECV  faces from  ABOVE  neighbor  (47)
+         - SEND  faces to    BELOW  neighbor  (61)
+         - RECV  faces from  BELOW  neighbor  (73) */
+
+      if ( above != MPI_PROC_NULL ) {
+
+        /* - - - - - - - - - - - - Prepare Faces - - - - - - - - - - - - */
+        region_begin(&m);
+        above_faces_to_send = new_extracted_faces(elements, layout, axis, 1, params);
+        above_faces_to_recv = new_empty_faces(axis, params);
+        region_end(REGION_PACK, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - - Send Above  - - - - - - - - - - - - */
+        region_begin(&m);
+        MPI_Send( above_faces_to_send->V, above_faces_to_send->size,
+                  MPI_DTYPE, above, 23, cart_comm );
+        region_end(REGION_SEND, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - - Recv Above  - - - - - - - - - - - - */
+        region_begin(&m);
+        MPI_Recv( above_faces_to_recv->V, above_faces_to_recv->size,
+                  MPI_DTYPE, above, 47, cart_comm, &status );
+        region_end(REGION_RECV, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - Unpack Faces  - - - - - - - - - - - - */
+        region_begin(&m);
+        fold_faces(elements, layout, above_faces_to_recv, axis, 1, params);
+        region_end(REGION_UNPACK, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - Cleanup Faces - - - - - - - - - - - - */
+        delete_vector(above_faces_to_send);
+        delete_vector(above_faces_to_recv);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+      }
+
+      if ( below != MPI_PROC_NULL ) {
+
+        /* - - - - - - - - - - - - Prepare Faces - - - - - - - - - - - - */
+        region_begin(&m);
+        below_faces_to_send = new_extracted_faces(elements, layout, axis, -1, params);
+        below_faces_to_recv = new_empty_faces(axis, params);
+        region_end(REGION_PACK, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - - Send Below  - - - - - - - - - - - - */
+        region_begin(&m);
+        MPI_Send( below_faces_to_send->V, below_faces_to_send->size,
+                  MPI_DTYPE, below, 61, cart_comm );
+        region_end(REGION_SEND, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - - Recv Below  - - - - - - - - - - - - */
+        region_begin(&m);
+        MPI_Recv( below_faces_to_recv->V, below_faces_to_recv->size,
+                  MPI_DTYPE, below, 73, cart_comm, &status );
+        region_end(REGION_RECV, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - Unpack Faces  - - - - - - - - - - - - */
+        region_begin(&m);
+        fold_faces(elements, layout, below_faces_to_recv, axis, -1, params);
+        region_end(REGION_UNPACK, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - Cleanup Faces - - - - - - - - - - - - */
+        delete_vector(below_faces_to_send);
+        delete_vector(below_faces_to_recv);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+      }
+    }
+
+    /* ------------------------- Odd Axis Index ------------------------ */
+
+    else {
+
+      /* If my index on this axis is odd:
+         - RECV  faces from  BELOW  neighbor  (23)
+         - SEND  faces from  BELOW  neighbor  (47)
+         - RECV  faces to    ABOVE  neighbor  (61)
+         - SEND  faces from  ABOVE  neighbor  (73) */
+
+      if ( below != MPI_PROC_NULL ) {
+
+        /* - - - - - - - - - - - - Prepare Faces - - - - - - - - - - - - */
+        region_begin(&m);
+        below_faces_to_send = new_extracted_faces(elements, layout, axis, -1, params);
+        below_faces_to_recv = new_empty_faces(axis, params);
+        region_end(REGION_PACK, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - - Recv Below  - - - - - - - - - - - - */
+        region_begin(&m);
+        MPI_Recv( below_faces_to_recv->V, below_faces_to_recv->size,
+                  MPI_DTYPE, below, 23, cart_comm, &status );
+        region_end(REGION_RECV, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - - Send Below  - - - - - - - - - - - - */
+        region_begin(&m);
+        MPI_Send( below_faces_to_send->V, below_faces_to_send->size,
+                  MPI_DTYPE, below, 47, cart_comm );
+        region_end(REGION_SEND, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - Unpack Faces  - - - - - - - - - - - - */
+        region_begin(&m);
+        fold_faces(elements, layout, below_faces_to_recv, axis, -1, params);
+        region_end(REGION_UNPACK, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - Cleanup Faces - - - - - - - - - - - - */
+        delete_vector(below_faces_to_send);
+        delete_vector(below_faces_to_recv);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+      }
+
+      if ( above != MPI_PROC_NULL ) {
+
+        /* - - - - - - - - - - - - Prepare Faces - - - - - - - - - - - - */
+        region_begin(&m);
+        above_faces_to_send = new_extracted_faces(elements, layout, axis, 1, params);
+        above_faces_to_recv = new_empty_faces(axis, params);
+        region_end(REGION_PACK, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - - Recv Above  - - - - - - - - - - - - */
+        region_begin(&m);
+        MPI_Recv( above_faces_to_recv->V, above_faces_to_recv->size,
+                  MPI_DTYPE, above, 61, cart_comm, &status );
+        region_end(REGION_RECV, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - - Send Above  - - - - - - - - - - - - */
+        region_begin(&m);
+        MPI_Send( above_faces_to_send->V, above_faces_to_send->size,
+                  MPI_DTYPE, above, 73, cart_comm );
+        region_end(REGION_SEND, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - Unpack Faces  - - - - - - - - - - - - */
+        region_begin(&m);
+        fold_faces(elements, layout, above_faces_to_recv, axis, 1, params);
+        region_end(REGION_UNPACK, &m);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+        /* - - - - - - - - - - - - Cleanup Faces - - - - - - - - - - - - */
+        delete_vector(above_faces_to_send);
+        delete_vector(above_faces_to_recv);
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+      }
+
+    }
+
+  } /* for each axis ... */
+}
+
+static void exchange_sendrecv(element *elements, const int *layout, MPI_Comm cart_comm,
+                              struct paramstype *params)
+/* One combined send and receive per direction and axis. MPI_PROC_NULL
+   neighbors turn into no-ops, so no parity ordering is needed. Both faces
+   of an axis are packed before either is unpacked, as in the other
+   backends. */
+{
+  int axis, i, neighbor[2];
+  vector send[2], recv[2];
+  regionmark m;
+
+  for (axis = 0; axis < CARTESIAN_DIMENSIONS; axis++) {
+
+    /* Slot 0 is the plus (above) side, slot 1 the minus (below) side. */
+    MPI_Cart_shift(cart_comm, axis, 1, &neighbor[1], &neighbor[0]);
+
+    region_begin(&m);
+    for (i = 0; i < 2; i++) {
+      send[i] = new_extracted_faces(elements, layout, axis, i == 0 ? 1 : -1, params);
+      recv[i] = new_empty_faces(axis, params);
+    }
+    region_end(REGION_PACK, &m);
+
+    /* Our plus face goes up while the lower neighbor's plus face comes in
+       on our minus side, then the other way round. */
+    region_begin(&m);
+    for (i = 0; i < 2; i++) {
+      MPI_Sendrecv(send[i]->V, neighbor[i] != MPI_PROC_NULL ? send[i]->size : 0, MPI_DTYPE,
+                   neighbor[i], 2 * axis + i,
+                   recv[i ^ 1]->V, neighbor[i ^ 1] != MPI_PROC_NULL ? recv[i ^ 1]->size : 0, MPI_DTYPE,
+                   neighbor[i ^ 1], 2 * axis + i, cart_comm, MPI_STATUS_IGNORE);
+    }
+    region_end(REGION_SEND, &m);
+
+    for (i = 0; i < 2; i++) {
+      if (neighbor[i] != MPI_PROC_NULL) {
+        region_begin(&m);
+        fold_faces(elements, layout, recv[i], axis, i == 0 ? 1 : -1, params);
+        region_end(REGION_UNPACK, &m);
+      }
+      delete_vector(send[i]);
+      delete_vector(recv[i]);
+    }
+  }
+}
+
+static void exchange_nonblocking(element *elements, const int *layout, MPI_Comm cart_comm,
+                              struct paramstype *params)
+/* Per axis, post both receives, then pack and post both sends, then
+   complete. Axes stay in order: faces of different axes share their edges,
+   and the other backends extract an axis only after the previous one was
+   unpacked. */
+{
+  int axis, i, n, neighbor[2];
+  vector send[2], recv[2];
+  MPI_Request requests[4];
+  regionmark m;
+
+  for (axis = 0; axis < CARTESIAN_DIMENSIONS; axis++) {
+
+    /* Slot 0 is the plus (above) side, slot 1 the minus (below) side. */
+    MPI_Cart_shift(cart_comm, axis, 1, &neighbor[1], &neighbor[0]);
+    n = 0;
+
+    region_begin(&m);
+    for (i = 0; i < 2; i++) {
+      recv[i] = NULL;
+      if (neighbor[i] == MPI_PROC_NULL) { continue; }
+      recv[i] = new_empty_faces(axis, params);
+      /* The neighbor sends towards us from its opposite slot. */
+      MPI_Irecv(recv[i]->V, recv[i]->size, MPI_DTYPE, neighbor[i], 2 * axis + (i ^ 1),
+                cart_comm, &requests[n++]);
+    }
+    region_end(REGION_RECV, &m);
+
+    for (i = 0; i < 2; i++) {
+      send[i] = NULL;
+      if (neighbor[i] == MPI_PROC_NULL) { continue; }
+
+      region_begin(&m);
+      send[i] = new_extracted_faces(elements, layout, axis, i == 0 ? 1 : -1, params);
+      region_end(REGION_PACK, &m);
+
+      region_begin(&m);
+      MPI_Isend(send[i]->V, send[i]->size, MPI_DTYPE, neighbor[i], 2 * axis + i,
+                cart_comm, &requests[n++]);
+      region_end(REGION_SEND, &m);
+    }
+
+    region_begin(&m);
+    MPI_Waitall(n, requests, MPI_STATUSES_IGNORE);
+    region_end(REGION_RECV, &m);
+
+    for (i = 0; i < 2; i++) {
+      if (recv[i] != NULL) {
+        region_begin(&m);
+        fold_faces(elements, layout, recv[i], axis, i == 0 ? 1 : -1, params);
+        region_end(REGION_UNPACK, &m);
+        delete_vector(recv[i]);
+      }
+      if (send[i] != NULL) { delete_vector(send[i]); }
+    }
+  }
+}
+
+static void exchange_pipelined(element *elements, const int *layout, MPI_Comm cart_comm,
+                               struct paramstype *params)
+/* All six receives are posted up front, and the next axis is packed while
+   the current one is in flight. Each face is unpacked as soon as it lands
+   (MPI_Waitany); the two faces of an axis lie on different planes, so
+   their order does not matter. Faces of consecutive axes share their edge
+   lines, so before the next axis is sent those lines are re-read from the
+   unpacked elements (refresh_faces), which keeps the result equal to the
+   ordered backends'. */
+{
+  int axis, next, i, slot, neighbor[CARTESIAN_DIMENSIONS][2];
+  vector send[CARTESIAN_DIMENSIONS][2], recv[CARTESIAN_DIMENSIONS][2];
+  MPI_Request recvs[CARTESIAN_DIMENSIONS][2], sends[CARTESIAN_DIMENSIONS][2];
+  regionmark m;
+
+  /* Slot 0 is the plus (above) side, slot 1 the minus (below) side. */
+  region_begin(&m);
+  for (axis = 0; axis < CARTESIAN_DIMENSIONS; axis++) {
+    MPI_Cart_shift(cart_comm, axis, 1, &neighbor[axis][1], &neighbor[axis][0]);
+    for (i = 0; i < 2; i++) {
+      send[axis][i] = recv[axis][i] = NULL;
+      recvs[axis][i] = sends[axis][i] = MPI_REQUEST_NULL;
+      if (neighbor[axis][i] == MPI_PROC_NULL) { continue; }
+      recv[axis][i] = new_empty_faces(axis, params);
+      /* The neighbor sends towards us from its opposite slot. */
+      MPI_Irecv(recv[axis][i]->V, recv[axis][i]->size, MPI_DTYPE, neighbor[axis][i],
+                2 * axis + (i ^ 1), cart_comm, &recvs[axis][i]);
+    }
+  }
+  region_end(REGION_RECV, &m);
+
+  for (axis = 0; axis < CARTESIAN_DIMENSIONS; axis++) {
+    next = axis + 1;
+
+    /* The first axis has nothing to overlap with. */
+    if (axis == 0) {
+      for (i = 0; i < 2; i++) {
+        if (neighbor[0][i] == MPI_PROC_NULL) { continue; }
+        region_begin(&m);
+        send[0][i] = new_extracted_faces(elements, layout, 0, i == 0 ? 1 : -1, params);
+        region_end(REGION_PACK, &m);
+
+        region_begin(&m);
+        MPI_Isend(send[0][i]->V, send[0][i]->size, MPI_DTYPE, neighbor[0][i], i,
+                  cart_comm, &sends[0][i]);
+        region_end(REGION_SEND, &m);
+      }
+    }
+
+    /* Pack the next axis while this one travels. */
+    if (next < CARTESIAN_DIMENSIONS) {
+      region_begin(&m);
+      for (i = 0; i < 2; i++) {
+        if (neighbor[next][i] == MPI_PROC_NULL) { continue; }
+        send[next][i] = new_extracted_faces(elements, layout, next, i == 0 ? 1 : -1, params);
+      }
+      region_end(REGION_PACK, &m);
+    }
+
+    /* Unpack this axis's faces in the order they arrive. */
+    for (;;) {
+      region_begin(&m);
+      MPI_Waitany(2, recvs[axis], &slot, MPI_STATUS_IGNORE);
+      region_end(REGION_RECV, &m);
+      if (slot == MPI_UNDEFINED) { break; }
+
+      region_begin(&m);
+      fold_faces(elements, layout, recv[axis][slot], axis, slot == 0 ? 1 : -1, params);
+      region_end(REGION_UNPACK, &m);
+      delete_vector(recv[axis][slot]);
+    }
+
+    if (next == CARTESIAN_DIMENSIONS) { break; }
+
+    /* Bring the next axis's edges up to date and send it. */
+    for (i = 0; i < 2; i++) {
+      if (send[next][i] == NULL) { continue; }
+      if (neighbor[axis][0] != MPI_PROC_NULL || neighbor[axis][1] != MPI_PROC_NULL) {
+        region_begin(&m);
+        refresh_faces(elements, layout, send[next][i], next, i == 0 ? 1 : -1, axis, params);
+        region_end(REGION_PACK, &m);
+      }
+
+      region_begin(&m);
+      MPI_Isend(send[next][i]->V, send[next][i]->size, MPI_DTYPE, neighbor[next][i], 2 * next + i,
+                cart_comm, &sends[next][i]);
+      region_end(REGION_SEND, &m);
+    }
+  }
+
+  region_begin(&m);
+  MPI_Waitall(2 * CARTESIAN_DIMENSIONS, &sends[0][0], MPI_STATUSES_IGNORE);
+  region_end(REGION_SEND, &m);
+
+  for (axis = 0; axis < CARTESIAN_DIMENSIONS; axis++) {
+    for (i = 0; i < 2; i++) {
+      if (send[axis][i] != NULL) { delete_vector(send[axis][i]); }
+    }
+  }
+}
+
+const halobackend halo_backends[] = {
+  { "blocking", exchange_blocking },
+  { "sendrecv", exchange_sendrecv },
+  { "nonblocking", exchange_nonblocking },
+  { "pipelined", exchange_pipelined },
+};
+
+const int halo_backend_count = sizeof(halo_backends) / sizeof(halo_backends[0]);
+
+const halobackend *find_halo(const char *name)
+/* Look up a backend by name, NULL if there is none. */
+{
+  int i;
+  for (i = 0; i < halo_backend_count; i++) {
+    if (strcmp(halo_backends[i].name, name) == 0) { return &halo_backends[i]; }
+  }
+  return NULL;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ----------------------------- Halo Benchmark ---------------------------- */
+/* ------------------------------------------------------------------------- */
+
+int parse_sweep(const char *spec, int *out, int max)
+/* "A:B[:S]" is a range, anything else a comma separated list. */
+{
+  int lo, hi, step = 1, n = 0, v;
+  char copy[64], *token;
+
+  if (strchr(spec, ':') != NULL && sscanf(spec, "%d:%d:%d", &lo, &hi, &step) >= 2) {
+    if (step < 1) { step = 1; }
+    for (v = lo; v <= hi && n < max; v += step) { out[n++] = v; }
+    return n;
+  }
+
+  snprintf(copy, sizeof(copy), "%s", spec);
+  for (token = strtok(copy, ","); token != NULL && n < max; token = strtok(NULL, ",")) {
+    if (atoi(token) > 0) { out[n++] = atoi(token); }
+  }
+  return n;
+}
+
+#define HALO_SWEEP_MAX 32
+#define HALO_WARMUP 5
+
+static void ping_pong(element *elements, MPI_Comm cart_comm, struct paramstype *P, int reps)
+/* Time round trips between every neighbor pair on every axis. Pairs
+   (even, even + 1) go first, then (odd, odd + 1), so each rank is in at
+   most one pair at a time. Rank 0 prints one row per pair. */
+{
+  int rank, ranks, axis, parity, r, i, below, above, coords[CARTESIAN_DIMENSIONS];
+  double mine[4 * CARTESIAN_DIMENSIONS], *all = NULL, bytes;
+  struct timespec t0, t1;
+  vector send, recv;
+
+  MPI_Comm_rank(cart_comm, &rank);
+  MPI_Comm_size(cart_comm, &ranks);
+  MPI_Cart_coords(cart_comm, rank, CARTESIAN_DIMENSIONS, coords);
+
+  /* Per axis: peer, bytes, one-way latency; peer -1 if we initiated none. */
+  for (i = 0; i < 4 * CARTESIAN_DIMENSIONS; i++) { mine[i] = -1; }
+
+  for (axis = 0; axis < CARTESIAN_DIMENSIONS; axis++) {
+    MPI_Cart_shift(cart_comm, axis, 1, &below, &above);
+    send = new_extracted_faces(elements, NULL, axis, 1, P);
+    recv = new_empty_faces(axis, P);
+    bytes = (double) send->size * sizeof(dtype);
+
+    for (parity = 0; parity < 2; parity++) {
+      MPI_Barrier(cart_comm);
+      t0 = now();
+
+      if (coords[axis] % 2 == parity && above != MPI_PROC_NULL) {
+        /* Initiator. */
+        for (r = 0; r < HALO_WARMUP + reps; r++) {
+          if (r == HALO_WARMUP) { t0 = now(); }
+          MPI_Send(send->V, send->size, MPI_DTYPE, above, 101, cart_comm);
+          MPI_Recv(recv->V, recv->size, MPI_DTYPE, above, 102, cart_comm, MPI_STATUS_IGNORE);
+        }
+        t1 = now();
+        mine[4 * axis] = above;
+        mine[4 * axis + 1] = bytes;
+        mine[4 * axis + 2] = tdiff(t0, t1) / (2.0 * reps);
+      }
+      else if (coords[axis] % 2 != parity && below != MPI_PROC_NULL) {
+        /* Responder. */
+        for (r = 0; r < HALO_WARMUP + reps; r++) {
+          MPI_Recv(recv->V, recv->size, MPI_DTYPE, below, 101, cart_comm, MPI_STATUS_IGNORE);
+          MPI_Send(send->V, send->size, MPI_DTYPE, below, 102, cart_comm);
+        }
+      }
+    }
+
+    delete_vector(send);
+    delete_vector(recv);
+  }
+
+  if (rank == 0) { all = malloc(sizeof(double) * 4 * CARTESIAN_DIMENSIONS * ranks); }
+  MPI_Gather(mine, 4 * CARTESIAN_DIMENSIONS, MPI_DOUBLE, all, 4 * CARTESIAN_DIMENSIONS,
+             MPI_DOUBLE, 0, cart_comm);
+
+  if (rank == 0) {
+    for (r = 0; r < ranks; r++) {
+      for (axis = 0; axis < CARTESIAN_DIMENSIONS; axis++) {
+        double *row = &all[4 * CARTESIAN_DIMENSIONS * r + 4 * axis];
+        if (row[0] < 0) { continue; }
+        printf("pingpong,%d,%d,%d,%d,%d,%.0f,%.3f,%.4f,%.0f\n",
+               P->ELEMENT_SIZE, P->ELEMENTS_ON_X_FACE, axis, r, (int) row[0], row[1],
+               1E6 * row[2], row[2] > 0 ? row[1] / row[2] / 1E9 : 0,
+               row[2] > 0 ? 1.0 / row[2] : 0);
+      }
+    }
+    free(all);
+  }
+}
+
+void run_halo_benchmark(MPI_Comm cart_comm, struct paramstype *params)
+/* Exchange-only mode: ping-pong every neighbor pair and time every backend
+   over the ELEMENT_SIZE and elements-per-face sweeps. Collective. */
+{
+  int sizes[HALO_SWEEP_MAX], faces[HALO_SWEEP_MAX], nsizes, nfaces;
+  int si, fi, h, r, e, rank, axis, below, above, best;
+  double seconds, slowest, bytes, messages, total_bytes, total_messages, best_time;
+  struct paramstype P;
+  struct timespec t0, t1;
+  element *elements;
+
+  MPI_Comm_rank(cart_comm, &rank);
+  nsizes = parse_sweep(params->HALO_SIZES, sizes, HALO_SWEEP_MAX);
+  nfaces = parse_sweep(params->HALO_FACES, faces, HALO_SWEEP_MAX);
+
+  if (rank == 0) {
+    printf("pingpong,N,elements_per_face,axis,rank,peer,bytes,latency_us,gbyte/s,msgs/s\n");
+    printf("exchange,N,elements_per_face,backend,bytes_per_rank,time_us,gbyte/s,msgs/s\n");
+    printf("best,N,elements_per_face,bytes_per_message,backend\n");
+  }
+
+  for (si = 0; si < nsizes; si++) {
+    for (fi = 0; fi < nfaces; fi++) {
+
+      /* Same face geometry on every axis, so message size = faces * P * N^2. */
+      P = *params;
+      P.ELEMENT_SIZE = sizes[si];
+      P.FACE_SIZE = P.ELEMENT_SIZE * P.ELEMENT_SIZE;
+      P.ELEMENTS_ON_X_FACE = P.ELEMENTS_ON_Y_FACE = P.ELEMENTS_ON_Z_FACE = faces[fi];
+
+      elements = malloc(sizeof(element) * faces[fi]);
+      for (e = 0; e < faces[fi]; e++) { elements[e] = new_counter_element(0, 10, rng_key(rng_stream(RNG_HALO), e), &P); }
+
+      ping_pong(elements, cart_comm, &P, params->HALO_REPS);
+
+      /* What this rank moves per exchange. */
+      bytes = messages = 0;
+      for (axis = 0; axis < CARTESIAN_DIMENSIONS; axis++) {
+        MPI_Cart_shift(cart_comm, axis, 1, &below, &above);
+        messages += (below != MPI_PROC_NULL) + (above != MPI_PROC_NULL);
+      }
+      bytes = messages * faces[fi] * P.PHYSICAL_PARAMS * P.FACE_SIZE * sizeof(dtype);
+      MPI_Reduce(&bytes, &total_bytes, 1, MPI_DOUBLE, MPI_SUM, 0, cart_comm);
+      MPI_Reduce(&messages, &total_messages, 1, MPI_DOUBLE, MPI_SUM, 0, cart_comm);
+
+      best = 0;
+      best_time = 0;
+      for (h = 0; h < halo_backend_count; h++) {
+        for (r = 0; r < HALO_WARMUP; r++) { halo_backends[h].exchange(elements, NULL, cart_comm, &P); }
+
+        MPI_Barrier(cart_comm);
+        t0 = now();
+        for (r = 0; r < params->HALO_REPS; r++) { halo_backends[h].exchange(elements, NULL, cart_comm, &P); }
+        t1 = now();
+        seconds = tdiff(t0, t1) / params->HALO_REPS;
+
+        /* The exchange is done when the slowest rank is. */
+        MPI_Reduce(&seconds, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, cart_comm);
+
+        if (rank == 0) {
+          printf("exchange,%d,%d,%s,%.0f,%.3f,%.4f,%.0f\n", P.ELEMENT_SIZE, faces[fi],
+                 halo_backends[h].name, bytes, 1E6 * slowest,
+                 slowest > 0 ? total_bytes / slowest / 1E9 : 0,
+                 slowest > 0 ? total_messages / slowest : 0);
+          if (h == 0 || slowest < best_time) { best = h; best_time = slowest; }
+        }
+      }
+
+      if (rank == 0) {
+        printf("best,%d,%d,%.0f,%s\n", P.ELEMENT_SIZE, faces[fi],
+               (double) faces[fi] * P.PHYSICAL_PARAMS * P.FACE_SIZE * sizeof(dtype),
+               halo_backends[best].name);
+      }
+
+      for (e = 0; e < faces[fi]; e++) { delete_element(elements[e], &P); }
+      free(elements);
+    }
+  }
+}
@@ -0,0 +1,91 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HALO_H_
+#define HALO_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+#include "dstructs.h"
+
+/* -------------------------- Machine/Primary Parameters --------------------------- */
+#ifdef CMT_SINGLE
+  #define MPI_DTYPE MPI_FLOAT		// MPI datatypes, matching dtype
+#else
+  #define MPI_DTYPE MPI_DOUBLE		// MPI datatypes, matching dtype
+#endif
+  #define CARTESIAN_DIMENSIONS 3  	// Setup for MPI Cartesian function calls
+
+
+/* ---------------------------- Exchange Backends -------------------------- */
+
+/* One way of moving the faces of R to the (up to six) cartesian neighbors
+   and folding the received faces back in. Every backend transfers the same
+   data in the same axis order, so they give identical results; they differ
+   only in the MPI protocol. layout is the element ordering's table (see
+   new_extracted_faces), NULL for elements stored in the original layout. */
+typedef struct {
+  const char *name;
+  void (*exchange)(element *elements, const int *layout, MPI_Comm cart_comm,
+                   struct paramstype *params);
+} halobackend;
+
+/* All backends; entry 0 is the original blocking even/odd exchange:
+
+     blocking     |  MPI_Send/MPI_Recv ordered by the parity of our index
+     sendrecv     |  one MPI_Sendrecv per direction and axis
+     nonblocking  |  per axis, both receives and sends posted at once, MPI_Waitall
+     pipelined    |  all receives up front, the next axis packed while the
+                     current one is in flight, faces unpacked as they land */
+extern const halobackend halo_backends[];
+extern const int halo_backend_count;
+
+/* Look up a backend by name, NULL if there is none. */
+const halobackend *find_halo(const char *name);
+
+/* Have every backend call hook(axis, sign) right after it has folded one
+   received face set into the elements (as unpack_faces(axis, sign)), on the
+   thread that runs the exchange. NULL, the default, for none. */
+void set_unpack_hook(void (*hook)(int axis, int sign));
+
+
+/* ---------------------------- Halo Benchmark ----------------------------- */
+
+/* Exchange-only mode (MODE "halo"): no Compute (A) or (B). For every
+   ELEMENT_SIZE in HALO_SIZES and elements-per-face count in HALO_FACES it
+   - ping-pongs each neighbor pair along each axis and reports latency,
+     bandwidth and message rate per pair, and
+   - times HALO_REPS full exchanges with every backend, reporting the
+     slowest rank's time, aggregate bandwidth and message rate, and the
+     fastest backend for that message size.
+   Message sizes are those of new_empty_faces. Collective on cart_comm. */
+void run_halo_benchmark(MPI_Comm cart_comm, struct paramstype *params);
+
+/* The values of a sweep such as HALO_SIZES, "A:B[:S]" or a comma separated
+   list, at most max of them. Returns how many. */
+int parse_sweep(const char *spec, int *out, int max);
+
+#endif
@@ -0,0 +1,189 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "order.h"
+#include "params.h"
+
+typedef struct {
+  int dims[3];
+  int count;
+  int *pos;        // 3 coordinates per stored element
+  int *stored;     // stored index of each element of the original layout
+  int *lex;        // original index of each stored element
+  int identity;
+  int faces;       // elements the fixed exchange touches, from the start of the original layout
+} ordertype;
+
+static ordertype O;
+
+const char *element_orders[] = { "lexicographic", "morton", "hilbert" };
+const int element_order_count = sizeof(element_orders) / sizeof(element_orders[0]);
+
+
+/* ------------------------------------------------------------------------- */
+/* --------------------------------- Curves -------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static unsigned long long morton_code(const int pos[3], int bits)
+/* x in the lowest bit of each group of three. */
+{
+  unsigned long long code = 0;
+  int bit, a;
+
+  for (bit = bits - 1; bit >= 0; bit--) {
+    for (a = 2; a >= 0; a--) { code = (code << 1) | ((pos[a] >> bit) & 1); }
+  }
+  return code;
+}
+
+static unsigned long long hilbert_code(const int pos[3], int bits)
+/* Skilling's transform of the coordinates into the transposed Hilbert
+   index, then its bits interleaved into one number. */
+{
+  unsigned int x[3] = { pos[0], pos[1], pos[2] }, M = 1U << (bits - 1), P, Q, t;
+  unsigned long long code = 0;
+  int i, bit;
+
+  /* Inverse undo */
+  for (Q = M; Q > 1; Q >>= 1) {
+    P = Q - 1;
+    for (i = 0; i < 3; i++) {
+      if (x[i] & Q) { x[0] ^= P; }
+      else { t = (x[0] ^ x[i]) & P; x[0] ^= t; x[i] ^= t; }
+    }
+  }
+
+  /* Gray encode */
+  for (i = 1; i < 3; i++) { x[i] ^= x[i - 1]; }
+  t = 0;
+  for (Q = M; Q > 1; Q >>= 1) { if (x[2] & Q) { t ^= Q - 1; } }
+  for (i = 0; i < 3; i++) { x[i] ^= t; }
+
+  for (bit = bits - 1; bit >= 0; bit--) {
+    for (i = 0; i < 3; i++) { code = (code << 1) | ((x[i] >> bit) & 1); }
+  }
+  return code;
+}
+
+static unsigned long long *sort_codes;
+
+static int by_code(const void *a, const void *b)
+{
+  unsigned long long x = sort_codes[*(const int *) a], y = sort_codes[*(const int *) b];
+  return (x > y) - (x < y);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* -------------------------------- Ordering ------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+void setup_element_order(struct paramstype *params)
+/* Sort the original indices by their curve code. */
+{
+  int i, bits = 1, pos[3];
+  unsigned long long *codes;
+
+  memset(&O, 0, sizeof(O));
+  O.dims[0] = params->ELEMENTS_X;
+  O.dims[1] = params->ELEMENTS_Y;
+  O.dims[2] = params->ELEMENTS_Z;
+  O.count = O.dims[0] * O.dims[1] * O.dims[2];
+  O.faces = params->ELEMENTS_ON_X_FACE;
+  if (params->ELEMENTS_ON_Y_FACE > O.faces) { O.faces = params->ELEMENTS_ON_Y_FACE; }
+  if (params->ELEMENTS_ON_Z_FACE > O.faces) { O.faces = params->ELEMENTS_ON_Z_FACE; }
+  O.pos = malloc(sizeof(int) * 3 * O.count);
+  O.stored = malloc(sizeof(int) * O.count);
+  O.lex = malloc(sizeof(int) * O.count);
+  codes = malloc(sizeof(unsigned long long) * O.count);
+
+  while ((1 << bits) < O.dims[0] || (1 << bits) < O.dims[1] || (1 << bits) < O.dims[2]) { bits++; }
+
+  for (i = 0; i < O.count; i++) {
+    pos[0] = i % O.dims[0];
+    pos[1] = i / O.dims[0] % O.dims[1];
+    pos[2] = i / (O.dims[0] * O.dims[1]);
+    if (strcmp(params->ELEMENT_ORDER, "morton") == 0) { codes[i] = morton_code(pos, bits); }
+    else if (strcmp(params->ELEMENT_ORDER, "hilbert") == 0) { codes[i] = hilbert_code(pos, bits); }
+    else { codes[i] = i; }
+    O.lex[i] = i;
+  }
+
+  sort_codes = codes;
+  qsort(O.lex, O.count, sizeof(int), by_code);
+  sort_codes = NULL;
+
+  O.identity = 1;
+  for (i = 0; i < O.count; i++) {
+    O.stored[O.lex[i]] = i;
+    O.pos[3 * i + 0] = O.lex[i] % O.dims[0];
+    O.pos[3 * i + 1] = O.lex[i] / O.dims[0] % O.dims[1];
+    O.pos[3 * i + 2] = O.lex[i] / (O.dims[0] * O.dims[1]);
+    if (O.lex[i] != i) { O.identity = 0; }
+  }
+  free(codes);
+}
+
+void delete_element_order(void)
+{
+  free(O.pos);
+  free(O.stored);
+  free(O.lex);
+}
+
+void element_position(int e, int pos[3])
+{
+  pos[0] = O.pos[3 * e + 0];
+  pos[1] = O.pos[3 * e + 1];
+  pos[2] = O.pos[3 * e + 2];
+}
+
+int element_index(const int pos[3])
+{
+  return O.stored[(pos[2] * O.dims[1] + pos[1]) * O.dims[0] + pos[0]];
+}
+
+int lexicographic_index(int e)
+{
+  return O.lex[e];
+}
+
+const int *layout_table(void)
+{
+  return O.identity ? NULL : O.stored;
+}
+
+int face_first_order(int *order)
+{
+  int e, n = 0;
+
+  for (e = 0; e < O.faces; e++) { order[n++] = O.stored[e]; }
+  for (e = 0; e < O.count; e++) {
+    if (O.lex[e] >= O.faces) { order[n++] = e; }
+  }
+  return O.faces;
+}
@@ -0,0 +1,72 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ORDER_H_
+#define ORDER_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "params.h"
+
+
+/* ---------------------------- Element Orderings -------------------------- */
+
+/* The order in which a rank stores the elements of its box (ELEMENT_ORDER):
+
+     lexicographic  |  x fastest, then y, then z (the original layout)
+     morton         |  Z-order: the bits of x, y and z interleaved
+     hilbert        |  the 3-D Hilbert curve
+
+   Both curves are laid over the smallest power-of-two cube holding the box
+   and skip the cells outside it. Along a curve, elements that are close in
+   the array are close in space, and a static schedule hands each thread a
+   compact piece of the box. The random data is keyed by an element's place
+   in the original layout, so the ordering changes memory layout only. */
+
+/* The names ELEMENT_ORDER takes, lexicographic first. */
+extern const char *element_orders[];
+extern const int element_order_count;
+
+/* Build the ordering of a box of ELEMENTS_X x Y x Z. */
+void setup_element_order(struct paramstype *params);
+void delete_element_order(void);
+
+/* Box coordinates of the element stored at e, and the stored index of the
+   element at pos. */
+void element_position(int e, int pos[3]);
+int element_index(const int pos[3]);
+
+/* Index of stored element e in the original layout. */
+int lexicographic_index(int e);
+
+/* Stored index of every element of the original layout, for the face
+   functions (flux.h); NULL when the ordering is lexicographic. */
+const int *layout_table(void);
+
+/* Fill order with every stored index, those of the elements the fixed face
+   exchange reads or writes (the first ELEMENTS_ON_*_FACE of the original
+   layout) first. Returns how many those are. */
+int face_first_order(int *order);
+
+#endif
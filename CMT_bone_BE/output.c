@@ -0,0 +1,342 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <mpi.h>
+
+#include "output.h"
+#include "params.h"
+#include "timers.h"
+#include "dstructs.h"
+#include "roofline.h"
+#include "affinity.h"
+
+#ifndef CMT_CFLAGS
+#define CMT_CFLAGS "unknown"
+#endif
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Run Metadata ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+const char *build_isa(void)
+/* Instruction set the binary was compiled for, from the compiler's macros. */
+{
+#if defined(__AVX512F__)
+  return "avx512f";
+#elif defined(__AVX2__)
+  return "avx2";
+#elif defined(__AVX__)
+  return "avx";
+#elif defined(__SSE2__)
+  return "sse2";
+#elif defined(__ARM_FEATURE_SVE)
+  return "sve";
+#elif defined(__ARM_NEON)
+  return "neon";
+#else
+  return "generic";
+#endif
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Tree Writer ------------------------------ */
+/* ------------------------------------------------------------------------- */
+
+/* Walks the same tree of sections and keys for both formats. JSON nests
+   objects; CSV flattens to one "section,key,value" row per leaf so that new
+   keys never shift existing columns. */
+
+#define WRITER_DEPTH 8
+
+typedef struct {
+  FILE *f;
+  int json;
+  int depth;
+  int first[WRITER_DEPTH];
+  char path[WRITER_DEPTH][64];
+} writer;
+
+static void w_key(writer *w, const char *key)
+/* Separator, indentation and key of the next JSON member. */
+{
+  if (!w->first[w->depth]) { fprintf(w->f, ","); }
+  w->first[w->depth] = 0;
+  fprintf(w->f, "\n%*s\"%s\": ", 2 * w->depth, "", key);
+}
+
+static void w_section(writer *w)
+/* Dotted path of the current section, for the CSV rows. */
+{
+  int d;
+  if (w->depth < 2) { fprintf(w->f, "root"); }
+  for (d = 2; d <= w->depth; d++) {
+    fprintf(w->f, "%s%s", d > 2 ? "." : "", w->path[d]);
+  }
+}
+
+static void w_open(writer *w, const char *key)
+/* Start a nested section (the root when key is NULL). */
+{
+  if (w->json) {
+    if (key != NULL) { w_key(w, key); }
+    fprintf(w->f, "{");
+  }
+  w->depth++;
+  w->first[w->depth] = 1;
+  snprintf(w->path[w->depth], sizeof(w->path[0]), "%s", key ? key : "");
+}
+
+static void w_close(writer *w)
+/* End the innermost section. */
+{
+  w->depth--;
+  if (w->json) { fprintf(w->f, "\n%*s}", 2 * w->depth, ""); }
+}
+
+static void w_num(writer *w, const char *key, double value)
+{
+  if (w->json) { w_key(w, key); fprintf(w->f, "%.9g", value); }
+  else { w_section(w); fprintf(w->f, ",%s,%.9g\n", key, value); }
+}
+
+static void w_int(writer *w, const char *key, long value)
+{
+  if (w->json) { w_key(w, key); fprintf(w->f, "%ld", value); }
+  else { w_section(w); fprintf(w->f, ",%s,%ld\n", key, value); }
+}
+
+static void w_str(writer *w, const char *key, const char *value)
+/* Strings are quoted in both formats; embedded quotes are dropped. */
+{
+  const char *c;
+  if (w->json) { w_key(w, key); }
+  else { w_section(w); fprintf(w->f, ",%s,", key); }
+  fputc('"', w->f);
+  for (c = value; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\' || *c == '\n') { continue; }
+    fputc(*c, w->f);
+  }
+  fputc('"', w->f);
+  if (!w->json) { fputc('\n', w->f); }
+}
+
+static void w_array(writer *w, const char *key, double *values, int n)
+/* A JSON array, or one CSV row per element keyed as key[i]. */
+{
+  int i;
+  if (w->json) {
+    w_key(w, key);
+    fprintf(w->f, "[");
+    for (i = 0; i < n; i++) { fprintf(w->f, "%s%.9g", i ? "," : "", values[i]); }
+    fprintf(w->f, "]");
+  } else {
+    for (i = 0; i < n; i++) {
+      w_section(w);
+      fprintf(w->f, ",%s[%d],%.9g\n", key, i, values[i]);
+    }
+  }
+}
+
+static void w_stats(writer *w, const char *key, phasestats *S)
+/* One reduced phase or region. */
+{
+  w_open(w, key);
+  w_num(w, "min", S->min);
+  w_num(w, "max", S->max);
+  w_num(w, "mean", S->mean);
+  w_num(w, "std", S->std);
+  w_num(w, "imbalance", S->imbalance);
+  w_num(w, "critical", S->critical);
+  w_int(w, "slowest_rank", S->slowest);
+  w_int(w, "slowest_x", S->coords[0]);
+  w_int(w, "slowest_y", S->coords[1]);
+  w_int(w, "slowest_z", S->coords[2]);
+  w_close(w);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Results File ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+void write_results(struct paramstype *params, MPI_Comm comm, const char **names,
+                   double **samples, int phases, int n)
+/* Write the results of a run in params->OUTPUT format. Collective on comm;
+   only rank 0 writes. */
+{
+  int p, r, rank, ranks, len, regions_on = (params->PROFILE >= 2);
+  double wall = 0, blocks, seconds;
+  char host[MPI_MAX_PROCESSOR_NAME], stamp[32], cpu[128];
+  phasestats S[phases], R[REGION_COUNT], M[MEMORY_COUNT + 1];
+  time_t clock = time(NULL);
+  writer w;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* Reductions first, they are collective. */
+  for (p = 0; p < phases; p++) { S[p] = reduce_phase(samples[p], n, comm); }
+  if (regions_on) {
+    for (r = 0; r < REGION_COUNT; r++) {
+      seconds = region_total(r).seconds;
+      R[r] = reduce_phase(&seconds, 1, comm);
+    }
+  }
+  for (r = 0; r <= MEMORY_COUNT; r++) {
+    seconds = r < MEMORY_COUNT ? memory_usage(r).peak : memory_peak();
+    M[r] = reduce_phase(&seconds, 1, comm);
+  }
+
+  if (rank != 0) { return; }
+
+  memset(&w, 0, sizeof(w));
+  w.json = (strcmp(params->OUTPUT, "json") == 0);
+  w.f = (strcmp(params->OUTPUT_FILE, "-") == 0) ? stdout : fopen(params->OUTPUT_FILE, "w");
+  if (w.f == NULL) {
+    printf("Could not open results file %s.\n", params->OUTPUT_FILE);
+    return;
+  }
+  if (!w.json) { fprintf(w.f, "section,key,value\n"); }
+
+  memset(host, 0, sizeof(host));
+  MPI_Get_processor_name(host, &len);
+  cpu_model(cpu, sizeof(cpu));
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&clock));
+
+  /* Stages are bulk synchronous: the run lasts as long as the critical path. */
+  for (p = 0; p < phases; p++) { wall += S[p].critical; }
+  blocks = (double) ranks * params->ELEMENTS_PER_PROCESS * params->PHYSICAL_PARAMS *
+           params->TIMESTEPS * params->RK;
+
+  w_open(&w, NULL);
+
+  w_int(&w, "schema", RESULTS_SCHEMA);
+
+  w_open(&w, "run");
+  w_str(&w, "hostname", host);
+  w_str(&w, "timestamp", stamp);
+  w_str(&w, "cpu", cpu);
+  w_int(&w, "ranks", ranks);
+  w_int(&w, "threads", params->THREADS);
+  w_str(&w, "kernel_variant", params->KERNEL);
+  w_int(&w, "tile", params->TILE);
+  w_str(&w, "exchange_backend", params->HALO);
+  w_int(&w, "fold_faces", params->FOLD_FACES);
+  w_str(&w, "autotune", params->AUTOTUNE);
+  w_str(&w, "isa", build_isa());
+  w_str(&w, "affinity", params->AFFINITY);
+#ifdef __VERSION__
+  w_str(&w, "compiler", __VERSION__);
+#endif
+  w_str(&w, "cflags", CMT_CFLAGS);
+  w_str(&w, "precision", DTYPE_NAME);
+  w_int(&w, "dtype_bytes", sizeof(dtype));
+  w_close(&w);
+
+  if (machine_calibration().valid) {
+    w_open(&w, "calibration");
+    w_num(&w, "stream_triad_gbytes_per_s", machine_calibration().bandwidth);
+    w_num(&w, "peak_gflops", machine_calibration().peak);
+    w_close(&w);
+  }
+
+  w_open(&w, "params");
+  w_int(&w, "TIMESTEPS", params->TIMESTEPS);
+  w_int(&w, "RK", params->RK);
+  w_int(&w, "ELEMENT_SIZE", params->ELEMENT_SIZE);
+  w_int(&w, "PHYSICAL_PARAMS", params->PHYSICAL_PARAMS);
+  w_int(&w, "ELEMENTS_X", params->ELEMENTS_X);
+  w_int(&w, "ELEMENTS_Y", params->ELEMENTS_Y);
+  w_int(&w, "ELEMENTS_Z", params->ELEMENTS_Z);
+  w_int(&w, "ELEMENTS_PER_PROCESS", params->ELEMENTS_PER_PROCESS);
+  w_int(&w, "CARTESIAN_X", params->CARTESIAN_X);
+  w_int(&w, "CARTESIAN_Y", params->CARTESIAN_Y);
+  w_int(&w, "CARTESIAN_Z", params->CARTESIAN_Z);
+  w_int(&w, "PROBED_RANK", params->PROBED_RANK);
+  w_int(&w, "PROFILE", params->PROFILE);
+  w_int(&w, "COUNTERS", params->COUNTERS);
+  w_int(&w, "ROOFLINE", params->ROOFLINE);
+  w_close(&w);
+
+  w_open(&w, "phases");
+  for (p = 0; p < phases; p++) { w_stats(&w, names[p], &S[p]); }
+  w_close(&w);
+
+  if (regions_on) {
+    w_open(&w, "regions");
+    for (r = 0; r < REGION_COUNT; r++) { w_stats(&w, region_names[r], &R[r]); }
+    w_close(&w);
+  }
+
+  /* Rank 0's achieved rates per region, from the analytic work model. */
+  if (regions_on) {
+    w_open(&w, "kernels");
+    for (r = 0; r < REGION_COUNT; r++) {
+      double flops, bytes, wall = region_total(r).seconds / params->THREADS;
+      region_work(r, comm, params, &flops, &bytes);
+      w_open(&w, region_names[r]);
+      w_num(&w, "flops", flops);
+      w_num(&w, "bytes", bytes);
+      w_num(&w, "gflops", wall > 0 ? flops / wall / 1E9 : 0);
+      w_num(&w, "gbytes_per_s", wall > 0 ? bytes / wall / 1E9 : 0);
+      w_close(&w);
+    }
+    w_close(&w);
+  }
+
+  /* High-water marks in bytes; the largest rank's is max. */
+  w_open(&w, "memory");
+  for (r = 0; r <= MEMORY_COUNT; r++) {
+    w_open(&w, r < MEMORY_COUNT ? memory_names[r] : "total");
+    w_num(&w, "peak_min", M[r].min);
+    w_num(&w, "peak_max", M[r].max);
+    w_num(&w, "peak_mean", M[r].mean);
+    w_int(&w, "largest_rank", M[r].slowest);
+    w_close(&w);
+  }
+  w_close(&w);
+
+  w_open(&w, "derived");
+  w_num(&w, "wall_seconds", wall);
+  w_num(&w, "gflops", wall > 0 ? blocks * block_flops(params) / wall / 1E9 : 0);
+  w_num(&w, "gbytes_per_s", wall > 0 ? blocks * block_bytes(params) / wall / 1E9 : 0);
+  w_num(&w, "dofs_per_s", wall > 0 ? blocks * params->ELEMENT_SIZE * params->ELEMENT_SIZE *
+                                     params->ELEMENT_SIZE / wall : 0);
+  w_close(&w);
+
+  w_open(&w, "samples");
+  w_int(&w, "rank", 0);
+  for (p = 0; p < phases; p++) { w_array(&w, names[p], samples[p], n); }
+  w_close(&w);
+
+  w_close(&w);
+  if (w.json) { fprintf(w.f, "\n"); }
+
+  if (w.f != stdout) { fclose(w.f); }
+}
@@ -0,0 +1,49 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+
+
+/* Bump whenever a key is renamed or removed, so consumers can tell. Adding
+   keys does not change the schema. */
+#define RESULTS_SCHEMA 1
+
+/* Instruction set the binary was compiled for, from the compiler's macros. */
+const char *build_isa(void);
+
+/* Write the results of a run in params->OUTPUT format (json or csv) to
+   params->OUTPUT_FILE: run metadata, every parameter, cross-rank statistics
+   of each phase and region, derived rates and this rank 0's raw per-stage
+   samples. names/samples/phases/n are as for report_phases. Collective on
+   comm; only rank 0 writes. */
+void write_results(struct paramstype *params, MPI_Comm comm, const char **names,
+                   double **samples, int phases, int n);
+
+#endif
@@ -25,96 +25,623 @@ Original:
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <mpi.h>
 #include <assert.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+#include <mpi.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "params.h"
+#include "dstructs.h"
+#include "flux.h"
+#include "halo.h"
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Option Table ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+/* Every tunable is one row: its name (--name on the command line, name in a
+   config file, CMT_NAME in the environment), where it lives in paramstype,
+   its default and what it accepts. */
+
+enum { OPT_UINT, OPT_REAL, OPT_TEXT };
+
+typedef struct {
+  const char *name;
+  int type;
+  size_t offset;
+  size_t size;            // OPT_TEXT only
+  const char *fallback;
+  unsigned int min, max;  // OPT_UINT only
+  const char *choices;    // OPT_TEXT: "a|b|c", or NULL for free text
+  const char *help;
+} optiontype;
+
+#define UINT_OPT(name, field, fallback, min, max, help) \
+  { name, OPT_UINT, offsetof(struct paramstype, field), 0, fallback, min, max, NULL, help }
+#define REAL_OPT(name, field, fallback, help) \
+  { name, OPT_REAL, offsetof(struct paramstype, field), 0, fallback, 0, 0, NULL, help }
+#define TEXT_OPT(name, field, fallback, choices, help) \
+  { name, OPT_TEXT, offsetof(struct paramstype, field), sizeof(((struct paramstype *) 0)->field), \
+    fallback, 0, 0, choices, help }
+
+static const optiontype options[] = {
+  /* Problem */
+  UINT_OPT("timesteps", TIMESTEPS, "3", 1, 1000000, "Number of simulation timesteps"),
+  UINT_OPT("rk", RK, "3", 1, 16, "Number of Runge Kutta stages"),
+  UINT_OPT("element-size", ELEMENT_SIZE, "5", 2, 64, "Size of each element (cubic)"),
+  UINT_OPT("physical-params", PHYSICAL_PARAMS, "5", 1, 64, "Number of physics parameters tracked"),
+  UINT_OPT("elements-x", ELEMENTS_X, "2", 1, 4096, "Elements per process in X"),
+  UINT_OPT("elements-y", ELEMENTS_Y, "2", 1, 4096, "Elements per process in Y"),
+  UINT_OPT("elements-z", ELEMENTS_Z, "2", 1, 4096, "Elements per process in Z"),
+  UINT_OPT("cartesian-x", CARTESIAN_X, "2", 1, 65536, "Processes in X"),
+  UINT_OPT("cartesian-y", CARTESIAN_Y, "2", 1, 65536, "Processes in Y"),
+  UINT_OPT("cartesian-z", CARTESIAN_Z, "2", 1, 65536, "Processes in Z"),
+  TEXT_OPT("precision", PRECISION, DTYPE_NAME, "single|double", "Working precision; must match the build (make PRECISION=...)"),
+
+  /* Machine */
+  UINT_OPT("probed-rank", PROBED_RANK, "0", 0, 1 << 30, "The rank which shows its timing output"),
+  UINT_OPT("threads", THREADS, "0", 0, 1024, "OpenMP threads per rank (0: OMP_NUM_THREADS or all cores)"),
+  TEXT_OPT("affinity", AFFINITY, "none", NULL, "Core binding: none, compact, scatter or a cpu list"),
+  TEXT_OPT("kernel", KERNEL, "reference", NULL, "Kernel variant for Compute (A) and (B)"),
+  UINT_OPT("tile", TILE, "1", 0, 4096, "Blocks per Compute (A) tile (1: one at a time, 0: fit L2)"),
+  TEXT_OPT("element-order", ELEMENT_ORDER, "lexicographic", "lexicographic|morton|hilbert", "Storage order of a rank's elements"),
+  TEXT_OPT("halo", HALO, "blocking", NULL, "Exchange backend: blocking, sendrecv, nonblocking or pipelined"),
+  UINT_OPT("comm-thread", COMM_THREAD, "0", 0, 1, "Exchange on a dedicated thread during Compute (A)"),
+  TEXT_OPT("comm-cpu", COMM_CPU, "", NULL, "Cpu for the communication thread (empty: one affinity leaves free)"),
+  UINT_OPT("dataflow", DATAFLOW, "0", 0, 1, "Start Compute (B) per element as its faces arrive"),
+  UINT_OPT("ghost-depth", GHOST_DEPTH, "0", 0, 8, "Exchange deep ghosts every this many stages (0: off)"),
+  UINT_OPT("fold-faces", FOLD_FACES, "0", 0, 1, "Average received faces into R (0: drop them, as the original)"),
+  TEXT_OPT("mode", MODE, "run", "run|halo|strong|weak", "run: the mini-app, halo: exchange-only benchmark, strong/weak: scaling study"),
+
+  /* Timers and reports */
+  UINT_OPT("profile", PROFILE, "1", 0, 2, "0: per-step, 1: per phase, 2: plus per-kernel regions"),
+  UINT_OPT("counters", COUNTERS, "0", 0, 1, "perf_event counters per region (needs profile 2)"),
+  TEXT_OPT("perf-flops-event", PERF_FLOPS_EVENT, "", NULL, "Raw perf event code counting FLOPs"),
+  UINT_OPT("report-every", REPORT_EVERY, "0", 0, 1000000, "Cross-rank report every this many steps"),
+  UINT_OPT("roofline", ROOFLINE, "0", 0, 1, "Calibrate and print a roofline report"),
+  UINT_OPT("stream-mb", STREAM_MB, "48", 1, 1 << 20, "Size of the STREAM calibration arrays per rank"),
+  TEXT_OPT("output", OUTPUT, "text", "text|json|csv", "Results format"),
+  TEXT_OPT("output-file", OUTPUT_FILE, "", NULL, "Results file (default results.<format>, - for stdout)"),
+
+  /* Halo benchmark */
+  TEXT_OPT("halo-sizes", HALO_SIZES, "5:25:5", NULL, "ELEMENT_SIZE sweep, MIN:MAX[:STEP] or a list"),
+  TEXT_OPT("halo-faces", HALO_FACES, "1,4,16,64", NULL, "Elements-per-face sweep"),
+  UINT_OPT("halo-reps", HALO_REPS, "100", 1, 1000000, "Timed repetitions per point"),
+
+  /* Scaling study */
+  TEXT_OPT("scaling-ranks", SCALING_RANKS, "", NULL, "Rank counts, MIN:MAX[:STEP] or a list (empty: powers of two and all)"),
+
+  /* Verification */
+  TEXT_OPT("verify", VERIFY, "off", "off|record|check", "Per-stage checksums"),
+  TEXT_OPT("verify-file", VERIFY_FILE, "verify.ref", NULL, "Reference checksum file"),
+  REAL_OPT("verify-rtol", VERIFY_RTOL, "0", "Relative tolerance (0: default)"),
+  UINT_OPT("verify-ulps", VERIFY_ULPS, "0", 0, 1 << 30, "Tolerance in units of machine epsilon"),
+
+  /* Autotuning */
+  TEXT_OPT("autotune", AUTOTUNE, "off", "off|auto|force", "Pick kernel, tile, element-order and halo per machine (overrides them)"),
+  TEXT_OPT("autotune-file", AUTOTUNE_FILE, "cmtbone.tune", NULL, "Tuning results, keyed by cpu model and problem"),
+  UINT_OPT("autotune-reps", AUTOTUNE_REPS, "3", 1, 1000, "Timed trials per candidate"),
 
+  /* Checkpoint and restart */
+  UINT_OPT("checkpoint-every", CHECKPOINT_EVERY, "0", 0, 1000000, "Checkpoint Q every this many timesteps (0: never)"),
+  TEXT_OPT("checkpoint-file", CHECKPOINT_FILE, "cmtbone.ckpt", NULL, "Checkpoint file name, .0/.1 appended"),
+  UINT_OPT("restart", RESTART, "0", 0, 1, "Start from the newest complete checkpoint"),
+  TEXT_OPT("initial-state", INITIAL_STATE, "", NULL, "Map Q from this state file (checkpoint format)"),
 
-/* Set machine & application parameters from user-specified command line arguments*/
-void setup_parameters(int argc, char *argv[], int rank, struct paramstype *params)
+  /* In-situ diagnostics */
+  TEXT_OPT("diagnostics", DIAGNOSTICS, "off", "off|r|q", "Per-parameter statistics of R or Q"),
+  UINT_OPT("diagnostics-every", DIAGNOSTICS_EVERY, "1", 1, 1000000, "Gather statistics every this many timesteps"),
+  UINT_OPT("diagnostics-overlap", DIAGNOSTICS_OVERLAP, "1", 0, 1, "Overlap the reduction with the next Compute (A)"),
+  TEXT_OPT("diagnostics-file", DIAGNOSTICS_FILE, "", NULL, "CSV of every reduction (empty: none)"),
+
+  /* Load imbalance and rebalancing */
+  TEXT_OPT("load-pattern", LOAD_PATTERN, "none", "none|counts|ramp|hotspot", "Uneven elements per rank or element weights"),
+  UINT_OPT("load-factor", LOAD_FACTOR, "3", 1, 1000, "Heaviest over lightest share or weight"),
+  UINT_OPT("rebalance-every", REBALANCE_EVERY, "0", 0, 1000000, "Rebalance every this many timesteps (0: never)"),
+  TEXT_OPT("rebalance-policy", REBALANCE_POLICY, "diffusion", "diffusion|sfc|measure", "How elements move when rebalancing"),
+};
+
+static const int option_count = sizeof(options) / sizeof(options[0]);
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Option Values ---------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static void normalize(const char *name, char *out, size_t size)
+/* Lower case, '_' as '-', so ELEMENT_SIZE, element_size and element-size
+   are the same option. */
 {
-  params->PROBED_RANK = 0;	// The rank which shows its timing output
-  params->RK = 3;		// Number of Runge Kutta stages
-
-  params->TIMESTEPS = 3;		// Number of simulation timesteps
-  params->ELEMENT_SIZE = 5;	// Size of each element (cubic)
-  params->PHYSICAL_PARAMS = 5;	// Number of physics parameters tracked
-  params->ELEMENTS_X=2; 
-  params->ELEMENTS_Y=2; 
-  params->ELEMENTS_Z=2;		// Number of elements perprocess
-  params->CARTESIAN_X=2; 
-  params->CARTESIAN_Y=2; 
-  params->CARTESIAN_Z = 2;	
-
-/*  if (rank == params->PROBED_RANK) {
-    printf ("Command line arguments are processed in the following order.\nTIMESTEPS, ELEMENT_SIZE, ELEMENTS_X, ELEMENTS_Y, ELEMENTS_Z, CARTESIAN_X, CARTESIAN_Y, CARTESIAN_Z, PHYSICAL_PARAMS.\n\n");
-    printf ("Input args = %d\n\n",argc);
+  size_t i;
+  for (i = 0; name[i] != '\0' && i + 1 < size; i++) {
+    out[i] = (name[i] == '_') ? '-' : tolower((unsigned char) name[i]);
   }
-*/
-  if (argc > 10) {
-    if (rank == params->PROBED_RANK) { printf("Too many input arguments specified. Defaulting to preassigned values for all 9 parameters in params.h"); }
+  out[i] = '\0';
+}
+
+static const optiontype *find_option(const char *name)
+{
+  int i;
+  char key[64];
+
+  normalize(name, key, sizeof(key));
+  for (i = 0; i < option_count; i++) {
+    if (strcmp(options[i].name, key) == 0) { return &options[i]; }
   }
- 
-  if ( argc == 10) {
-    params->TIMESTEPS = atoi( argv[1] );
-    params->ELEMENT_SIZE = atoi( argv[2] );
-    params->ELEMENTS_X = atoi( argv[3] );
-    params->ELEMENTS_Y = atoi( argv[4] );
-    params->ELEMENTS_Z = atoi( argv[5] );
-    params->CARTESIAN_X = atoi( argv[6] );
-    params->CARTESIAN_Y = atoi( argv[7] );
-    params->CARTESIAN_Z = atoi( argv[8] );
-    params->PHYSICAL_PARAMS= atoi( argv[9] );
-//    if (rank == params->PROBED_RANK) { printf("Using all 9 user specified parameters. \n"); }
+  return NULL;
+}
+
+static int has_choice(const char *choices, const char *value)
+/* Nonzero if value is one of "a|b|c". */
+{
+  size_t n = strlen(value);
+  const char *c = choices;
+
+  while (c != NULL && *c != '\0') {
+    if (strncmp(c, value, n) == 0 && (c[n] == '|' || c[n] == '\0')) { return 1; }
+    c = strchr(c, '|');
+    if (c != NULL) { c++; }
   }
+  return 0;
+}
 
-  else if ( argc == 9) {
-    params->TIMESTEPS = atoi( argv[1] );
-    params->ELEMENT_SIZE = atoi( argv[2] );
-    params->ELEMENTS_X = atoi( argv[3] );
-    params->ELEMENTS_Y = atoi( argv[4] );
-    params->ELEMENTS_Z = atoi( argv[5] );
-    params->CARTESIAN_X = atoi( argv[6] );
-    params->CARTESIAN_Y = atoi( argv[7] );
-    params->CARTESIAN_Z = atoi( argv[8] );
-//    if (rank == params->PROBED_RANK) { printf("8 parameters specified. Using default values for others from params.h. \n"); }
+static int set_option(struct paramstype *params, const char *name, const char *value,
+                      const char *source)
+/* Parse value into the option called name. Returns 0, or 1 after printing
+   what was wrong and where it came from. */
+{
+  const optiontype *o = find_option(name);
+  char *end;
+  char *field;
+  long long n;
+  double d;
+
+  if (o == NULL) {
+    printf("%s: unknown option '%s'.\n", source, name);
+    return 1;
   }
+  field = (char *) params + o->offset;
+
+  switch (o->type) {
+  case OPT_UINT:
+    n = strtoll(value, &end, 0);
+    if (end == value || *end != '\0' || n < o->min || n > o->max) {
+      printf("%s: %s must be an integer in [%u, %u], not '%s'.\n", source, o->name, o->min, o->max, value);
+      return 1;
+    }
+    *(unsigned int *) field = (unsigned int) n;
+    break;
+
+  case OPT_REAL:
+    d = strtod(value, &end);
+    if (end == value || *end != '\0' || d < 0) {
+      printf("%s: %s must be a non-negative number, not '%s'.\n", source, o->name, value);
+      return 1;
+    }
+    *(double *) field = d;
+    break;
 
-  else if ( argc == 6) {
-    params->TIMESTEPS = atoi( argv[1] );
-    params->ELEMENT_SIZE = atoi( argv[2] );
-    params->ELEMENTS_X = atoi( argv[3] );
-    params->ELEMENTS_Y = atoi( argv[4] );
-    params->ELEMENTS_Z = atoi( argv[5] );
-//    if (rank == params->PROBED_RANK) { printf("5 parameters specified. Using default values for others from params.h. \n"); }
+  case OPT_TEXT:
+    if (o->choices != NULL && !has_choice(o->choices, value)) {
+      printf("%s: %s must be one of %s, not '%s'.\n", source, o->name, o->choices, value);
+      return 1;
+    }
+    if (strlen(value) >= o->size) {
+      printf("%s: %s is longer than %d characters.\n", source, o->name, (int) o->size - 1);
+      return 1;
+    }
+    snprintf(field, o->size, "%s", value);
+    break;
   }
+  return 0;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Config Files ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+/* Two formats, told apart by the first character:
+   - INI: "name = value" lines, '#' or ';' start a comment, [sections] are
+     ignored.
+   - JSON: an object of "name": value members; nested objects are walked
+     and their keys used as they are, so sections are ignored here too. */
 
-  else if ( argc == 3) {
-    params->TIMESTEPS = atoi( argv[1] );
-    params->ELEMENT_SIZE = atoi( argv[2] );
-//    if (rank == params->PROBED_RANK) { printf("2 parameters specified. Using default values for others from params.h. \n"); }
+static char *trim(char *s)
+{
+  char *e;
+  while (isspace((unsigned char) *s)) { s++; }
+  e = s + strlen(s);
+  while (e > s && isspace((unsigned char) e[-1])) { *--e = '\0'; }
+  return s;
+}
+
+static int read_ini(struct paramstype *params, char *text, const char *path)
+{
+  int errors = 0, lineno = 0;
+  char *line, *next, *eq, *comment, source[300];
+
+  for (line = text; line != NULL; line = next) {
+    next = strchr(line, '\n');
+    if (next != NULL) { *next++ = '\0'; }
+    lineno++;
+
+    line = trim(line);
+    if (*line == '\0' || *line == '#' || *line == ';' || *line == '[') { continue; }
+
+    snprintf(source, sizeof(source), "%s:%d", path, lineno);
+    eq = strchr(line, '=');
+    if (eq == NULL) {
+      printf("%s: expected name = value.\n", source);
+      errors++;
+      continue;
+    }
+    *eq = '\0';
+    comment = strpbrk(eq + 1, "#;");
+    if (comment != NULL) { *comment = '\0'; }
+    errors += set_option(params, trim(line), trim(eq + 1), source);
   }
+  return errors;
+}
 
-  else if ( argc == 2) {
-    params->TIMESTEPS = atoi( argv[1] );
-//    if (rank == params->PROBED_RANK) { printf("1 parameter specified. Using default values for others from params.h. \n"); }
+static int json_token(char **p, char *out, size_t size)
+/* Read a JSON string (unquoted) or bare scalar at *p into out. */
+{
+  size_t n = 0;
+  char *s = *p;
+
+  if (*s == '"') {
+    for (s++; *s != '\0' && *s != '"'; s++) {
+      if (*s == '\\' && s[1] != '\0') { s++; }
+      if (n + 1 < size) { out[n++] = *s; }
+    }
+    if (*s != '"') { return 1; }
+    s++;
+  } else {
+    for (; *s != '\0' && *s != ',' && *s != '}' && !isspace((unsigned char) *s); s++) {
+      if (n + 1 < size) { out[n++] = *s; }
+    }
+    if (n == 0) { return 1; }
   }
-  
-  else if ( argc == 1) {
-    if (rank == params->PROBED_RANK) { printf("No input arguments specified by user. Using defaults from params.h. \n"); }
+  out[n] = '\0';
+  *p = s;
+  return 0;
+}
+
+static int read_json_object(struct paramstype *params, char **p, const char *path)
+/* Walk one object starting at '{'. Returns the number of errors. */
+{
+  int errors = 0;
+  char key[64], value[300], *s = *p;
+
+  s++;
+  for (;;) {
+    while (isspace((unsigned char) *s) || *s == ',') { s++; }
+    if (*s == '}') { s++; break; }
+    if (*s != '"' || json_token(&s, key, sizeof(key)) != 0) {
+      printf("%s: malformed JSON near '%.20s'.\n", path, s);
+      return errors + 1;
+    }
+    while (isspace((unsigned char) *s)) { s++; }
+    if (*s != ':') {
+      printf("%s: expected ':' after \"%s\".\n", path, key);
+      return errors + 1;
+    }
+    s++;
+    while (isspace((unsigned char) *s)) { s++; }
+
+    if (*s == '{') {
+      errors += read_json_object(params, &s, path);
+    } else if (json_token(&s, value, sizeof(value)) == 0) {
+      /* Booleans are 0/1 switches here. */
+      if (strcmp(value, "true") == 0) { snprintf(value, sizeof(value), "1"); }
+      if (strcmp(value, "false") == 0) { snprintf(value, sizeof(value), "0"); }
+      errors += set_option(params, key, value, path);
+    } else {
+      printf("%s: malformed value of \"%s\".\n", path, key);
+      return errors + 1;
+    }
   }
+  *p = s;
+  return errors;
+}
 
-  else {
-    if (rank == params->PROBED_RANK) { printf("Invalid number of arguments. Command line parameter values will not be used. Using defaults from params.h. \n"); }
+static int read_config(struct paramstype *params, const char *path)
+/* Apply every option in the file at path. Returns the number of errors. */
+{
+  int errors;
+  long size;
+  char *text, *start;
+  FILE *f = fopen(path, "r");
+
+  if (f == NULL) {
+    printf("Could not open config file %s.\n", path);
+    return 1;
   }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  text = malloc(size + 1);
+  assert(text != NULL);
+  size = fread(text, 1, size, f);
+  text[size] = '\0';
+  fclose(f);
+
+  start = trim(text);
+  if (*start == '{') { errors = read_json_object(params, &start, path); }
+  else { errors = read_ini(params, start, path); }
+
+  free(text);
+  return errors;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Setup ------------------------------------ */
+/* ------------------------------------------------------------------------- */
 
+static void print_usage(void)
+{
+  int i;
+
+  printf("Usage: cmtbonebe [--config FILE] [--name=value ...] [TIMESTEPS [ELEMENT_SIZE [EX EY EZ [CX CY CZ [PARAMS]]]]]\n\n"
+         "Sources, later ones win: defaults, config file (--config or CMT_CONFIG), CMT_* environment,\n"
+         "--name=value flags, positional arguments. --dump-config prints the result as a config file.\n\n");
+  for (i = 0; i < option_count; i++) {
+    printf("  --%-18s %-12s %s", options[i].name,
+           options[i].type == OPT_TEXT && options[i].choices ? options[i].choices :
+           options[i].type == OPT_TEXT ? "text" : options[i].type == OPT_REAL ? "real" : "integer",
+           options[i].help);
+    printf(" (default %s)\n", *options[i].fallback ? options[i].fallback : "none");
+  }
+}
+
+static void dump_config(struct paramstype *params)
+/* The effective options as an INI file that reproduces this run. */
+{
+  int i;
+  char *field;
+
+  printf("# cmtbonebe configuration\n");
+  for (i = 0; i < option_count; i++) {
+    field = (char *) params + options[i].offset;
+    printf("%s = ", options[i].name);
+    if (options[i].type == OPT_UINT) { printf("%u\n", *(unsigned int *) field); }
+    else if (options[i].type == OPT_REAL) { printf("%.17g\n", *(double *) field); }
+    else { printf("%s\n", field); }
+  }
+}
+
+static int parse_all(int argc, char *argv[], struct paramstype *params, int *dump)
+/* Every source in order of precedence, on one rank. Returns the number of
+   errors. */
+{
+  int i, errors = 0, positional = 0;
+  const char *config = getenv("CMT_CONFIG");
+  const char *positional_names[] = { "timesteps", "element-size", "elements-x", "elements-y",
+                                     "elements-z", "cartesian-x", "cartesian-y", "cartesian-z",
+                                     "physical-params" };
+  char *value, name[64], env[80];
+
+  /* Defaults. */
+  for (i = 0; i < option_count; i++) {
+    errors += set_option(params, options[i].name, options[i].fallback, "default");
+  }
+
+  /* The config file named on the command line wins over CMT_CONFIG. */
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) { config = argv[i + 1]; }
+    else if (strncmp(argv[i], "--config=", 9) == 0) { config = argv[i] + 9; }
+  }
+  if (config != NULL && *config != '\0') { errors += read_config(params, config); }
+
+  /* Environment: CMT_ plus the upper case name. */
+  for (i = 0; i < option_count; i++) {
+    size_t c;
+    snprintf(env, sizeof(env), "CMT_%s", options[i].name);
+    for (c = 4; env[c] != '\0'; c++) { env[c] = (env[c] == '-') ? '_' : toupper((unsigned char) env[c]); }
+    value = getenv(env);
+    if (value != NULL && *value != '\0') { errors += set_option(params, options[i].name, value, env); }
+  }
+
+  /* Command line: --name=value, --name value, and the historical
+     positional order. */
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--config") == 0) { i++; continue; }
+    if (strncmp(argv[i], "--config=", 9) == 0) { continue; }
+    if (strcmp(argv[i], "--dump-config") == 0) { *dump = 1; continue; }
+
+    if (strncmp(argv[i], "--", 2) == 0) {
+      snprintf(name, sizeof(name), "%s", argv[i] + 2);
+      value = strchr(name, '=');
+      if (value != NULL) {
+        *value++ = '\0';
+        value = argv[i] + 2 + (value - name);
+      } else if (i + 1 < argc) {
+        value = argv[++i];
+      } else {
+        printf("Option --%s needs a value.\n", name);
+        errors++;
+        continue;
+      }
+      errors += set_option(params, name, value, "command line");
+    }
+    else if (positional < (int) (sizeof(positional_names) / sizeof(positional_names[0]))) {
+      errors += set_option(params, positional_names[positional++], argv[i], "command line");
+    }
+    else {
+      printf("Too many positional arguments at '%s'.\n", argv[i]);
+      errors++;
+    }
+  }
+
+  return errors;
+}
+
+static int validate(struct paramstype *params, int ranks)
+/* Checks across options, and the ones that need the communicator. */
+{
+  int i, errors = 0, scaling = (strcmp(params->MODE, "strong") == 0 || strcmp(params->MODE, "weak") == 0);
+  unsigned long long cart = (unsigned long long) params->CARTESIAN_X * params->CARTESIAN_Y *
+                            params->CARTESIAN_Z;
+  long long elements = (long long) params->ELEMENTS_X * params->ELEMENTS_Y * params->ELEMENTS_Z;
+  long long face = (long long) params->ELEMENTS_Y * params->ELEMENTS_Z, face_values;
+
+  /* A scaling study picks its own decompositions (scaling.h). */
+  if (cart != (unsigned long long) ranks && !scaling) {
+    printf("The cartesian grid %ux%ux%u has %llu processes, but MPI runs %d.\n",
+           params->CARTESIAN_X, params->CARTESIAN_Y, params->CARTESIAN_Z, cart, ranks);
+    errors++;
+  }
+  /* Element counts and face buffer sizes are ints (set_decomposition,
+     new_vector). */
+  if ((long long) params->ELEMENTS_X * params->ELEMENTS_Z > face) { face = (long long) params->ELEMENTS_X * params->ELEMENTS_Z; }
+  if ((long long) params->ELEMENTS_X * params->ELEMENTS_Y > face) { face = (long long) params->ELEMENTS_X * params->ELEMENTS_Y; }
+  face_values = face * params->ELEMENT_SIZE * params->ELEMENT_SIZE * params->PHYSICAL_PARAMS;
+  if (elements > INT_MAX || face_values > INT_MAX) {
+    printf("elements %ux%ux%u give %lld elements and faces of %lld values per process; both must be at most %d.\n",
+           params->ELEMENTS_X, params->ELEMENTS_Y, params->ELEMENTS_Z, elements, face_values, INT_MAX);
+    errors++;
+  }
+  if (params->PROBED_RANK >= (unsigned int) ranks) {
+    printf("probed-rank %u is not below the number of processes (%d).\n", params->PROBED_RANK, ranks);
+    errors++;
+  }
+  if (strcmp(params->PRECISION, DTYPE_NAME) != 0) {
+    printf("precision %s was requested, but this binary is built for %s (make PRECISION=%s).\n",
+           params->PRECISION, DTYPE_NAME, params->PRECISION);
+    errors++;
+  }
+  if ((strcmp(params->LOAD_PATTERN, "none") != 0 || params->REBALANCE_EVERY > 0) &&
+      (params->CHECKPOINT_EVERY > 0 || params->RESTART || params->INITIAL_STATE[0] != '\0')) {
+    printf("load-pattern and rebalance-every do not support checkpoints, restart or initial-state yet.\n");
+    errors++;
+  }
+  if (params->RESTART && strcmp(params->VERIFY, "record") == 0) {
+    printf("verify record needs every stage; record from a run without restart.\n");
+    errors++;
+  }
+  if (params->COMM_THREAD &&
+      (strcmp(params->LOAD_PATTERN, "none") != 0 || params->REBALANCE_EVERY > 0)) {
+    printf("comm-thread does not support load-pattern or rebalance-every yet.\n");
+    errors++;
+  }
+  if (params->DATAFLOW &&
+      (strcmp(params->LOAD_PATTERN, "none") != 0 || params->REBALANCE_EVERY > 0)) {
+    printf("dataflow does not support load-pattern or rebalance-every yet.\n");
+    errors++;
+  }
+  if (params->GHOST_DEPTH > 0 &&
+      (strcmp(params->LOAD_PATTERN, "none") != 0 || params->REBALANCE_EVERY > 0 ||
+       params->COMM_THREAD || params->DATAFLOW)) {
+    printf("ghost-depth does not support load-pattern, rebalance-every, comm-thread or dataflow yet.\n");
+    errors++;
+  }
+  if (scaling && (strcmp(params->VERIFY, "off") != 0 || strcmp(params->OUTPUT, "text") != 0 ||
+                  params->CHECKPOINT_EVERY > 0 || params->RESTART || params->INITIAL_STATE[0] != '\0')) {
+    printf("A scaling study does not support verify, json/csv output, checkpoints, restart or initial-state.\n");
+    errors++;
+  }
+  if (params->COMM_CPU[0] != '\0') {
+    char *end;
+    long cpu = strtol(params->COMM_CPU, &end, 10);
+    if (end == params->COMM_CPU || *end != '\0' || cpu < 0 || cpu > 65535) {
+      printf("comm-cpu must be a cpu number in [0, 65535], not '%s'.\n", params->COMM_CPU);
+      errors++;
+    }
+  }
+  if (find_kernels(params->KERNEL) == NULL) {
+    printf("kernel must be one of ");
+    for (i = 0; i < kernel_variant_count; i++) { printf("%s%s", i ? "|" : "", kernel_variants[i].name); }
+    printf(", not '%s'.\n", params->KERNEL);
+    errors++;
+  }
+  if (find_halo(params->HALO) == NULL) {
+    printf("halo must be one of ");
+    for (i = 0; i < halo_backend_count; i++) { printf("%s%s", i ? "|" : "", halo_backends[i].name); }
+    printf(", not '%s'.\n", params->HALO);
+    errors++;
+  }
+  if (params->COUNTERS && params->PROFILE < 2) {
+    printf("counters needs profile 2.\n");
+    errors++;
+  }
+  return errors;
+}
+
+int setup_parameters(int argc, char *argv[], int rank, struct paramstype *params)
+/* Rank 0 reads every source and checks the result; every rank then gets
+   the same parameters. Returns PARAMS_OK, PARAMS_EXIT after --help or
+   --dump-config, or PARAMS_ERROR. Collective on MPI_COMM_WORLD. */
+{
+  int i, ranks, status = PARAMS_OK, dump = 0;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+  memset(params, 0, sizeof(struct paramstype));
+
+  if (rank == 0) {
+    for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) { status = PARAMS_EXIT; }
+    }
+
+    if (status == PARAMS_EXIT) { print_usage(); }
+    else if (parse_all(argc, argv, params, &dump) + validate(params, ranks) > 0) {
+      printf("Invalid parameters; see cmtbonebe --help.\n");
+      status = PARAMS_ERROR;
+    }
+    else if (dump) {
+      dump_config(params);
+      status = PARAMS_EXIT;
+    }
+  }
+
+  MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if (status != PARAMS_OK) { return status; }
+  MPI_Bcast(params, sizeof(struct paramstype), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+  /* Defaults that depend on other options or on the rank's environment. */
+  if (params->THREADS == 0) {
+#ifdef _OPENMP
+    params->THREADS = omp_get_max_threads();
+#else
+    params->THREADS = 1;
+#endif
+  }
+  if (params->OUTPUT_FILE[0] == '\0') {
+    snprintf(params->OUTPUT_FILE, sizeof(params->OUTPUT_FILE), "results.%s", params->OUTPUT);
+  }
+
+  int cart[3] = { params->CARTESIAN_X, params->CARTESIAN_Y, params->CARTESIAN_Z };
+  int elements[3] = { params->ELEMENTS_X, params->ELEMENTS_Y, params->ELEMENTS_Z };
+  set_decomposition(params, cart, elements);
+  params->FACE_SIZE = params->ELEMENT_SIZE * params->ELEMENT_SIZE; 
+  params->MAPPED = (strcmp(params->LOAD_PATTERN, "none") != 0 || params->REBALANCE_EVERY > 0);
+
+  return PARAMS_OK;
+}
+
+
+void set_decomposition(struct paramstype *params, const int *cart, const int *elements)
+/* Set CARTESIAN_* and ELEMENTS_* to another decomposition, and the fields
+   derived from them. */
+{
+  params->CARTESIAN_X = cart[0];
+  params->CARTESIAN_Y = cart[1];
+  params->CARTESIAN_Z = cart[2];
+  params->ELEMENTS_X = elements[0];
+  params->ELEMENTS_Y = elements[1];
+  params->ELEMENTS_Z = elements[2];
   params->ELEMENTS_PER_PROCESS = params->ELEMENTS_X * params->ELEMENTS_Y * params->ELEMENTS_Z;
   params->ELEMENTS_ON_X_FACE = params->ELEMENTS_Y * params->ELEMENTS_Z;
   params->ELEMENTS_ON_Y_FACE = params->ELEMENTS_X * params->ELEMENTS_Z;
   params->ELEMENTS_ON_Z_FACE = params->ELEMENTS_X * params->ELEMENTS_Y;
-  params->FACE_SIZE = params->ELEMENT_SIZE * params->ELEMENT_SIZE; 
-
 }
 
 
@@ -132,5 +659,3 @@ void print_parameters(struct paramstype *params) {
 */
     printf ( "%d,%d,%d,%d,%d,%d,%d,%d,%d\n", params->TIMESTEPS, params->ELEMENT_SIZE, params->ELEMENTS_X, params->ELEMENTS_Y, params->ELEMENTS_Z, params->CARTESIAN_X, params->CARTESIAN_Y, params->CARTESIAN_Z, params->PHYSICAL_PARAMS );
 }
-
-
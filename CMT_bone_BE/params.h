@@ -28,7 +28,6 @@ Original:
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <mpi.h>
 
 
 struct paramstype {
@@ -36,24 +35,82 @@ struct paramstype {
 /* -------------------------- Machine/Primary Parameters --------------------------- */
   unsigned int PROBED_RANK; 	// The rank which shows its timing output
   unsigned int CARTESIAN_X, CARTESIAN_Y, CARTESIAN_Z;	// Number of processes in each dimension. MPI must be run with (product of these numbers) processes.
+  unsigned int THREADS;		// Number of OpenMP threads per rank
+  char AFFINITY[64];		// Core binding policy: none, compact, scatter or an explicit cpu list
+  unsigned int PROFILE;		// 0: per-timestep totals, 1: Compute(A)/comm/Compute(B) per stage, 2: plus per-kernel regions
+  unsigned int COUNTERS;	// Collect perf_event counters for each region (needs PROFILE 2)
+  char PERF_FLOPS_EVENT[32];	// Raw perf event code that counts FLOPs on this CPU ("" for none)
+  unsigned int REPORT_EVERY;	// Print cross-rank timing statistics every this many timesteps (0: only at the end)
+  unsigned int ROOFLINE;		// Calibrate bandwidth and peak at startup and print a roofline report
+  unsigned int STREAM_MB;	// Total size of the STREAM calibration arrays per rank
+  char KERNEL[32];		// Kernel variant used for Compute (A) and (B)
+  unsigned int TILE;		// Blocks per Compute (A) tile: 1 one at a time, 0 sized to fit L2
+  char OUTPUT[8];		// Results format: text, json or csv
+  char OUTPUT_FILE[256];	// Where json/csv results are written ("-" for stdout)
+  char MODE[16];		// run: the full mini-app, halo: exchange-only benchmark, strong/weak: scaling study
+  char HALO[16];		// Exchange backend: blocking, sendrecv, nonblocking or pipelined
+  unsigned int COMM_THREAD;	// Run the exchange on a dedicated thread, overlapped with Compute (A)
+  char COMM_CPU[16];		// Cpu the communication thread is bound to (empty: one AFFINITY leaves free)
+  unsigned int DATAFLOW;		// Update each element in Compute (B) as soon as its faces are in
+  unsigned int GHOST_DEPTH;	// Exchange whole elements of ranks this many steps away every this many stages (0: faces every stage)
+  unsigned int FOLD_FACES;	// Average the received faces into R's face planes (0: drop them, as the original mini-app)
+  char HALO_SIZES[64];		// ELEMENT_SIZE sweep of the halo benchmark, "A:B[:S]" or a list
+  char HALO_FACES[64];		// Elements-per-face sweep of the halo benchmark
+  unsigned int HALO_REPS;	// Timed repetitions per halo benchmark point
+  char SCALING_RANKS[64];	// Rank counts of a scaling study, "A:B[:S]" or a list (empty: powers of two and all)
+  char VERIFY[8];		// Per-stage checksums: off, record (store a reference) or check (compare to it)
+  char VERIFY_FILE[256];	// Reference checksum file
+  double VERIFY_RTOL;		// Relative tolerance of the check (0: default)
+  unsigned int VERIFY_ULPS;	// Tolerance in units of dtype's epsilon, overrides VERIFY_RTOL
+  char AUTOTUNE[8];		// Autotune KERNEL, TILE, ELEMENT_ORDER and HALO: off, auto (reuse AUTOTUNE_FILE) or force (always measure)
+  char AUTOTUNE_FILE[256];	// Per-machine tuning results
+  unsigned int AUTOTUNE_REPS;	// Timed trials per candidate
+  unsigned int CHECKPOINT_EVERY;	// Write Q to a shared checkpoint file every this many timesteps (0: never)
+  char CHECKPOINT_FILE[256];	// Checkpoint files are this name plus .0 and .1
+  unsigned int RESTART;		// Start from the newest complete checkpoint, if there is one
+  char INITIAL_STATE[256];	// Map Q from this state file instead of generating it (empty: generate)
+  char DIAGNOSTICS[8];		// In-situ statistics of off, r or q
+  unsigned int DIAGNOSTICS_EVERY;	// Gather them every this many timesteps
+  unsigned int DIAGNOSTICS_OVERLAP;	// Hide the reduction behind the next Compute (A)
+  char DIAGNOSTICS_FILE[256];	// One CSV row per parameter and reduction (empty: none)
+  char LOAD_PATTERN[16];	// Uneven load: none, counts (elements per rank), ramp or hotspot (element weights)
+  unsigned int LOAD_FACTOR;	// Heaviest over lightest rank share or element weight
+  unsigned int REBALANCE_EVERY;	// Rebalance elements across ranks every this many timesteps (0: never)
+  char REBALANCE_POLICY[16];	// diffusion, sfc or measure
+  char ELEMENT_ORDER[16];	// Storage order of a rank's elements: lexicographic, morton or hilbert
 
 /* -------------------------- Physics/Application Parameters --------------------------- */
   unsigned int TIMESTEPS;		// Number of simulation timesteps
   unsigned int RK;			// Number of Runge Kutta stages
   unsigned int ELEMENT_SIZE;		// Size of each element (cubic)
   unsigned int PHYSICAL_PARAMS;		// Number of physics parameters tracked
+  char PRECISION[8];			// single or double; checked against the build
   unsigned int ELEMENTS_X, ELEMENTS_Y, ELEMENTS_Z;	// Number of elements per process in each dimension
   unsigned int ELEMENTS_PER_PROCESS;
   unsigned int ELEMENTS_ON_X_FACE, ELEMENTS_ON_Y_FACE, ELEMENTS_ON_Z_FACE;
   unsigned int FACE_SIZE;
+  unsigned int MAPPED;			// Elements follow explicit ownership and face maps (balance.h)
   
 };
 
 
-/* Set machine & application parameters from user-specified command line arguments*/
-void setup_parameters(int argc, char *argv[], int rank, struct paramstype *params);
+/* Results of setup_parameters. */
+enum { PARAMS_OK, PARAMS_EXIT, PARAMS_ERROR };
+
+/* Set machine & application parameters from, in increasing precedence, the
+   defaults, a config file (--config FILE or CMT_CONFIG, INI or JSON), CMT_*
+   environment variables, --name=value flags and the positional arguments
+   TIMESTEPS ELEMENT_SIZE EX EY EZ CX CY CZ PHYSICAL_PARAMS. Rank 0 parses
+   and validates, every rank receives the result. Returns PARAMS_EXIT after
+   --help or --dump-config and PARAMS_ERROR on invalid input, in which case
+   the caller should finalize and exit. Collective on MPI_COMM_WORLD. */
+int setup_parameters(int argc, char *argv[], int rank, struct paramstype *params);
 
 void print_parameters(struct paramstype *params);
 
+/* Set CARTESIAN_* and ELEMENTS_* to another decomposition, and the fields
+   derived from them. */
+void set_decomposition(struct paramstype *params, const int *cart, const int *elements);
+
 #endif
 
@@ -0,0 +1,66 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RNG_H_
+#define RNG_H_
+
+/* Counter-based random numbers: every value is a pure function of a key and
+   a counter, so the state of a run does not depend on the order (or the
+   thread) in which elements are filled. Keys are built by folding indices
+   into a stream key, e.g. rng_key(rng_key(rng_stream(RNG_Q), gid), b). */
+
+typedef unsigned long long rngkey;
+
+/* Streams, one per kind of generated data. */
+enum { RNG_Q = 1, RNG_RX, RNG_KERNEL, RNG_CONV, RNG_HALO, RNG_TUNE };
+
+/* Base seed of every stream. */
+#define RNG_SEED 11ULL
+
+/* The splitmix64 finalizer: a bijective 64-bit mix. */
+static inline rngkey rng_mix(rngkey x)
+{
+  x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static inline rngkey rng_stream(int stream)
+{
+  return rng_mix(RNG_SEED * 0x9e3779b97f4a7c15ULL + (rngkey) stream);
+}
+
+/* Derive the key of a child (an element, block, stage ...) of parent. */
+static inline rngkey rng_key(rngkey parent, rngkey child)
+{
+  return rng_mix(parent ^ rng_mix(child + 0x9e3779b97f4a7c15ULL));
+}
+
+/* Value number counter of key, uniform over [0, 1). */
+static inline double rng_uniform(rngkey key, rngkey counter)
+{
+  return (rng_mix(key + counter * 0x9e3779b97f4a7c15ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+#endif
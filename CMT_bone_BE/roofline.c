@@ -0,0 +1,226 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <mpi.h>
+
+#include "roofline.h"
+#include "params.h"
+#include "dstructs.h"
+#include "timers.h"
+#include "utils.h"
+#include "flux.h"
+
+
+static calibrationtype machine = { 0, 0, 0 };
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Work Model ------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+void region_work(int region, MPI_Comm comm, struct paramstype *params,
+                 double *flops, double *bytes)
+/* Total FLOPs and bytes of a region on this rank for the whole run. */
+{
+  int axis, below, above, neighbors;
+  double face, stages = (double) params->TIMESTEPS * params->RK;
+  unsigned int EoF[3] = { params->ELEMENTS_ON_X_FACE, params->ELEMENTS_ON_Y_FACE,
+                          params->ELEMENTS_ON_Z_FACE };
+
+  if (region <= REGION_RK) {
+    long calls = region_total(region).calls;
+    *flops = calls * kernel_flops(region, params);
+    *bytes = calls * kernel_bytes(region, params);
+    return;
+  }
+
+  /* Exchange regions: one message per existing neighbor per stage. */
+  *flops = 0;
+  *bytes = 0;
+  for (axis = 0; axis < 3; axis++) {
+    MPI_Cart_shift(comm, axis, 1, &below, &above);
+    neighbors = (below != MPI_PROC_NULL) + (above != MPI_PROC_NULL);
+    face = (double) EoF[axis] * params->PHYSICAL_PARAMS * params->FACE_SIZE;
+
+    switch (region) {
+    case REGION_PACK:   *bytes += stages * neighbors * 2 * face * sizeof(dtype); break;
+    case REGION_SEND:
+    case REGION_RECV:   *bytes += stages * neighbors * face * sizeof(dtype); break;
+    case REGION_UNPACK: if (!params->FOLD_FACES) { break; }
+                        *bytes += stages * neighbors * 3 * face * sizeof(dtype);
+                        *flops += stages * neighbors * 2 * face; break;
+    }
+  }
+}
+
+double block_flops(struct paramstype *params)
+/* FLOPs of one block through one full stage. */
+{
+  int k;
+  double flops = 0;
+  for (k = 0; k < KERNEL_COUNT; k++) { flops += kernel_flops(k, params); }
+  return flops;
+}
+
+double block_bytes(struct paramstype *params)
+/* Compulsory memory traffic of one block through one stage: Compute (A)
+   reads Q and writes R, Compute (B) reads R and Q and writes R. */
+{
+  double N = params->ELEMENT_SIZE;
+  return 5 * N * N * N * sizeof(dtype);
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Calibration ------------------------------ */
+/* ------------------------------------------------------------------------- */
+
+#define CALIBRATION_REPS 5
+#define PEAK_LANES 32
+#define PEAK_ITERATIONS 2000000
+
+static double stream_triad(struct paramstype *params)
+/* Best-of-N STREAM triad bandwidth in GB/s (24 bytes per element, no
+   write-allocate traffic counted, as in STREAM). */
+{
+  long i, n = (long) params->STREAM_MB * 1024 * 1024 / (3 * sizeof(double));
+  int rep;
+  double best = 0, seconds, s = 3.0;
+  double *a = malloc(sizeof(double) * n);
+  double *b = malloc(sizeof(double) * n);
+  double *c = malloc(sizeof(double) * n);
+  struct timespec t0, t1;
+
+  #pragma omp parallel for schedule(static)
+  for (i = 0; i < n; i++) { a[i] = 0; b[i] = 1; c[i] = 2; }
+
+  for (rep = 0; rep < CALIBRATION_REPS; rep++) {
+    t0 = now();
+    #pragma omp parallel for schedule(static)
+    for (i = 0; i < n; i++) { a[i] = b[i] + s * c[i]; }
+    t1 = now();
+    seconds = tdiff(t0, t1);
+    if (seconds > 0 && 24.0 * n / seconds / 1E9 > best) { best = 24.0 * n / seconds / 1E9; }
+  }
+
+  free(a);
+  free(b);
+  free(c);
+  return best;
+}
+
+static double fma_peak(struct paramstype *params)
+/* Best-of-N multiply-add throughput in GFLOP/s. Independent lanes let the
+   compiler vectorize and pipeline at whatever ISA the build targets. */
+{
+  int rep;
+  double best = 0, seconds, sink = 0;
+  struct timespec t0, t1;
+
+  for (rep = 0; rep < CALIBRATION_REPS; rep++) {
+    t0 = now();
+    #pragma omp parallel reduction(+:sink)
+    {
+      double x[PEAK_LANES];
+      int i, j;
+      for (j = 0; j < PEAK_LANES; j++) { x[j] = j; }
+      for (i = 0; i < PEAK_ITERATIONS; i++) {
+        for (j = 0; j < PEAK_LANES; j++) { x[j] = x[j] * 0.999999 + 1E-6; }
+      }
+      for (j = 0; j < PEAK_LANES; j++) { sink += x[j]; }
+    }
+    t1 = now();
+    seconds = tdiff(t0, t1);
+    if (seconds > 0) {
+      double rate = 2.0 * PEAK_LANES * PEAK_ITERATIONS * params->THREADS / seconds / 1E9;
+      if (rate > best) { best = rate; }
+    }
+  }
+
+  /* Keep the loop alive. */
+  if (sink == 42) { printf(" "); }
+  return best;
+}
+
+void calibrate_machine(MPI_Comm comm, struct paramstype *params)
+/* Measure this rank's memory bandwidth and FLOP rate. Collective on comm. */
+{
+  MPI_Barrier(comm);
+  machine.bandwidth = stream_triad(params);
+  MPI_Barrier(comm);
+  machine.peak = fma_peak(params);
+  machine.valid = 1;
+}
+
+calibrationtype machine_calibration(void)
+/* The last calibration, or one with valid == 0. */
+{
+  return machine;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* -------------------------------- Report --------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+void print_roofline(MPI_Comm comm, struct paramstype *params)
+/* Print this rank's per-region rates and, if calibrated, the roofline. */
+{
+  int r;
+  double flops, bytes, wall, gflops, gbps, ai, roof;
+
+  if (params->PROFILE < 2) { return; }
+
+  if (machine.valid) {
+    printf("Calibration: stream_triad %.2f GB/s, peak %.2f GFLOP/s, ridge %.3f flop/byte\n",
+           machine.bandwidth, machine.peak, machine.peak / machine.bandwidth);
+  }
+
+  printf("Kernel,gflop,gbyte,gflop/s,gbyte/s,flop/byte");
+  if (machine.valid) { printf(",roof_gflop/s,of_roof,bound"); }
+  printf("\n");
+
+  for (r = 0; r < REGION_COUNT; r++) {
+    region_work(r, comm, params, &flops, &bytes);
+
+    /* Thread-summed seconds over threads approximates the wall time the
+       region took on this rank. */
+    wall = region_total(r).seconds / params->THREADS;
+    gflops = wall > 0 ? flops / wall / 1E9 : 0;
+    gbps = wall > 0 ? bytes / wall / 1E9 : 0;
+    ai = bytes > 0 ? flops / bytes : 0;
+
+    printf("%s,%.6f,%.6f,%.3f,%.3f,%.3f", region_names[r], flops / 1E9, bytes / 1E9, gflops, gbps, ai);
+    if (machine.valid && flops == 0) {
+      printf(",,,n/a");
+    } else if (machine.valid) {
+      roof = fmin(machine.peak, ai * machine.bandwidth);
+      printf(",%.3f,%.3f,%s", roof, roof > 0 ? gflops / roof : 0.0,
+             (ai * machine.bandwidth < machine.peak) ? "memory" : "compute");
+    }
+    printf("\n");
+  }
+}
@@ -0,0 +1,74 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ROOFLINE_H_
+#define ROOFLINE_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+
+
+/* ----------------------------- Work Model -------------------------------- */
+
+/* Total FLOPs and bytes of a region on this rank for the whole run. Compute
+   regions use kernel_flops/kernel_bytes (flux.h) times the calls recorded;
+   pack, send, recv
+   and unpack are derived from the face sizes and the neighbors this rank
+   has in comm. */
+void region_work(int region, MPI_Comm comm, struct paramstype *params,
+                 double *flops, double *bytes);
+
+/* FLOPs and compulsory memory bytes of one block through one full stage
+   (Compute (A) plus Compute (B)). */
+double block_flops(struct paramstype *params);
+double block_bytes(struct paramstype *params);
+
+
+/* ----------------------------- Calibration ------------------------------- */
+
+typedef struct {
+  int valid;
+  double bandwidth;   // GB/s, best STREAM triad over all threads of a rank
+  double peak;        // GFLOP/s, best FMA throughput over all threads of a rank
+} calibrationtype;
+
+/* Measure this rank's memory bandwidth and FLOP rate with params->THREADS
+   threads, all ranks at once so that shared sockets are loaded as in the
+   run. Collective on comm. */
+void calibrate_machine(MPI_Comm comm, struct paramstype *params);
+
+/* The last calibration, or one with valid == 0. */
+calibrationtype machine_calibration(void);
+
+
+/* ------------------------------- Report ---------------------------------- */
+
+/* Print this rank's achieved GFLOP/s, GB/s and arithmetic intensity per
+   region and, if calibrated, the roofline bound and the fraction of it
+   reached. Needs PROFILE >= 2. */
+void print_roofline(MPI_Comm comm, struct paramstype *params);
+
+#endif
@@ -0,0 +1,179 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "scaling.h"
+#include "params.h"
+#include "halo.h"
+
+/* Most rank counts and runs of one study. */
+#define SCALING_COUNTS 64
+#define SCALING_RUNS 4096
+
+
+/* ------------------------------------------------------------------------- */
+/* ---------------------------- Decompositions ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+  int ranks;
+  int cart[3];
+  int elements[3];            // per rank
+  double seconds;             // time loop of the slowest rank
+} scalingpoint;
+
+static int rank_counts(const char *spec, int world, int *out)
+/* The rank counts of SCALING_RANKS that fit in world, ascending; by default
+   the powers of two below world, and world. */
+{
+  int i, n = 0, all[SCALING_COUNTS], count;
+
+  if (spec[0] == '\0') {
+    for (i = 1; i < world && n < SCALING_COUNTS - 1; i *= 2) { out[n++] = i; }
+    out[n++] = world;
+    return n;
+  }
+
+  count = parse_sweep(spec, all, SCALING_COUNTS);
+  for (i = 0; i < count; i++) {
+    if (all[i] >= 1 && all[i] <= world && (n == 0 || all[i] > out[n - 1])) { out[n++] = all[i]; }
+  }
+  return n;
+}
+
+static int decompositions(int ranks, int strong, const int *global, const int *per_rank,
+                          scalingpoint *out, int max)
+/* Every cartesian grid of ranks processes, by x and then y extent; for
+   strong scaling only those that split global evenly. */
+{
+  int a, n = 0, c[3];
+
+  for (c[0] = 1; c[0] <= ranks; c[0]++) {
+    if (ranks % c[0] != 0) { continue; }
+    for (c[1] = 1; c[1] <= ranks / c[0]; c[1]++) {
+      if ((ranks / c[0]) % c[1] != 0) { continue; }
+      c[2] = ranks / c[0] / c[1];
+
+      if (strong && (global[0] % c[0] || global[1] % c[1] || global[2] % c[2])) { continue; }
+      if (n == max) { return n; }
+
+      out[n].ranks = ranks;
+      out[n].seconds = 0;
+      for (a = 0; a < 3; a++) {
+        out[n].cart[a] = c[a];
+        out[n].elements[a] = strong ? global[a] / c[a] : per_rank[a];
+      }
+      n++;
+    }
+  }
+  return n;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Scaling Study ---------------------------- */
+/* ------------------------------------------------------------------------- */
+
+int run_scaling(MPI_Comm world, struct paramstype *params, scalingrun run)
+/* Run every decomposition on the first ranks of world and print the
+   table on rank 0. Collective on world. */
+{
+  int i, k, n = 0, rank, size, failed = 0, counts[SCALING_COUNTS], ncounts;
+  int strong = (strcmp(params->MODE, "strong") == 0);
+  int per_rank[3] = { params->ELEMENTS_X, params->ELEMENTS_Y, params->ELEMENTS_Z };
+  int global[3] = { params->ELEMENTS_X * params->CARTESIAN_X, params->ELEMENTS_Y * params->CARTESIAN_Y,
+                    params->ELEMENTS_Z * params->CARTESIAN_Z };
+  double base, best, dofs;
+  scalingpoint *P = malloc(sizeof(scalingpoint) * SCALING_RUNS);
+  MPI_Comm sub;
+
+  MPI_Comm_rank(world, &rank);
+  MPI_Comm_size(world, &size);
+
+  ncounts = rank_counts(params->SCALING_RANKS, size, counts);
+  for (i = 0; i < ncounts; i++) {
+    n += decompositions(counts[i], strong, global, per_rank, P + n, SCALING_RUNS - n);
+  }
+  if (n == 0) {
+    if (rank == 0) { printf("Scaling: no decomposition of the rank counts fits the element grid.\n"); }
+    free(P);
+    return 1;
+  }
+
+  for (k = 0; k < n; k++) {
+    if (rank == 0) {
+      printf("Scaling run %d of %d: %d ranks as %dx%dx%d, %dx%dx%d elements each.\n", k + 1, n,
+             P[k].ranks, P[k].cart[0], P[k].cart[1], P[k].cart[2],
+             P[k].elements[0], P[k].elements[1], P[k].elements[2]);
+      fflush(stdout);
+    }
+
+    /* The ranks left out wait in the next split. */
+    MPI_Comm_split(world, rank < P[k].ranks ? 0 : MPI_UNDEFINED, rank, &sub);
+    if (sub != MPI_COMM_NULL) {
+      struct paramstype local = *params;
+      set_decomposition(&local, P[k].cart, P[k].elements);
+      if (local.PROBED_RANK >= (unsigned int) P[k].ranks) { local.PROBED_RANK = 0; }
+      failed |= run(sub, &local, &P[k].seconds);
+      MPI_Comm_free(&sub);
+    }
+  }
+
+  /* Rank 0 took part in every run. The baseline is the fastest run at the
+     smallest rank count. */
+  if (rank == 0) {
+    for (base = 0, k = 0; k < n && P[k].ranks == P[0].ranks; k++) {
+      if (base == 0 || P[k].seconds < base) { base = P[k].seconds; }
+    }
+
+    printf("scaling,mode,ranks,cart_x,cart_y,cart_z,elements_x,elements_y,elements_z,seconds,"
+           "speedup,efficiency,dofs_per_s,best\n");
+    for (k = 0; k < n; k++) {
+      double s = P[k].seconds, speedup, efficiency;
+      for (best = s, i = 0; i < n; i++) {
+        if (P[i].ranks == P[k].ranks && P[i].seconds < best) { best = P[i].seconds; }
+      }
+      if (strong) {
+        speedup = s > 0 ? base / s : 0;
+        efficiency = speedup * P[0].ranks / P[k].ranks;
+      } else {
+        efficiency = s > 0 ? base / s : 0;
+        speedup = efficiency * P[k].ranks / P[0].ranks;
+      }
+      dofs = (double) P[k].ranks * P[k].elements[0] * P[k].elements[1] * P[k].elements[2] *
+             params->PHYSICAL_PARAMS * params->ELEMENT_SIZE * params->ELEMENT_SIZE *
+             params->ELEMENT_SIZE * params->TIMESTEPS * params->RK;
+      printf("scaling,%s,%d,%d,%d,%d,%d,%d,%d,%.6f,%.3f,%.3f,%.4g,%d\n", params->MODE, P[k].ranks,
+             P[k].cart[0], P[k].cart[1], P[k].cart[2], P[k].elements[0], P[k].elements[1],
+             P[k].elements[2], s, speedup, efficiency, s > 0 ? dofs / s : 0, s == best);
+    }
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, world);
+  free(P);
+  return failed;
+}
@@ -0,0 +1,55 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCALING_H_
+#define SCALING_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+
+
+/* ------------------------------ Scaling Study ---------------------------- */
+
+/* MODE strong or weak: run the mini-app once for every cartesian
+   factorization of every rank count of SCALING_RANKS, each on the first
+   ranks of the communicator, and print a parallel-efficiency table.
+
+     strong  |  the global element grid of the given decomposition
+                (ELEMENTS_* x CARTESIAN_*) is split over every grid that
+                divides it evenly
+     weak    |  every rank keeps ELEMENTS_X x ELEMENTS_Y x ELEMENTS_Z
+
+   Efficiencies are relative to the fastest decomposition at the smallest
+   rank count. */
+
+/* One run on comm with the decomposition in params; returns nonzero on
+   failure and sets seconds to the slowest rank's time loop. */
+typedef int (*scalingrun)(MPI_Comm comm, struct paramstype *params, double *seconds);
+
+/* The whole study. Returns nonzero if any run failed. Collective on world. */
+int run_scaling(MPI_Comm world, struct paramstype *params, scalingrun run);
+
+#endif
@@ -0,0 +1,437 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#include <math.h>
+#include <mpi.h>
+
+#include "timers.h"
+#include "params.h"
+#include "utils.h"
+#include "dstructs.h"
+
+
+const char *region_names[REGION_COUNT] = {
+  "conv", "dr", "ds", "dt", "sum", "rk", "pack", "send", "recv", "unpack"
+};
+
+const char *counter_names[COUNTER_COUNT] = {
+  "cycles", "instructions", "llc_misses", "flops"
+};
+
+/* Everything one thread accumulates. Padded so that neighbouring threads
+   never write to the same cache line. */
+typedef struct {
+  regiontotal R[REGION_COUNT];
+  int fd;                     // perf_event group leader, -1 if none
+  int members[COUNTER_COUNT]; // every fd of the group, -1 if absent
+  int pos[COUNTER_COUNT];     // position of each counter in a group read, -1 if absent
+  int nr;                     // number of counters in the group
+  char pad[64];
+} threadtimers;
+
+/* One per OpenMP thread plus a last one for a helper thread. */
+static threadtimers *timers = NULL;
+static int timer_threads = 0;
+static __thread int helper = 0;
+static int regions_on = 0;
+static int counters_on = 0;
+
+
+/* ------------------------------------------------------------------------- */
+/* ---------------------------- Perf Counters ------------------------------ */
+/* ------------------------------------------------------------------------- */
+
+static int open_event(unsigned int type, unsigned long long config, int group)
+/* Open one counting event on the calling thread, any cpu. */
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  attr.disabled = (group == -1);
+
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static void open_counters(threadtimers *T, const char *flops)
+/* Build a perf_event group for the calling thread. Counters that the kernel
+   or the CPU refuses are left out rather than failing the run. */
+{
+  int c, fd;
+
+  for (c = 0; c < COUNTER_COUNT; c++) { T->pos[c] = -1; T->members[c] = -1; }
+  T->nr = 0;
+
+  T->fd = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+  if (T->fd < 0) { return; }
+  T->members[COUNTER_CYCLES] = T->fd;
+  T->pos[COUNTER_CYCLES] = T->nr++;
+
+  fd = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, T->fd);
+  if (fd >= 0) { T->members[COUNTER_INSTRUCTIONS] = fd; T->pos[COUNTER_INSTRUCTIONS] = T->nr++; }
+
+  fd = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, T->fd);
+  if (fd >= 0) { T->members[COUNTER_LLC_MISSES] = fd; T->pos[COUNTER_LLC_MISSES] = T->nr++; }
+
+  /* There is no portable FLOP event; take the raw encoding for this CPU
+     (e.g. FP_ARITH_INST_RETIRED) from the parameters. */
+  if (*flops != '\0') {
+    fd = open_event(PERF_TYPE_RAW, strtoull(flops, NULL, 0), T->fd);
+    if (fd >= 0) { T->members[COUNTER_FLOPS] = fd; T->pos[COUNTER_FLOPS] = T->nr++; }
+  }
+
+  ioctl(T->fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(T->fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static void read_counters(threadtimers *T, long long *c)
+/* Snapshot the calling thread's counter group into c. */
+{
+  unsigned long long buf[1 + COUNTER_COUNT];
+  int i;
+
+  for (i = 0; i < COUNTER_COUNT; i++) { c[i] = 0; }
+  if (T->fd < 0) { return; }
+  if (read(T->fd, buf, sizeof(unsigned long long) * (1 + T->nr)) <= 0) { return; }
+
+  for (i = 0; i < COUNTER_COUNT; i++) {
+    if (T->pos[i] >= 0) { c[i] = buf[1 + T->pos[i]]; }
+  }
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ---------------------------- Timer Functions ---------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static threadtimers *mine(void)
+/* The calling thread's accumulators. */
+{
+  return &timers[helper ? timer_threads - 1 : thread_num()];
+}
+
+void setup_timers(struct paramstype *params)
+/* Allocate per-thread accumulators and, if requested, open a perf_event
+   group on every thread. Region timing is active only when PROFILE >= 2. */
+{
+  int t, c;
+
+  timer_threads = params->THREADS + 1;
+  timers = calloc(timer_threads, sizeof(threadtimers));
+  for (t = 0; t < timer_threads; t++) {
+    timers[t].fd = -1;
+    for (c = 0; c < COUNTER_COUNT; c++) { timers[t].members[c] = -1; }
+  }
+
+  regions_on = (params->PROFILE >= 2);
+  counters_on = regions_on && params->COUNTERS;
+
+  if (counters_on) {
+    /* Counters follow the thread that opened them, so each thread opens its own. */
+    #pragma omp parallel num_threads(params->THREADS)
+    {
+      open_counters(&timers[thread_num()], params->PERF_FLOPS_EVENT);
+    }
+    if (timers[0].fd < 0) { counters_on = 0; }
+  }
+}
+
+void register_helper_thread(struct paramstype *params)
+/* Counters, too, are opened by the thread they follow. */
+{
+  helper = 1;
+  if (counters_on) { open_counters(mine(), params->PERF_FLOPS_EVENT); }
+}
+
+void delete_timers(void)
+/* Release the accumulators and close any counters. */
+{
+  int t, c;
+  for (t = 0; t < timer_threads; t++) {
+    for (c = 0; c < COUNTER_COUNT; c++) {
+      if (timers[t].members[c] >= 0) { close(timers[t].members[c]); }
+    }
+  }
+  free(timers);
+  timers = NULL;
+  timer_threads = 0;
+}
+
+void region_begin(regionmark *m)
+/* Mark the start of a region on the calling thread. */
+{
+  if (!regions_on) { return; }
+  if (counters_on) { read_counters(mine(), m->c); }
+  m->t = now();
+}
+
+void region_end(int region, regionmark *m)
+/* Close a region opened by region_begin and add it to this thread's totals. */
+{
+  region_end_calls(region, m, 1);
+}
+
+void region_end_calls(int region, regionmark *m, long calls)
+/* The same, counting calls calls. */
+{
+  int i;
+  struct timespec t;
+  long long c[COUNTER_COUNT];
+  threadtimers *T;
+
+  if (!regions_on) { return; }
+
+  t = now();
+  T = mine();
+  T->R[region].seconds += tdiff(m->t, t);
+  T->R[region].calls += calls;
+
+  if (counters_on) {
+    read_counters(T, c);
+    for (i = 0; i < COUNTER_COUNT; i++) { T->R[region].c[i] += c[i] - m->c[i]; }
+  }
+}
+
+regiontotal region_total(int region)
+/* Sum one region over all threads of this rank. */
+{
+  int t, i;
+  regiontotal sum;
+
+  memset(&sum, 0, sizeof(sum));
+  for (t = 0; t < timer_threads; t++) {
+    sum.seconds += timers[t].R[region].seconds;
+    sum.calls += timers[t].R[region].calls;
+    for (i = 0; i < COUNTER_COUNT; i++) { sum.c[i] += timers[t].R[region].c[i]; }
+  }
+  return sum;
+}
+
+int counter_available(int c)
+/* Nonzero if counter c could be opened on this machine. */
+{
+  return counters_on && timers[0].pos[c] >= 0;
+}
+
+void print_timers(struct paramstype *params)
+/* Print this rank's per-region table (time, calls, counters). */
+{
+  int r, c;
+  regiontotal T;
+
+  if (!regions_on) { return; }
+
+  printf("Region,calls,seconds,usec/call");
+  for (c = 0; c < COUNTER_COUNT; c++) {
+    if (counter_available(c)) { printf(",%s", counter_names[c]); }
+  }
+  if (counter_available(COUNTER_CYCLES) && counter_available(COUNTER_INSTRUCTIONS)) { printf(",ipc"); }
+  printf("\n");
+
+  for (r = 0; r < REGION_COUNT; r++) {
+    T = region_total(r);
+    printf("%s,%ld,%.8f,%.3f", region_names[r], T.calls, T.seconds,
+           T.calls ? 1E6 * T.seconds / T.calls : 0.0);
+    for (c = 0; c < COUNTER_COUNT; c++) {
+      if (counter_available(c)) { printf(",%lld", T.c[c]); }
+    }
+    if (counter_available(COUNTER_CYCLES) && counter_available(COUNTER_INSTRUCTIONS)) {
+      printf(",%.3f", T.c[COUNTER_CYCLES] ? (double) T.c[COUNTER_INSTRUCTIONS] / T.c[COUNTER_CYCLES] : 0.0);
+    }
+    printf("\n");
+  }
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------- Cross-rank Statistics ------------------------- */
+/* ------------------------------------------------------------------------- */
+
+phasestats reduce_phase(double *samples, int n, MPI_Comm comm)
+/* Reduce n per-stage samples of one phase from every rank onto rank 0 of
+   comm. The result is only meaningful on rank 0. Collective. */
+{
+  int i, rank, ranks, dims, is_cart;
+  double total = 0, sq, sum = 0, sumsq = 0, *slowest_sample = NULL;
+  struct { double value; int rank; } mine, worst;
+  phasestats S;
+
+  memset(&S, 0, sizeof(S));
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  for (i = 0; i < n; i++) { total += samples[i]; }
+  sq = total * total;
+
+  MPI_Reduce(&total, &S.min, 1, MPI_DOUBLE, MPI_MIN, 0, comm);
+  MPI_Reduce(&total, &S.max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+  MPI_Reduce(&total, &sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+  MPI_Reduce(&sq, &sumsq, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+  mine.value = total;
+  mine.rank = rank;
+  MPI_Reduce(&mine, &worst, 1, MPI_DOUBLE_INT, MPI_MAXLOC, 0, comm);
+
+  /* The stage loop is bulk synchronous, so each stage costs what its
+     slowest rank took. */
+  if (rank == 0) { slowest_sample = malloc(sizeof(double) * (n > 0 ? n : 1)); }
+  MPI_Reduce(samples, slowest_sample, n, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+  if (rank == 0) {
+    S.mean = sum / ranks;
+    S.std = sqrt(fmax(sumsq / ranks - S.mean * S.mean, 0.0));
+    S.imbalance = (S.mean > 0) ? S.max / S.mean : 1.0;
+    for (i = 0; i < n; i++) { S.critical += slowest_sample[i]; }
+    free(slowest_sample);
+
+    S.slowest = worst.rank;
+    S.coords[0] = S.coords[1] = S.coords[2] = 0;
+    MPI_Topo_test(comm, &is_cart);
+    if (is_cart == MPI_CART) {
+      MPI_Cartdim_get(comm, &dims);
+      if (dims <= 3) { MPI_Cart_coords(comm, S.slowest, dims, S.coords); }
+    }
+  }
+
+  return S;
+}
+
+static void print_phase_row(const char *name, phasestats *S)
+/* One CSV row of the cross-rank report. */
+{
+  printf("%s,%.8f,%.8f,%.8f,%.8f,%.4f,%.8f,%d,(%d %d %d)\n", name,
+         S->min, S->max, S->mean, S->std, S->imbalance, S->critical,
+         S->slowest, S->coords[0], S->coords[1], S->coords[2]);
+}
+
+void report_phases(const char *label, const char **names, double **samples,
+                   int phases, int n, MPI_Comm comm)
+/* Reduce each named phase and print one row per phase on rank 0 of comm,
+   headed by label. Collective. */
+{
+  int p, rank;
+  phasestats S;
+
+  MPI_Comm_rank(comm, &rank);
+  if (rank == 0) {
+    printf("Ranks %s: phase,min,max,mean,std,imbalance,critical,slowest_rank,slowest_coords\n", label);
+  }
+
+  for (p = 0; p < phases; p++) {
+    S = reduce_phase(samples[p], n, comm);
+    if (rank == 0) { print_phase_row(names[p], &S); }
+  }
+}
+
+void report_regions(const char *label, MPI_Comm comm)
+/* Same, for the per-region totals (only when region timing is on). */
+{
+  int r, rank;
+  double seconds;
+  phasestats S;
+
+  if (!regions_on) { return; }
+
+  MPI_Comm_rank(comm, &rank);
+  if (rank == 0) {
+    printf("Ranks %s: region,min,max,mean,std,imbalance,critical,slowest_rank,slowest_coords\n", label);
+  }
+
+  for (r = 0; r < REGION_COUNT; r++) {
+    seconds = region_total(r).seconds;
+    S = reduce_phase(&seconds, 1, comm);
+    if (rank == 0) { print_phase_row(region_names[r], &S); }
+  }
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Memory Report ---------------------------- */
+/* ------------------------------------------------------------------------- */
+
+void report_memory(const char *label, MPI_Comm comm)
+/* Reduce the per-category accounting of dstructs.h and print one row per
+   category on rank 0 of comm, then the peak per node: the sum of the peaks
+   of the ranks sharing it, which bounds what they held at once. Collective. */
+{
+  int c, rank, local;
+  long live[2 * (MEMORY_COUNT + 1)], most[2 * (MEMORY_COUNT + 1)], node, node_max = 0;
+  double peak, mib = 1024.0 * 1024.0;
+  memoryusage U;
+  phasestats S;
+  MPI_Comm shared, leaders;
+
+  MPI_Comm_rank(comm, &rank);
+
+  live[2 * MEMORY_COUNT] = live[2 * MEMORY_COUNT + 1] = 0;
+  for (c = 0; c < MEMORY_COUNT; c++) {
+    U = memory_usage(c);
+    live[2 * c] = U.payload;
+    live[2 * c + 1] = U.overhead;
+    live[2 * MEMORY_COUNT] += U.payload;
+    live[2 * MEMORY_COUNT + 1] += U.overhead;
+  }
+  MPI_Reduce(live, most, 2 * (MEMORY_COUNT + 1), MPI_LONG, MPI_MAX, 0, comm);
+
+  if (rank == 0) {
+    printf("Ranks %s memory: category,payload_mib_max,overhead_mib_max,overhead_pct,"
+           "peak_mib_min,peak_mib_max,peak_mib_mean,largest_rank\n", label);
+  }
+  for (c = 0; c <= MEMORY_COUNT; c++) {
+    peak = (c < MEMORY_COUNT ? memory_usage(c).peak : memory_peak()) / mib;
+    S = reduce_phase(&peak, 1, comm);
+    if (rank == 0) {
+      long total = most[2 * c] + most[2 * c + 1];
+      printf("%s,%.3f,%.3f,%.1f,%.3f,%.3f,%.3f,%d\n", c < MEMORY_COUNT ? memory_names[c] : "total",
+             most[2 * c] / mib, most[2 * c + 1] / mib, total > 0 ? 100.0 * most[2 * c + 1] / total : 0,
+             S.min, S.max, S.mean, S.slowest);
+    }
+  }
+
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &shared);
+  MPI_Comm_rank(shared, &local);
+  peak = memory_peak();
+  node = (long) peak;
+  MPI_Allreduce(MPI_IN_PLACE, &node, 1, MPI_LONG, MPI_SUM, shared);
+  MPI_Comm_split(comm, local == 0 ? 0 : MPI_UNDEFINED, rank, &leaders);
+  if (leaders != MPI_COMM_NULL) {
+    MPI_Reduce(&node, &node_max, 1, MPI_LONG, MPI_MAX, 0, leaders);
+    MPI_Comm_free(&leaders);
+  }
+  MPI_Comm_free(&shared);
+  if (rank == 0) { printf("Ranks %s memory: node_peak_mib_max,%.3f\n", label, node_max / mib); }
+}
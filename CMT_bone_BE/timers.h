@@ -0,0 +1,131 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TIMERS_H_
+#define TIMERS_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <mpi.h>
+
+#include "params.h"
+#include "flux.h"
+
+
+/* --------------------------- Region Definitions -------------------------- */
+
+/* Instrumented regions. The kernels run on every thread and share their ids
+   with flux.h, the exchange regions only run on the thread that drives MPI. */
+enum {
+  REGION_CONV = KERNEL_CONV, REGION_DR = KERNEL_DR, REGION_DS = KERNEL_DS,
+  REGION_DT = KERNEL_DT, REGION_SUM = KERNEL_SUM, REGION_RK = KERNEL_RK,
+  REGION_PACK = KERNEL_COUNT, REGION_SEND, REGION_RECV, REGION_UNPACK,
+  REGION_COUNT
+};
+
+/* Hardware counters read around each region when params->COUNTERS is set. */
+enum {
+  COUNTER_CYCLES, COUNTER_INSTRUCTIONS, COUNTER_LLC_MISSES, COUNTER_FLOPS,
+  COUNTER_COUNT
+};
+
+extern const char *region_names[REGION_COUNT];
+extern const char *counter_names[COUNTER_COUNT];
+
+/* Start of a region, kept on the caller's stack. */
+typedef struct {
+  struct timespec t;
+  long long c[COUNTER_COUNT];
+} regionmark;
+
+/* Accumulated totals of one region, summed over threads. */
+typedef struct {
+  double seconds;
+  long calls;
+  long long c[COUNTER_COUNT];
+} regiontotal;
+
+
+/* ---------------------------- Timer Functions ---------------------------- */
+
+/* Allocate per-thread accumulators and, if requested, open a perf_event
+   group on every thread. Region timing is active only when PROFILE >= 2. */
+void setup_timers(struct paramstype *params);
+
+/* Route the calling thread, which is not an OpenMP thread (see
+   commthread.h), to the spare accumulator; its regions count towards the
+   rank's totals like any other thread's. */
+void register_helper_thread(struct paramstype *params);
+
+/* Release the accumulators and close any counters. */
+void delete_timers(void);
+
+/* Mark the start and end of a region on the calling thread. Both are no-ops
+   when region timing is off. */
+void region_begin(regionmark *m);
+void region_end(int region, regionmark *m);
+
+/* region_end for a call that did the work of calls per-block calls (a
+   tiled kernel), so the work model still counts blocks. */
+void region_end_calls(int region, regionmark *m, long calls);
+
+/* Sum one region over all threads of this rank. */
+regiontotal region_total(int region);
+
+/* Nonzero if counter c could be opened on this machine. */
+int counter_available(int c);
+
+/* Print this rank's per-region table (time, calls, counters). */
+void print_timers(struct paramstype *params);
+
+
+/* -------------------------- Cross-rank Statistics ------------------------ */
+
+/* One phase (or region) reduced over all ranks of a communicator. */
+typedef struct {
+  double min, max, mean, std;   // of the per-rank totals
+  double imbalance;             // max / mean, 1.0 is perfect balance
+  double critical;              // sum over samples of the slowest rank's sample
+  int slowest;                  // rank with the largest total
+  int coords[3];                // its cartesian coordinates
+} phasestats;
+
+/* Reduce n per-stage samples of one phase from every rank onto rank 0 of
+   comm. The result is only meaningful on rank 0. Collective. */
+phasestats reduce_phase(double *samples, int n, MPI_Comm comm);
+
+/* Reduce each named phase and print one row per phase on rank 0 of comm,
+   headed by label. Collective. */
+void report_phases(const char *label, const char **names, double **samples,
+                   int phases, int n, MPI_Comm comm);
+
+/* Same, for the per-region totals (only when region timing is on). */
+void report_regions(const char *label, MPI_Comm comm);
+
+/* Per-category payload, overhead and high-water marks of the memory
+   accounting (dstructs.h) over all ranks of comm, and the largest peak of
+   any node; printed on rank 0. Collective. */
+void report_memory(const char *label, MPI_Comm comm);
+
+#endif
@@ -0,0 +1,398 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+
+#include "tune.h"
+#include "params.h"
+#include "dstructs.h"
+#include "flux.h"
+#include "halo.h"
+#include "affinity.h"
+#include "order.h"
+#include "rng.h"
+#include "utils.h"
+
+#define TUNE_LINE 512
+
+/* Compute (A) tile sizes tried with the per-block kernel variants: 1 is
+   untiled, 0 is auto (auto_tile). */
+static const unsigned int tile_candidates[] = { 1, 0, 4, 16, 64 };
+static const int tile_candidate_count = sizeof(tile_candidates) / sizeof(tile_candidates[0]);
+
+/* What the autotuner picks. */
+typedef struct {
+  char kernel[32];
+  unsigned int tile;
+  char order[16];
+  char halo[16];
+} choicetype;
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Tuning File ------------------------------ */
+/* ------------------------------------------------------------------------- */
+
+/* One line per machine and problem:
+
+     cpu model|problem key|kernel variant|tile|element order|exchange backend|stage s|exchange s
+
+   with tile 0 for auto. Lines starting with '#' are comments. */
+
+static void tune_key(struct paramstype *params, char *key, int size)
+{
+  snprintf(key, size, "N%u.P%u.E%ux%ux%u.C%ux%ux%u.T%u.%s",
+           params->ELEMENT_SIZE, params->PHYSICAL_PARAMS,
+           params->ELEMENTS_X, params->ELEMENTS_Y, params->ELEMENTS_Z,
+           params->CARTESIAN_X, params->CARTESIAN_Y, params->CARTESIAN_Z,
+           params->THREADS, DTYPE_NAME);
+}
+
+static int known_order(const char *name)
+{
+  int o;
+  for (o = 0; o < element_order_count; o++) {
+    if (strcmp(element_orders[o], name) == 0) { return 1; }
+  }
+  return 0;
+}
+
+static int load_choice(struct paramstype *params, const char *cpu, const char *key, choicetype *C)
+/* Find our line in AUTOTUNE_FILE. Returns 1 if it names a kernel variant,
+   tile, ordering and backend that still exist. */
+{
+  char line[TUNE_LINE], *field[8], *p, *end;
+  int n;
+  long tile;
+  FILE *f = fopen(params->AUTOTUNE_FILE, "r");
+
+  if (f == NULL) { return 0; }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (line[0] == '#') { continue; }
+    line[strcspn(line, "\n")] = '\0';
+
+    for (n = 0, p = line; n < 8 && p != NULL; n++) {
+      field[n] = p;
+      p = strchr(p, '|');
+      if (p != NULL) { *p++ = '\0'; }
+    }
+    if (n < 6 || strcmp(field[0], cpu) != 0 || strcmp(field[1], key) != 0) { continue; }
+    tile = strtol(field[3], &end, 10);
+    if (find_kernels(field[2]) == NULL || *end != '\0' || end == field[3] || tile < 0 || tile > 4096 ||
+        !known_order(field[4]) || find_halo(field[5]) == NULL) { continue; }
+
+    snprintf(C->kernel, sizeof(C->kernel), "%s", field[2]);
+    C->tile = tile;
+    snprintf(C->order, sizeof(C->order), "%s", field[4]);
+    snprintf(C->halo, sizeof(C->halo), "%s", field[5]);
+    fclose(f);
+    return 1;
+  }
+  fclose(f);
+  return 0;
+}
+
+static void store_choice(struct paramstype *params, const char *cpu, const char *key,
+                         const choicetype *C, double stage, double exchange)
+/* Rewrite AUTOTUNE_FILE with our line replaced. */
+{
+  char line[TUNE_LINE], prefix[TUNE_LINE], temp[sizeof(params->AUTOTUNE_FILE) + 8];
+  FILE *in, *out;
+
+  snprintf(prefix, sizeof(prefix), "%s|%s|", cpu, key);
+  snprintf(temp, sizeof(temp), "%s.tmp", params->AUTOTUNE_FILE);
+  out = fopen(temp, "w");
+  if (out == NULL) {
+    printf("Could not write tuning file %s.\n", temp);
+    return;
+  }
+
+  in = fopen(params->AUTOTUNE_FILE, "r");
+  if (in != NULL) {
+    while (fgets(line, sizeof(line), in) != NULL) {
+      if (strncmp(line, prefix, strlen(prefix)) != 0) { fputs(line, out); }
+    }
+    fclose(in);
+  } else {
+    fprintf(out, "# cpu model|problem|kernel variant|tile|element order|exchange backend|"
+                 "stage seconds|exchange seconds\n");
+  }
+  fprintf(out, "%s%s|%u|%s|%s|%.6e|%.6e\n", prefix, C->kernel, C->tile, C->order, C->halo, stage, exchange);
+  fclose(out);
+
+  if (rename(temp, params->AUTOTUNE_FILE) != 0) {
+    printf("Could not replace tuning file %s.\n", params->AUTOTUNE_FILE);
+  }
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* -------------------------------- Trials --------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+  element *Q, *R;
+  matrix kernel;
+  ternix RX[9];
+  scratchpool work;
+} trialdata;
+
+static void new_trial_data(trialdata *D, struct paramstype *params)
+/* Elements of the run's size, placed by the threads that use them. */
+{
+  int e, i, N = params->ELEMENT_SIZE;
+  rngkey stream = rng_stream(RNG_TUNE);
+
+  D->Q = malloc(sizeof(element) * params->ELEMENTS_PER_PROCESS);
+  D->R = malloc(sizeof(element) * params->ELEMENTS_PER_PROCESS);
+
+  #pragma omp parallel for schedule(static)
+  for (e = 0; e < params->ELEMENTS_PER_PROCESS; e++) {
+    D->Q[e] = new_counter_element(0, 10, rng_key(stream, e), params);
+    D->R[e] = new_zero_element(params);
+  }
+
+  D->work = new_scratch_pool(0, interleaved_values(params), params);
+
+  D->kernel = new_counter_matrix(N, N, -10, 10, rng_key(stream, 1ULL << 40));
+  for (i = 0; i < 9; i++) {
+    D->RX[i] = new_counter_ternix(N, N, N, -1, 1, rng_key(stream, (1ULL << 40) + 1 + i));
+  }
+}
+
+static void delete_trial_data(trialdata *D, struct paramstype *params)
+{
+  int e, i;
+
+  for (e = 0; e < params->ELEMENTS_PER_PROCESS; e++) {
+    delete_element(D->Q[e], params);
+    delete_element(D->R[e], params);
+  }
+  delete_scratch_pool(D->work);
+  for (i = 0; i < 9; i++) { delete_ternix(D->RX[i]); }
+  delete_matrix(D->kernel);
+  free(D->Q);
+  free(D->R);
+}
+
+static void trial_tiles(const kernelset *K, int tile, scratchpool work, trialdata *D,
+                        struct paramstype *params)
+/* Compute (A) in tiles of tile blocks, as in the main loop. */
+{
+  int e, b, t, blocks = params->ELEMENTS_PER_PROCESS * params->PHYSICAL_PARAMS;
+  dtype coef[3] = { 0.25, 0.5, 0.75 };
+
+  #pragma omp parallel for schedule(static) private(e, b)
+  for (t = 0; t < (blocks + tile - 1) / tile; t++) {
+    tilescratch S = pool_tile(work);
+    int k, filled = (blocks - t * tile < tile) ? blocks - t * tile : tile;
+
+    for (k = 0; k < filled; k++) {
+      e = (t * tile + k) / params->PHYSICAL_PARAMS;
+      b = (t * tile + k) % params->PHYSICAL_PARAMS;
+      K->conv(D->Q[e]->B[b], D->RX, coef, S->Ur[k], S->Us[k], S->Ut[k], params);
+    }
+    operation_dr_tile(D->kernel, S->Ur, S->Vr, filled, params);
+    operation_ds_tile(D->kernel, S->Us, S->Vs, filled, params);
+    operation_dt_tile(D->kernel, S->Ut, S->Vt, filled, params);
+    for (k = 0; k < filled; k++) {
+      e = (t * tile + k) / params->PHYSICAL_PARAMS;
+      b = (t * tile + k) % params->PHYSICAL_PARAMS;
+      K->sum(S->Vr[k], S->Vs[k], S->Vt[k], D->R[e]->B[b], params);
+    }
+  }
+}
+
+static void trial_stage(const kernelset *K, int tile, scratchpool work, trialdata *D,
+                        struct paramstype *params)
+/* Compute (A) and Compute (B) of one stage, as in the main loop: whole
+   elements for an interleaved variant, else tiles if tile > 1 (work must
+   have tile scratch for them), else block by block. */
+{
+  int e, b;
+  dtype coef[3] = { 0.25, 0.5, 0.75 };
+
+  if (K->conv_params == NULL && tile > 1) { trial_tiles(K, tile, work, D, params); }
+  else {
+    #pragma omp parallel for schedule(static) private(b)
+    for (e = 0; e < params->ELEMENTS_PER_PROCESS; e++) {
+      scratch S = pool_scratch(work);
+      if (K->conv_params != NULL) {
+        dtype coefs[3 * params->PHYSICAL_PARAMS];
+        for (b = 0; b < 3 * params->PHYSICAL_PARAMS; b++) { coefs[b] = coef[b % 3]; }
+        K->conv_params(D->Q[e], D->RX, coefs, S->W, params);
+        K->dr_params(D->kernel, S->W, params);
+        K->ds_params(D->kernel, S->W, params);
+        K->dt_params(D->kernel, S->W, params);
+        K->sum_params(S->W, D->R[e], params);
+        continue;
+      }
+      for (b = 0; b < params->PHYSICAL_PARAMS; b++) {
+        K->conv(D->Q[e]->B[b], D->RX, coef, S->Ur, S->Us, S->Ut, params);
+        K->dr(D->kernel, S->Ur, S->Vr, params);
+        K->ds(D->kernel, S->Us, S->Vs, params);
+        K->dt(D->kernel, S->Ut, S->Vt, params);
+        K->sum(S->Vr, S->Vs, S->Vt, D->R[e]->B[b], params);
+      }
+    }
+  }
+
+  #pragma omp parallel for schedule(static) private(b)
+  for (e = 0; e < params->ELEMENTS_PER_PROCESS; e++) {
+    for (b = 0; b < params->PHYSICAL_PARAMS; b++) {
+      K->rk(D->R[e]->B[b], D->Q[e]->B[b], params);
+    }
+  }
+}
+
+static double slowest_seconds(struct timespec t0, struct timespec t1, int reps, MPI_Comm comm)
+/* Time per repetition on the slowest rank, known to every rank. */
+{
+  double mine = tdiff(t0, t1) / reps, slowest;
+  MPI_Allreduce(&mine, &slowest, 1, MPI_DOUBLE, MPI_MAX, comm);
+  return slowest;
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------- Autotuner ------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+int auto_tile(int blocks, struct paramstype *params)
+/* A tile's Q, R and six intermediates per block, next to the shared RX,
+   fit into L2 (1 MiB if the system does not say), and every thread gets
+   at least one tile. */
+{
+  long l2 = cache_size(2), tile, share = (blocks + params->THREADS - 1) / params->THREADS;
+  long block = sizeof(dtype) * params->ELEMENT_SIZE * params->ELEMENT_SIZE * params->ELEMENT_SIZE;
+
+  if (l2 <= 0) { l2 = 1L << 20; }
+  tile = (l2 - 9 * block) / (8 * block);
+  if (tile > share) { tile = share; }
+  if (tile < 1) { tile = 1; }
+  return (int) tile;
+}
+
+void autotune(MPI_Comm cart_comm, struct paramstype *params)
+/* Load or measure the fastest stage (kernel variant and tile) and exchange
+   (element ordering and backend) and set them in params on every rank.
+   Collective. */
+{
+  int rank, v, c, o, h, r, tile, loaded = 0;
+  int blocks = params->ELEMENTS_PER_PROCESS * params->PHYSICAL_PARAMS;
+  int share = (blocks + params->THREADS - 1) / params->THREADS;
+  double seconds, best_stage = 0, best_exchange = 0;
+  char cpu[128], key[128], candidate[64];
+  struct timespec t0, t1;
+  choicetype best;
+  scratchpool work;
+  trialdata D;
+
+  MPI_Comm_rank(cart_comm, &rank);
+  cpu_model(cpu, sizeof(cpu));
+  tune_key(params, key, sizeof(key));
+
+  /* A stored choice, if there is one; rank 0's file decides for everyone. */
+  if (rank == 0 && strcmp(params->AUTOTUNE, "auto") == 0) { loaded = load_choice(params, cpu, key, &best); }
+  MPI_Bcast(&loaded, 1, MPI_INT, 0, cart_comm);
+
+  if (!loaded) {
+    new_trial_data(&D, params);
+    if (rank == 0) { printf("tune,candidate,kind,seconds\n"); }
+
+    /* Kernel variants and, for the per-block ones, tile sizes: whole
+       stages, so fused or reordered variants are compared on what they
+       replace. One untimed stage warms each up. */
+    for (v = 0; v < kernel_variant_count; v++) {
+      const kernelset *K = &kernel_variants[v];
+
+      for (c = 0; c < (K->conv_params == NULL ? tile_candidate_count : 1); c++) {
+        tile = tile_candidates[c] == 0 ? auto_tile(blocks, params) : (int) tile_candidates[c];
+        if (tile_candidates[c] > 1 && tile > share) { continue; }
+        work = tile > 1 ? new_scratch_pool(tile, 0, params) : D.work;
+
+        trial_stage(K, tile, work, &D, params);
+        MPI_Barrier(cart_comm);
+        t0 = now();
+        for (r = 0; r < params->AUTOTUNE_REPS; r++) { trial_stage(K, tile, work, &D, params); }
+        t1 = now();
+        seconds = slowest_seconds(t0, t1, params->AUTOTUNE_REPS, cart_comm);
+        if (work != D.work) { delete_scratch_pool(work); }
+
+        if (tile_candidates[c] == 0) { snprintf(candidate, sizeof(candidate), "%s tile auto (%d)", K->name, tile); }
+        else { snprintf(candidate, sizeof(candidate), "%s tile %d", K->name, tile); }
+        if (rank == 0) { printf("tune,%s,stage,%.6e\n", candidate, seconds); }
+        if ((v == 0 && c == 0) || seconds < best_stage) {
+          snprintf(best.kernel, sizeof(best.kernel), "%s", K->name);
+          best.tile = tile_candidates[c];
+          best_stage = seconds;
+        }
+      }
+    }
+
+    /* Element orderings and exchange backends. The ordering changes which
+       stored elements the exchange packs and unpacks (layout_table), the
+       only phase whose memory access depends on it. */
+    for (o = 0; o < element_order_count; o++) {
+      snprintf(params->ELEMENT_ORDER, sizeof(params->ELEMENT_ORDER), "%s", element_orders[o]);
+      setup_element_order(params);
+
+      for (h = 0; h < halo_backend_count; h++) {
+        halo_backends[h].exchange(D.R, layout_table(), cart_comm, params);
+        MPI_Barrier(cart_comm);
+        t0 = now();
+        for (r = 0; r < params->AUTOTUNE_REPS; r++) { halo_backends[h].exchange(D.R, layout_table(), cart_comm, params); }
+        t1 = now();
+        seconds = slowest_seconds(t0, t1, params->AUTOTUNE_REPS, cart_comm);
+
+        if (rank == 0) { printf("tune,%s %s,exchange,%.6e\n", halo_backends[h].name, element_orders[o], seconds); }
+        if ((o == 0 && h == 0) || seconds < best_exchange) {
+          snprintf(best.order, sizeof(best.order), "%s", element_orders[o]);
+          snprintf(best.halo, sizeof(best.halo), "%s", halo_backends[h].name);
+          best_exchange = seconds;
+        }
+      }
+      delete_element_order();
+    }
+
+    delete_trial_data(&D, params);
+    if (rank == 0) { store_choice(params, cpu, key, &best, best_stage, best_exchange); }
+  }
+
+  MPI_Bcast(&best, sizeof(best), MPI_BYTE, 0, cart_comm);
+  snprintf(params->KERNEL, sizeof(params->KERNEL), "%s", best.kernel);
+  params->TILE = best.tile;
+  snprintf(params->ELEMENT_ORDER, sizeof(params->ELEMENT_ORDER), "%s", best.order);
+  snprintf(params->HALO, sizeof(params->HALO), "%s", best.halo);
+
+  if (rank == params->PROBED_RANK) {
+    if (best.tile == 0) { snprintf(candidate, sizeof(candidate), "auto"); }
+    else { snprintf(candidate, sizeof(candidate), "%u", best.tile); }
+    printf("Autotune: kernel %s, tile %s, element order %s, exchange %s (%s %s).\n",
+           params->KERNEL, candidate, params->ELEMENT_ORDER, params->HALO,
+           loaded ? "from" : "measured, stored in", params->AUTOTUNE_FILE);
+  }
+}
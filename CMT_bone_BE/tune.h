@@ -0,0 +1,56 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TUNE_H_
+#define TUNE_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+
+
+/* ------------------------------- Autotuner ------------------------------- */
+
+/* Choose params->KERNEL, TILE, ELEMENT_ORDER and HALO for this machine and
+   problem.
+
+   With AUTOTUNE "auto", a choice stored in AUTOTUNE_FILE for this cpu model
+   and problem (ELEMENT_SIZE, PHYSICAL_PARAMS, elements, grid, threads and
+   precision) is used as is. Otherwise, and always with "force", every
+   kernel variant runs AUTOTUNE_REPS Compute (A) + (B) stages, the per-block
+   ones untiled and with tiles of auto, 4, 16 and 64 blocks (those that
+   give every thread a tile), and every exchange backend runs AUTOTUNE_REPS
+   exchanges under every element ordering, on scratch elements of the run's
+   size. The slowest rank's time counts, so all ranks agree; the fastest
+   stage and the fastest exchange are kept and stored in AUTOTUNE_FILE.
+   Collective on cart_comm; must run before the region timers and the
+   element ordering are set up. */
+void autotune(MPI_Comm cart_comm, struct paramstype *params);
+
+/* Blocks per Compute (A) tile for TILE 0: as many as fit L2 with their
+   intermediates, at most blocks / THREADS. */
+int auto_tile(int blocks, struct paramstype *params);
+
+#endif
@@ -28,27 +28,40 @@ Original:
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
-#include <mpi.h>
 
 #include "time.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 /*   ttype: type to use for representing time */
 typedef double ttype;
 
-ttype tdiff(struct timespec a, struct timespec b)
+static inline ttype tdiff(struct timespec a, struct timespec b)
 /* Find the time difference. */
 {
   ttype dt = (( b.tv_sec - a.tv_sec ) + ( b.tv_nsec - a.tv_nsec ) / 1E9);
   return dt;
 }
 
-struct timespec now()
-/* Return the current time. */
+static inline struct timespec now()
+/* Return the current time. Monotonic, so NTP steps cannot corrupt a sample. */
 {
   struct timespec t;
-  clock_gettime(CLOCK_REALTIME, &t);
+  clock_gettime(CLOCK_MONOTONIC, &t);
   return t;
 }
 
+static inline int thread_num()
+/* Index of the calling OpenMP thread (0 when built without OpenMP). */
+{
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
 #endif
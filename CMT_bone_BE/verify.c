@@ -0,0 +1,245 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <mpi.h>
+
+#include "verify.h"
+#include "params.h"
+#include "dstructs.h"
+
+const char *checksum_names[CHECKSUM_COUNT] = { "Q sum", "Q norm", "R sum", "R norm" };
+
+#define VERIFY_LINE 512
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------- Checksums ------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static void block_sums(ternix A, double *sum, double *sumsq)
+/* Sum and sum of squares of one block, in double whatever dtype is. */
+{
+  int row, col, layer;
+  double s = 0, q = 0, v;
+
+  for (row = 0; row < A->rows; row++) {
+    for (col = 0; col < A->cols; col++) {
+      for (layer = 0; layer < A->layers; layer++) {
+        v = A->T[row][col][layer];
+        s += v;
+        q += v * v;
+      }
+    }
+  }
+  *sum = s;
+  *sumsq = q;
+}
+
+void stage_checksums(element *Q, element *R, int elements, const int *layout, MPI_Comm comm,
+                     struct paramstype *params, double *out)
+/* Sum and L2 norm of every block of Q and R over all ranks, on rank 0, in
+   an order that does not depend on threads, ordering or MPI. Collective. */
+{
+  int i, e, b, f, r, rank, ranks, P = params->PHYSICAL_PARAMS;
+  int width = P * CHECKSUM_COUNT;
+  double *partial = malloc(sizeof(double) * elements * width);
+  double mine[width], *all = NULL;
+
+  /* Per element in parallel ... */
+  #pragma omp parallel for schedule(static) private(b)
+  for (e = 0; e < elements; e++) {
+    double *p = &partial[e * width];
+    for (b = 0; b < P; b++) {
+      block_sums(Q[e]->B[b], &p[b * CHECKSUM_COUNT + CHECKSUM_Q_SUM], &p[b * CHECKSUM_COUNT + CHECKSUM_Q_NORM]);
+      block_sums(R[e]->B[b], &p[b * CHECKSUM_COUNT + CHECKSUM_R_SUM], &p[b * CHECKSUM_COUNT + CHECKSUM_R_NORM]);
+    }
+  }
+
+  /* ... then combined in the original layout's order. The norms are sums
+     of squares until the very end. */
+  for (f = 0; f < width; f++) { mine[f] = 0; }
+  for (i = 0; i < elements; i++) {
+    e = (layout != NULL) ? layout[i] : i;
+    for (f = 0; f < width; f++) { mine[f] += partial[e * width + f]; }
+  }
+  free(partial);
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+  if (rank == 0) { all = malloc(sizeof(double) * width * ranks); }
+  MPI_Gather(mine, width, MPI_DOUBLE, all, width, MPI_DOUBLE, 0, comm);
+
+  if (rank == 0) {
+    for (f = 0; f < width; f++) {
+      out[f] = 0;
+      for (r = 0; r < ranks; r++) { out[f] += all[r * width + f]; }
+    }
+    for (b = 0; b < P; b++) {
+      out[b * CHECKSUM_COUNT + CHECKSUM_Q_NORM] = sqrt(out[b * CHECKSUM_COUNT + CHECKSUM_Q_NORM]);
+      out[b * CHECKSUM_COUNT + CHECKSUM_R_NORM] = sqrt(out[b * CHECKSUM_COUNT + CHECKSUM_R_NORM]);
+    }
+    free(all);
+  }
+}
+
+
+/* ------------------------------------------------------------------------- */
+/* ------------------------------ Verification ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+void verify_key(struct paramstype *params, char *key, int size)
+/* Name of the problem a set of checksums belongs to. */
+{
+  snprintf(key, size, "N%u.P%u.E%ux%ux%u.C%ux%ux%u.T%u.RK%u.%s%s%s",
+           params->ELEMENT_SIZE, params->PHYSICAL_PARAMS,
+           params->ELEMENTS_X, params->ELEMENTS_Y, params->ELEMENTS_Z,
+           params->CARTESIAN_X, params->CARTESIAN_Y, params->CARTESIAN_Z,
+           params->TIMESTEPS, params->RK, DTYPE_NAME,
+           params->FOLD_FACES ? ".fold" : "", params->MAPPED ? ".mapped" : "");
+}
+
+double verify_tolerance(struct paramstype *params)
+/* VERIFY_ULPS units of dtype's epsilon if set, else VERIFY_RTOL if set,
+   else 10^4 epsilon: room for reordered sums and fused multiply-adds
+   compounding over a run. */
+{
+  if (params->VERIFY_ULPS > 0) { return params->VERIFY_ULPS * DTYPE_EPSILON; }
+  if (params->VERIFY_RTOL > 0) { return params->VERIFY_RTOL; }
+  return 1E4 * DTYPE_EPSILON;
+}
+
+static int record_checksums(double *sums, int stages, const char *key, struct paramstype *params)
+/* Rewrite VERIFY_FILE with every other problem's lines kept and ours
+   replaced. Returns 0 on success. */
+{
+  int s, b, f, P = params->PHYSICAL_PARAMS;
+  size_t keylen = strlen(key);
+  char line[VERIFY_LINE], temp[sizeof(params->VERIFY_FILE) + 8];
+  FILE *in, *out;
+
+  snprintf(temp, sizeof(temp), "%s.tmp", params->VERIFY_FILE);
+  out = fopen(temp, "w");
+  if (out == NULL) {
+    printf("Could not write verification file %s.\n", temp);
+    return 1;
+  }
+
+  in = fopen(params->VERIFY_FILE, "r");
+  if (in != NULL) {
+    while (fgets(line, sizeof(line), in) != NULL) {
+      if (strncmp(line, key, keylen) == 0 && line[keylen] == ' ') { continue; }
+      if (strncmp(line, "# ", 2) == 0 && strncmp(line + 2, key, keylen) == 0 &&
+          line[2 + keylen] == ' ') { continue; }
+      fputs(line, out);
+    }
+    fclose(in);
+  }
+
+  fprintf(out, "# %s recorded with kernel %s, exchange %s, %u threads\n",
+          key, params->KERNEL, params->HALO, params->THREADS);
+  for (s = 0; s < stages; s++) {
+    for (b = 0; b < P; b++) {
+      fprintf(out, "%s %d %d", key, s, b);
+      for (f = 0; f < CHECKSUM_COUNT; f++) {
+        fprintf(out, " %.17g", sums[(s * P + b) * CHECKSUM_COUNT + f]);
+      }
+      fprintf(out, "\n");
+    }
+  }
+  fclose(out);
+
+  if (rename(temp, params->VERIFY_FILE) != 0) {
+    printf("Could not replace verification file %s.\n", params->VERIFY_FILE);
+    return 1;
+  }
+  printf("Verification: recorded %d stages of %s in %s.\n", stages, key, params->VERIFY_FILE);
+  return 0;
+}
+
+static int check_checksums(double *sums, int first, int stages, const char *key,
+                           struct paramstype *params)
+/* Compare stages first to stages - 1 against VERIFY_FILE. Returns 0 if
+   every stored value matches within the tolerance and every one of those
+   stages has a stored value. */
+{
+  int s, b, f, found = 0, P = params->PHYSICAL_PARAMS;
+  int worst_s = first, worst_b = 0, worst_f = 0;
+  size_t keylen = strlen(key);
+  double stored[CHECKSUM_COUNT], err, worst = 0, rtol = verify_tolerance(params);
+  char line[VERIFY_LINE];
+  FILE *in = fopen(params->VERIFY_FILE, "r");
+
+  if (in == NULL) {
+    printf("Verification: FAIL, no reference file %s (record one with CMT_VERIFY=record).\n",
+           params->VERIFY_FILE);
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), in) != NULL) {
+    if (strncmp(line, key, keylen) != 0 || line[keylen] != ' ') { continue; }
+    if (sscanf(line + keylen, "%d %d %lf %lf %lf %lf", &s, &b, &stored[0], &stored[1],
+               &stored[2], &stored[3]) != 2 + CHECKSUM_COUNT) { continue; }
+    if (s < first || s >= stages || b < 0 || b >= P) { continue; }
+    found++;
+
+    for (f = 0; f < CHECKSUM_COUNT; f++) {
+      err = fabs(sums[(s * P + b) * CHECKSUM_COUNT + f] - stored[f]) /
+            fmax(fabs(stored[f]), DBL_MIN);
+      if (err > worst) { worst = err; worst_s = s; worst_b = b; worst_f = f; }
+    }
+  }
+  fclose(in);
+
+  if (found != (stages - first) * P) {
+    printf("Verification: FAIL, %s has %d of %d checksums for %s.\n",
+           params->VERIFY_FILE, found, (stages - first) * P, key);
+    return 1;
+  }
+
+  printf("Verification: %s, max relative error %.3e (tolerance %.3e) at stage %d, param %d, %s.\n",
+         worst <= rtol ? "PASS" : "FAIL", worst, rtol, worst_s, worst_b, checksum_names[worst_f]);
+  return worst <= rtol ? 0 : 1;
+}
+
+int verify_checksums(double *sums, int first, int stages, MPI_Comm comm, struct paramstype *params)
+/* Record or check on rank 0 and share the verdict. Collective. */
+{
+  int rank, failed = 0;
+  char key[128];
+
+  MPI_Comm_rank(comm, &rank);
+  verify_key(params, key, sizeof(key));
+
+  if (rank == 0) {
+    if (strcmp(params->VERIFY, "record") == 0) { failed = record_checksums(sums, stages, key, params); }
+    else { failed = check_checksums(sums, first, stages, key, params); }
+  }
+
+  MPI_Bcast(&failed, 1, MPI_INT, 0, comm);
+  return failed;
+}
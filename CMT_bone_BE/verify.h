@@ -0,0 +1,72 @@
+/*
+  A pseudo-representative application to model NEK.
+
+Modified:
+   Nalini Kumar  { UF CCMT }
+
+Original:
+    Copyright (C) 2016  { Dylan Rudolph, NSF CHREC, UF CCMT }
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VERIFY_H_
+#define VERIFY_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "params.h"
+#include "dstructs.h"
+
+
+/* ------------------------------- Checksums ------------------------------- */
+
+/* What is summed for every physical parameter after every stage. */
+enum { CHECKSUM_Q_SUM, CHECKSUM_Q_NORM, CHECKSUM_R_SUM, CHECKSUM_R_NORM, CHECKSUM_COUNT };
+
+extern const char *checksum_names[CHECKSUM_COUNT];
+
+/* Sum and L2 norm of every block of Q and R (elements of them on this rank)
+   over all ranks of comm, written to out[b * CHECKSUM_COUNT + field] on
+   rank 0. Elements are summed in the original layout, through layout (the
+   ordering's table, see layout_table in order.h; NULL for storage order),
+   and ranks in rank order, so the result does not depend on the thread
+   count, the element ordering or MPI's reduction order. Collective. */
+void stage_checksums(element *Q, element *R, int elements, const int *layout, MPI_Comm comm,
+                     struct paramstype *params, double *out);
+
+
+/* ------------------------------ Verification ----------------------------- */
+
+/* Name of the problem a set of checksums belongs to: sizes, decomposition,
+   timesteps, precision, whether received faces are folded in and whether
+   they follow the mapped exchange, but not the kernel variant, exchange
+   backend, thread count, load pattern or rebalancing, which must all
+   reproduce the same numbers. */
+void verify_key(struct paramstype *params, char *key, int size);
+
+/* Relative tolerance of the check, from VERIFY_ULPS or VERIFY_RTOL. */
+double verify_tolerance(struct paramstype *params);
+
+/* With VERIFY "record", store the checksums of all stages (as produced by
+   stage_checksums, stages after each other) in VERIFY_FILE under this
+   problem's key, replacing an older record. With "check", compare stages
+   first to stages - 1 with the stored ones (a restarted run has no others)
+   and print the largest relative difference. Returns 0 on success and 1 on
+   a failed check, on every rank. Collective. */
+int verify_checksums(double *sums, int first, int stages, MPI_Comm comm, struct paramstype *params);
+
+#endif